@@ -0,0 +1,66 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/***********************
+ *                     *
+ *        Arena        *
+ *                     *
+ **********************/
+
+/// Bump allocator for objects that all die together, such as the instructions
+/// of one method. Objects are never freed one by one: memory is released (and
+/// destructors run, in reverse creation order) when the arena is destroyed.
+///
+/// Moving an arena keeps every object it allocated at the same address.
+class Arena {
+private:
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  std::vector<std::unique_ptr<std::byte[]>> chunks;
+  std::vector<Destructor> destructors;
+  std::byte *cursor;
+  size_t remaining;
+  size_t allocated;
+
+  static constexpr size_t CHUNK_SIZE = 4096;
+
+  void destroy_all();
+
+public:
+  Arena();
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&) noexcept;
+  Arena &operator=(Arena &&) noexcept;
+
+  /// Raw memory, valid until the arena is destroyed
+  void *allocate(size_t size, size_t alignment);
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    void *memory = allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      destructors.push_back(
+          {object, [](void *p) { static_cast<T *>(p)->~T(); }});
+
+    return object;
+  }
+
+  /// Bytes handed out so far
+  size_t bytes_allocated() const;
+};
+
+#endif // !_ARENA_H
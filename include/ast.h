@@ -29,6 +29,8 @@ enum class ChildSide {
  **********************/
 
 class TypeContext;
+class ThreadPool;
+class ClassTree;
 
 class AstNode {
 public:
@@ -51,7 +53,13 @@ public:
 
   virtual bool typecheck(TypeContext &) override;
 
-  virtual hlir::InstructionList to_hlir(hlir::Context &) const;
+  /// Emits this expression at the end of the method being lowered, leaving
+  /// its value in dest. An empty dest means the value is never read. Lowering
+  /// THROUGH_ACC always asks for acc.
+  virtual void to_hlir(hlir::Context &, hlir::Value dest) const;
+  /// Where the value of this expression can be read without lowering it,
+  /// which is only possible for constants and variables, or an empty value
+  virtual hlir::Value value_in_place(const hlir::Context &) const;
 
   virtual int arity();
   virtual ChildSide child_side();
@@ -61,9 +69,6 @@ public:
 typedef std::unique_ptr<ExpressionNode> ExpressionPtr;
 
 class AttributeNode : public AstNode {
-private:
-  bool typecheck_inheritance(const TypeContext &) const;
-
 public:
   AttributeNode(Symbol v, Symbol ty, Token st)
       : object_id(v), declared_type(ty), AstNode(st) {}
@@ -79,6 +84,9 @@ public:
   void print(Printer printer, const SymbolTable &symbols) override;
 
   bool typecheck(TypeContext &) override;
+  /// Checks this attribute against the one it redefines from a superclass
+  bool typecheck_inheritance(const TypeContext &,
+                             const AttributeNode &inherited) const;
 };
 
 class ParameterNode : public AstNode {
@@ -95,9 +103,6 @@ public:
 };
 
 class MethodNode : public AstNode {
-private:
-  bool typecheck_inheritance(const TypeContext &) const;
-
 public:
   MethodNode(Symbol n, Symbol rt,
              std::vector<std::unique_ptr<ParameterNode>> ps, ExpressionPtr b,
@@ -114,8 +119,12 @@ public:
   void print(Printer printer, const SymbolTable &symbols) override;
 
   bool typecheck(TypeContext &) override;
+  /// Checks this method's signature against the one it overrides
+  bool typecheck_inheritance(const TypeContext &,
+                             const MethodNode &inherited) const;
 
-  hlir::Method to_hlir_method(SymbolTable &) const;
+  hlir::Method to_hlir_method(SymbolTable &, const ObjectLayout &,
+                              hlir::Lowering) const;
 };
 
 class ClassNode : public AstNode {
@@ -132,7 +141,11 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::Class to_hlir_class(SymbolTable &) const;
+  hlir::Class to_hlir_class(SymbolTable &, const ObjectLayout &,
+                            hlir::Lowering) const;
+  /// Method setting every attribute to its default and then to its initializer
+  hlir::Method to_hlir_initializer(SymbolTable &, const ObjectLayout &,
+                                   hlir::Lowering) const;
 };
 
 class ModuleNode : public AstNode {
@@ -144,8 +157,18 @@ public:
   void print(Printer printer, const SymbolTable &symbols) override;
 
   bool typecheck(TypeContext &) override;
-
-  hlir::Universe to_hlir_universe(SymbolTable &) const;
+  /// Typechecks classes concurrently. Each class gets its own Scopes and its
+  /// diagnostics are emitted in source order once all classes are checked.
+  bool typecheck(TypeContext &, ThreadPool &);
+
+  hlir::Universe
+  to_hlir_universe(SymbolTable &, const ClassTree &,
+                   hlir::Lowering = hlir::Lowering::THROUGH_ACC) const;
+  /// Lowers every initializer and method concurrently. Diagnostics are emitted
+  /// in source order, and the universe is the same as lowering sequentially.
+  hlir::Universe
+  to_hlir_universe(SymbolTable &, const ClassTree &, ThreadPool &,
+                   hlir::Lowering = hlir::Lowering::THROUGH_ACC) const;
 };
 
 /***********************
@@ -167,7 +190,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 class LiteralNode : public ExpressionNode {
@@ -181,7 +204,8 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
+  hlir::Value value_in_place(const hlir::Context &) const override;
 };
 
 class VariableNode : public ExpressionNode {
@@ -197,7 +221,8 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
+  hlir::Value value_in_place(const hlir::Context &) const override;
 };
 
 /***********************
@@ -217,7 +242,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 
   virtual int arity() override;
   virtual void add_child(std::unique_ptr<ExpressionNode> &new_child) override;
@@ -241,7 +266,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 
   virtual int arity() override;
   virtual void add_child(std::unique_ptr<ExpressionNode> &new_child) override;
@@ -264,7 +289,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 class AssignNode : public ExpressionNode {
@@ -284,7 +309,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 class DispatchNode : public ExpressionNode {
@@ -318,7 +343,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 /***********************
@@ -338,7 +363,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 
   void add_expression(ExpressionPtr expr) {
     expressions.push_back(std::move(expr));
@@ -360,7 +385,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 class WhileNode : public ExpressionNode {
@@ -377,7 +402,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 class LetNode : public ExpressionNode {
@@ -392,7 +417,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 
   void add_declaration(std::unique_ptr<AttributeNode> attr) {
     declarations.push_back(std::move(attr));
@@ -415,7 +440,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 };
 
 class CaseNode : public ExpressionNode {
@@ -431,7 +456,7 @@ public:
 
   bool typecheck(TypeContext &) override;
 
-  hlir::InstructionList to_hlir(hlir::Context &) const override;
+  void to_hlir(hlir::Context &, hlir::Value dest) const override;
 
   void add_branch(std::unique_ptr<CaseBranchNode> branch) {
     branches.push_back(std::move(branch));
@@ -0,0 +1,124 @@
+#ifndef _BITSET_H
+#define _BITSET_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************
+ *                     *
+ *       BitSet        *
+ *                     *
+ **********************/
+
+/// Fixed-size dense set of small integers, stored one bit each. Operations on
+/// whole sets work a word at a time, and the ones used to iterate dataflow
+/// report whether they changed the set.
+///
+/// Sets combined with each other must have the same size.
+class BitSet {
+private:
+  std::vector<uint64_t> words;
+  size_t size_;
+
+  static constexpr size_t WORD_BITS = 64;
+
+  void clear_unused_bits() {
+    if (size_ % WORD_BITS != 0)
+      words.back() &= (uint64_t(1) << (size_ % WORD_BITS)) - 1;
+  }
+
+public:
+  explicit BitSet(size_t size = 0)
+      : words((size + WORD_BITS - 1) / WORD_BITS, 0), size_(size) {}
+
+  size_t size() const { return size_; }
+
+  bool test(size_t i) const {
+    return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+  }
+  void set(size_t i) { words[i / WORD_BITS] |= uint64_t(1) << (i % WORD_BITS); }
+  void reset(size_t i) {
+    words[i / WORD_BITS] &= ~(uint64_t(1) << (i % WORD_BITS));
+  }
+
+  void clear() {
+    for (uint64_t &word : words)
+      word = 0;
+  }
+  void fill() {
+    for (uint64_t &word : words)
+      word = ~uint64_t(0);
+    clear_unused_bits();
+  }
+
+  size_t count() const {
+    size_t total = 0;
+    for (uint64_t word : words)
+      total += std::popcount(word);
+    return total;
+  }
+  bool empty() const {
+    for (uint64_t word : words)
+      if (word != 0)
+        return false;
+    return true;
+  }
+
+  bool operator==(const BitSet &) const = default;
+
+  /// this |= other. Returns whether this changed.
+  bool union_with(const BitSet &other) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+      uint64_t word = words[i] | other.words[i];
+      changed |= word ^ words[i];
+      words[i] = word;
+    }
+    return changed != 0;
+  }
+
+  /// this &= other. Returns whether this changed.
+  bool intersect_with(const BitSet &other) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+      uint64_t word = words[i] & other.words[i];
+      changed |= word ^ words[i];
+      words[i] = word;
+    }
+    return changed != 0;
+  }
+
+  /// this &= ~other
+  void subtract(const BitSet &other) {
+    for (size_t i = 0; i < words.size(); i++)
+      words[i] &= ~other.words[i];
+  }
+
+  /// this = gen | (in & ~kill), the usual dataflow transfer, in one pass.
+  /// Returns whether this changed.
+  bool assign_transfer(const BitSet &gen, const BitSet &in,
+                       const BitSet &kill) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+      uint64_t word = gen.words[i] | (in.words[i] & ~kill.words[i]);
+      changed |= word ^ words[i];
+      words[i] = word;
+    }
+    return changed != 0;
+  }
+
+  /// Calls f with every element, in increasing order
+  template <typename F> void for_each(F f) const {
+    for (size_t i = 0; i < words.size(); i++) {
+      uint64_t word = words[i];
+      while (word != 0) {
+        f(i * WORD_BITS + std::countr_zero(word));
+        word &= word - 1;
+      }
+    }
+  }
+};
+
+#endif // !_BITSET_H
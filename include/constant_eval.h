@@ -1,10 +1,18 @@
 #ifndef _CONSTANT_EVAL_H
 #define _CONSTANT_EVAL_H
 
+#include "hlir.h"
 #include "symbol.h"
+#include <span>
 
 int int_eval(Symbol, SymbolTable &);
 bool bool_eval(Symbol, SymbolTable &);
 Symbol string_eval(Symbol, SymbolTable &);
 
+/// Result of an operation on constant arguments, with the given static type,
+/// or an empty value if it cannot be computed at compile time. Integers wrap
+/// around at 32 bits, and division by zero is left for runtime.
+hlir::Value fold_constants(hlir::Op, std::span<const hlir::Value> args,
+                           Symbol type);
+
 #endif // !_CONSTANT_EVAL_H
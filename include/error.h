@@ -3,6 +3,7 @@
 
 #include "token.h"
 #include <string>
+#include <vector>
 
 void warning(std::string, Token);
 
@@ -14,4 +15,39 @@ void fatal(std::string);
 
 void fatal(std::string, Token);
 
+/***********************
+ *                     *
+ *     Diagnostics     *
+ *                     *
+ **********************/
+
+/// Diagnostics raised while a DiagnosticCapture was active on a thread. A fatal
+/// diagnostic stops the captured work instead of exiting right away, and exits
+/// once the buffer is emitted.
+class Diagnostics {
+public:
+  std::vector<std::string> messages;
+  bool has_fatal;
+  int fatal_errorcode;
+
+  Diagnostics();
+
+  /// Prints all captured messages and exits if one of them was fatal
+  void emit() const;
+};
+
+/// Thrown by fatal() while capturing, to unwind out of the captured work
+class FatalDiagnostic {};
+
+/// Redirects the diagnostics of the current thread into a Diagnostics buffer
+/// for as long as it lives. Lets parallel phases report in a stable order.
+class DiagnosticCapture {
+private:
+  Diagnostics *previous;
+
+public:
+  DiagnosticCapture(Diagnostics &);
+  ~DiagnosticCapture();
+};
+
 #endif // !_ERROR_H
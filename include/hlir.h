@@ -1,11 +1,18 @@
 #ifndef _HLIR_H
 #define _HLIR_H
 
+#include "arena.h"
+#include "object_layout.h"
 #include "printer.h"
 #include "runtime.h"
 #include "symbol.h"
+#include "symbol_map.h"
 #include "token.h"
-#include <list>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <span>
+#include <vector>
 
 namespace hlir {
 
@@ -27,30 +34,61 @@ enum class ValueKind {
 
 std::string to_string(ValueKind);
 
+/// Operand of an instruction, packed in 64 bits so that it fits in a register
+/// and two values compare in one instruction:
+///
+///   bits 63-61  kind
+///   bits 60-40  static type, as Symbol id + 1 (0 for no type)
+///   bits 39-0   payload, depending on the kind:
+///     - SELF, ACC and EMPTY have none
+///     - LOCAL has the variable name
+///     - ATTRIBUTE has the name in bits 23-0 and the byte offset of the field
+///       inside self (see ObjectLayout) in bits 39-24
+///     - TEMP has the temp id
+///     - CONSTANT has the value matching its type: Int, Bool or Symbol (for
+///       strings and type ids)
+///
+/// Programs too large for these fields are rejected with a fatal error.
 class Value {
 private:
-  Value(ValueKind, int, Symbol);
-  Value(ValueKind, Symbol, Symbol);
-  Value(ValueKind, Symbol);
+  uint64_t bits;
+
+  static constexpr int PAYLOAD_BITS = 40;
+  static constexpr int TYPE_BITS = 21;
+  static constexpr int ATTRIBUTE_NAME_BITS = 24;
+
+  static constexpr uint64_t PAYLOAD_MASK = (uint64_t(1) << PAYLOAD_BITS) - 1;
+  static constexpr uint64_t TYPE_MASK = (uint64_t(1) << TYPE_BITS) - 1;
+  static constexpr uint64_t ATTRIBUTE_NAME_MASK =
+      (uint64_t(1) << ATTRIBUTE_NAME_BITS) - 1;
+
+  Value(ValueKind, Symbol, uint64_t payload);
+
+  uint64_t payload() const { return bits & PAYLOAD_MASK; }
 
 public:
-  ValueKind kind;
-  Symbol static_type;
-
-  // Which of these fields is used depends on the kind and static_type
-  // - SELF ignores these values
-  // - LOCAL, ATTR use symbol for the variable name.
-  // - TEMP uses num as the temp id
-  // - ACC ignores these values
-  // - CONSTANT uses the field matching their type, with strings using Symbol
-  union {
-    int num;
-    Symbol symbol;
-    bool boolean;
-  };
+  ValueKind kind() const { return ValueKind(bits >> (PAYLOAD_BITS + TYPE_BITS)); }
+  Symbol static_type() const {
+    return Symbol(int((bits >> PAYLOAD_BITS) & TYPE_MASK) - 1);
+  }
+
+  /// TEMP id or Int CONSTANT
+  int num() const { return int32_t(uint32_t(payload())); }
+  /// LOCAL or ATTRIBUTE name, or Symbol CONSTANT
+  Symbol symbol() const {
+    if (kind() == ValueKind::ATTRIBUTE)
+      return Symbol(int(payload() & ATTRIBUTE_NAME_MASK));
+    return Symbol(num());
+  }
+  /// Bool CONSTANT
+  bool boolean() const { return payload() != 0; }
+  /// ATTRIBUTE byte offset inside self
+  int offset() const { return int(payload() >> ATTRIBUTE_NAME_BITS); }
+
+  bool operator==(const Value &) const = default;
 
   static Value self(Symbol);
-  static Value attr(Symbol, Symbol);
+  static Value attr(Symbol name, int offset, Symbol);
   static Value local(Symbol, Symbol);
   static Value temp(int, Symbol);
   static Value acc(Symbol);
@@ -60,8 +98,14 @@ public:
   static Value empty();
 
   bool is_empty() const;
+  /// The same value, read as another static type
+  Value with_type(Symbol) const;
+  /// The packed bits, equal exactly when the values are, for hashing
+  uint64_t raw() const { return bits; }
 };
 
+static_assert(sizeof(Value) == 8);
+
 std::string to_string(Value, const SymbolTable &);
 
 /***********************
@@ -70,7 +114,7 @@ std::string to_string(Value, const SymbolTable &);
  *                     *
  **********************/
 
-enum class Op {
+enum class Op : uint8_t {
   ADD,
   SUB,
   MULT,
@@ -89,6 +133,7 @@ enum class Op {
   ERROR,
   TYPE_ID_OF,
   SUPERCLASS,
+  PHI,
 };
 
 std::string to_string(Op op);
@@ -99,7 +144,7 @@ std::string to_string(Op op);
  *                     *
  **********************/
 
-enum class BranchCondition {
+enum class BranchCondition : uint8_t {
   ALWAYS,
   TRUE,
   FALSE,
@@ -113,10 +158,6 @@ std::string to_string(BranchCondition);
  *                     *
  **********************/
 
-class Instruction;
-
-typedef std::list<std::unique_ptr<Instruction>> InstructionList;
-
 class Position {
 public:
   int label_idx;
@@ -132,154 +173,218 @@ std::string to_string(Position);
  *                     *
  **********************/
 
+class InstructionList;
+
+/// Every instruction has the same layout: an opcode, up to three inline
+/// operands and a few fixed fields whose meaning depends on the opcode. The
+/// subclasses below add no data. They only construct instructions of their
+/// kind and name the fields that kind uses, so code that does not care about
+/// the kind can go through dest() and args() without any virtual calls.
+///
+/// Operands are the destination, when the op has one, followed by the
+/// arguments. Call keeps its target and arguments in a tail allocated in the
+/// method arena instead, so calls of any arity fit the same layout.
 class Instruction {
+  // Fields are ordered so that the links, the opcode and the inline operands
+  // share the first cache line, which is all most passes look at.
+
+private:
+  // Links maintained by the InstructionList holding this instruction
+  Instruction *prev;
+  Instruction *next;
+
+  friend class InstructionList;
+
 public:
   Op op;
+  /// Branch and Error: when they take effect
+  BranchCondition condition;
+  /// Error: what is raised
+  runtime::Error error;
+
+protected:
+  static constexpr int INLINE_OPERANDS = 3;
+
+  bool has_dest_;
+  uint16_t arg_count;
+  /// New: created type. Call: method name. Label: name.
+  Symbol symbol;
+  /// Branch: target label. Label: its own index.
+  int label;
+  Value *tail;
+  Value operands[INLINE_OPERANDS];
+
+  Instruction(Op o, Token t, Value dest, std::initializer_list<Value> args);
+
+  /// Reports an access to an operand this instruction does not have
+  static Value &missing(const char *accessor);
+
+public:
   Token token;
 
-  Instruction(Op o, Token t);
+  Instruction(const Instruction &) = delete;
+  Instruction &operator=(const Instruction &) = delete;
+
+  Instruction *get_prev() const;
+  Instruction *get_next() const;
 
-  bool has_dest();
-  virtual Value &get_dest();
+  static bool op_has_dest(Op);
 
-  int num_args();
-  virtual Value &get_arg1();
-  virtual Value &get_arg2();
+  // Operand accessors are used by every pass on every instruction, so they
+  // live here to be inlined
 
-  virtual void print(Printer, const SymbolTable &) const;
+  bool has_dest() const { return has_dest_; }
+  Value &get_dest() { return has_dest_ ? operands[0] : missing("get_dest"); }
+  const Value &get_dest() const {
+    return const_cast<Instruction *>(this)->get_dest();
+  }
+
+  int num_args() const { return arg_count; }
+  std::span<Value> args() {
+    return tail ? std::span<Value>(tail, arg_count)
+                : std::span<Value>(operands + has_dest_, arg_count);
+  }
+  std::span<const Value> args() const {
+    return const_cast<Instruction *>(this)->args();
+  }
+  Value &get_arg1() { return arg_count >= 1 ? args()[0] : missing("get_arg1"); }
+  Value &get_arg2() { return arg_count >= 2 ? args()[1] : missing("get_arg2"); }
+
+  void print(Printer, const SymbolTable &) const;
 };
 
 class Unary : public Instruction {
-private:
-  Value dest;
-  Value arg;
-
 public:
   Unary(Op o, Value, Value, Token t);
-
-  Value &get_dest() override;
-  Value &get_arg1() override;
-
-  void print(Printer, const SymbolTable &) const override;
 };
 
 class New : public Instruction {
-private:
-  Value dest;
-  Symbol type;
-
 public:
   New(Op o, Value, Symbol, Token t);
 
-  Value &get_dest() override;
-
-  void print(Printer, const SymbolTable &) const override;
+  Symbol get_type() const;
 };
 
 class Binary : public Instruction {
-private:
-  Value dest;
-  Value left;
-  Value right;
-
 public:
   Binary(Op o, Value, Value, Value, Token t);
-
-  Value &get_dest() override;
-  Value &get_arg1() override;
-  Value &get_arg2() override;
-
-  void print(Printer, const SymbolTable &) const override;
 };
 
 class Call : public Instruction {
-private:
-  Value dest;
-  Value target;
-  Symbol method_name;
-  std::vector<Value> args;
-
 public:
-  Call(Value, Value, Symbol, Token t);
+  /// The target and arguments are copied to a tail allocated in arena
+  Call(Value dest, Value target, Symbol method_name,
+       const std::vector<Value> &args, Arena &arena, Token t);
 
-  Value &get_dest() override;
-  Value &get_arg1() override;
-
-  void add_arg(const Value &);
+  Symbol get_method_name() const;
+  /// Arguments without the target, which is get_arg1()
+  std::span<Value> call_args();
+};
 
-  void print(Printer, const SymbolTable &) const override;
+/// SSA join: takes the argument coming from the i-th predecessor of its block,
+/// so arguments follow the order of BasicBlock::preds. Phis only exist between
+/// to_ssa and from_ssa (see hlir_ssa.h) and sit at the start of their block,
+/// after its labels.
+class Phi : public Instruction {
+public:
+  /// The arguments are copied to a tail allocated in arena
+  Phi(Value dest, const std::vector<Value> &incoming, Arena &arena, Token t);
 };
 
 class Branch : public Instruction {
-private:
-  Value value;
-  BranchCondition condition;
-  Position target;
-
 public:
   Branch(BranchCondition, Value, Position, Token t);
 
-  Value &get_arg1() override;
-
-  void print(Printer, const SymbolTable &) const override;
+  Position get_target() const;
 };
 
 class Label : public Instruction {
-private:
-  int idx;
-  Symbol name;
-
 public:
   Label(int, Symbol, Token t);
 
-  void print(Printer, const SymbolTable &) const override;
+  int get_idx() const;
+  Symbol get_name() const;
 };
 
 class Mov : public Instruction {
-private:
-  Value dest;
-  Value src;
-
 public:
   Mov(Value, Value, Token t);
-
-  Value &get_dest() override;
-  Value &get_arg1() override;
-
-  void print(Printer, const SymbolTable &) const override;
 };
 
 class Error : public Instruction {
 public:
-  BranchCondition condition;
-  Value check;
-  runtime::Error error;
-
   Error(BranchCondition, Value, runtime::Error, Token t);
-
-  Value &get_arg1() override;
-
-  void print(Printer, const SymbolTable &) const override;
 };
 
 /***********************
  *                     *
- *       Context       *
+ *   InstructionList   *
  *                     *
  **********************/
 
-class Context {
+/// Doubly linked list threaded through the instructions themselves. It never
+/// owns them: instructions live in the Arena of their Method, so erasing only
+/// unlinks and splicing only relinks, both in constant time.
+///
+/// An instruction can only be in one list at a time.
+class InstructionList {
 private:
-  int temporaries;
-  int labels;
+  Instruction *head;
+  Instruction *tail;
+  size_t size_;
+
+  void link_before(Instruction *position, Instruction *);
 
 public:
-  SymbolTable &symbols;
+  class iterator {
+  private:
+    Instruction *node;
+    const InstructionList *list;
 
-  Context(SymbolTable &);
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef Instruction *value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Instruction *pointer;
+    typedef Instruction *reference;
 
-  Value create_temporary(Symbol);
-  int create_label_idx();
+    iterator(Instruction *n, const InstructionList *l);
+
+    Instruction *operator*() const;
+    Instruction *operator->() const;
+
+    iterator &operator++();
+    iterator operator++(int);
+    iterator &operator--();
+    iterator operator--(int);
+
+    bool operator==(const iterator &) const;
+  };
+
+  InstructionList();
+
+  InstructionList(const InstructionList &) = delete;
+  InstructionList &operator=(const InstructionList &) = delete;
+  InstructionList(InstructionList &&) noexcept;
+  InstructionList &operator=(InstructionList &&) noexcept;
+
+  iterator begin() const;
+  iterator end() const;
+
+  size_t size() const;
+  bool empty() const;
+
+  Instruction *front() const;
+  Instruction *back() const;
+
+  void push_back(Instruction *);
+  void push_front(Instruction *);
+  /// Inserts before position and returns an iterator to the new instruction
+  iterator insert(iterator position, Instruction *);
+  /// Unlinks the instruction at position and returns the one after it
+  iterator erase(iterator position);
+  /// Moves every instruction of other before position, leaving other empty
+  void splice(iterator position, InstructionList &&other);
 };
 
 /***********************
@@ -289,15 +394,88 @@ public:
  **********************/
 
 class Method {
+private:
+  int temporaries;
+  int labels;
+
 public:
   Symbol name;
+  /// Owns every instruction of this method
+  Arena arena;
   InstructionList instructions;
 
   Method(Symbol);
 
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    return arena.create<T>(std::forward<Args>(args)...);
+  }
+
+  Value create_temporary(Symbol);
+  int create_label_idx();
+  /// Temporary ids handed out so far, all below this
+  int num_temporaries() const;
+  /// Label indices handed out so far, all below this
+  int num_labels() const;
+
   void print(Printer, const SymbolTable &) const;
 };
 
+/***********************
+ *                     *
+ *       Context       *
+ *                     *
+ **********************/
+
+/// How lowered expressions hand their values to the code using them
+enum class Lowering {
+  /// Every expression leaves its value in acc, and the code using it copies
+  /// it out to wherever it is needed
+  THROUGH_ACC,
+  /// Every expression is told where its value is wanted and writes it there
+  /// directly. Variables and constants used as operands are read in place.
+  DESTINATION_PASSING,
+};
+
+/// Emits instructions at the end of a method as they are created, so that a
+/// whole method is lowered in one pass without building lists for its parts
+class Builder {
+private:
+  Method &method;
+
+public:
+  explicit Builder(Method &);
+
+  template <typename T, typename... Args> T *emit(Args &&...args) {
+    T *instruction = method.create<T>(std::forward<Args>(args)...);
+    method.instructions.push_back(instruction);
+    return instruction;
+  }
+};
+
+/// State for lowering the body of one method
+class Context {
+public:
+  SymbolTable &symbols;
+  /// Layout of the class being lowered, used to resolve attribute offsets
+  const ObjectLayout &layout;
+  /// Method being lowered. New instructions are allocated in its arena.
+  Method &method;
+  Lowering lowering;
+  Builder builder;
+
+  Context(SymbolTable &, const ObjectLayout &, Method &, Lowering);
+
+  /// Appends a new instruction to the method being lowered
+  template <typename T, typename... Args> T *emit(Args &&...args) {
+    return builder.emit<T>(std::forward<Args>(args)...);
+  }
+
+  Value create_temporary(Symbol);
+  int create_label_idx();
+  /// ATTRIBUTE value for a field of the class being lowered
+  Value attribute(Symbol name, Symbol static_type) const;
+};
+
 /***********************
  *                     *
  *        Class        *
@@ -307,10 +485,12 @@ public:
 class Class {
 public:
   Symbol name;
-  InstructionList initializer;
-  std::unordered_map<int, Method> methods;
+  /// Superclass, which is outside the universe for the built-in classes
+  Symbol parent;
+  Method initializer;
+  SmallSymbolMap<Method> methods;
 
-  Class(Symbol);
+  Class(Symbol name, Symbol initializer_name);
 
   void print(Printer, const SymbolTable &) const;
 };
@@ -323,7 +503,7 @@ public:
 
 class Universe {
 public:
-  std::unordered_map<int, Class> classes;
+  SymbolMap<Class> classes;
 
   void print(Printer, const SymbolTable &) const;
 };
@@ -0,0 +1,152 @@
+#ifndef _HLIR_ANALYSIS_H
+#define _HLIR_ANALYSIS_H
+
+#include "hlir.h"
+#include "hlir_cfg.h"
+#include "hlir_dataflow.h"
+#include "hlir_dominators.h"
+#include "symbol_map.h"
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <unordered_map>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *  PreservedAnalyses  *
+ *                     *
+ **********************/
+
+/// Analyses that can be cached for a method
+enum class Analysis : uint8_t {
+  CFG = 1 << 0,
+  DOMINATORS = 1 << 1,
+  LIVENESS = 1 << 2,
+  REACHING_DEFINITIONS = 1 << 3,
+};
+
+/// Analyses a change to a method leaves valid. Every analysis is built over
+/// the CFG, so none of them survives without it.
+class PreservedAnalyses {
+private:
+  uint8_t bits;
+
+public:
+  PreservedAnalyses(std::initializer_list<Analysis>);
+
+  static PreservedAnalyses none();
+  static PreservedAnalyses all();
+
+  bool preserves(Analysis) const;
+};
+
+/***********************
+ *                     *
+ *   MethodAnalyses    *
+ *                     *
+ **********************/
+
+/// Analyses of one method, computed the first time they are asked for and
+/// cached until they are invalidated. Whoever changes the method must
+/// invalidate what the change breaks: passes declare it once (Pass::preserves)
+/// and the PassManager invalidates the rest after running them, but a pass
+/// asking for an analysis again after changing the method must invalidate it
+/// first itself.
+///
+/// Each analysis counts how often it was reused ("hits") or computed
+/// ("misses") in the "analysis" statistics.
+class MethodAnalyses {
+private:
+  Method &method;
+  const SymbolMap<bool> *pure_classes_;
+
+  // Kept after being invalidated, so that rebuilding reuses its storage
+  std::unique_ptr<CFG> cfg;
+  bool cfg_valid;
+
+  std::unique_ptr<DominatorTree> dominators;
+  std::unique_ptr<Liveness> liveness;
+  std::unique_ptr<ReachingDefinitions> reaching_definitions;
+
+  // By bit position of the Analysis
+  uint64_t hit_counts[4];
+  uint64_t miss_counts[4];
+  // Parts of the counts already added to the statistics
+  uint64_t reported_hits[4];
+  uint64_t reported_misses[4];
+
+  void record(Analysis, bool hit);
+
+public:
+  /// pure_classes outlives the analyses, if given
+  explicit MethodAnalyses(Method &,
+                          const SymbolMap<bool> *pure_classes = nullptr);
+  /// Reports what is left to report
+  ~MethodAnalyses();
+
+  MethodAnalyses(const MethodAnalyses &) = delete;
+  MethodAnalyses &operator=(const MethodAnalyses &) = delete;
+
+  Method &get_method() const;
+  /// Classes whose objects can be created and dropped without anyone noticing,
+  /// found once for the whole universe. Classes missing from it, and every
+  /// class when there is no universe, are assumed to have effects.
+  const SymbolMap<bool> &pure_classes() const;
+
+  template <typename T> T &get();
+
+  /// Times an analysis was asked for and reused
+  uint64_t hits(Analysis) const;
+  /// Times an analysis was asked for and computed
+  uint64_t misses(Analysis) const;
+
+  /// Adds the hits and misses since the last report to the statistics
+  void report_statistics();
+
+  /// Drops one analysis, and every analysis built over it
+  void invalidate(Analysis);
+  /// Drops every analysis not preserved
+  void invalidate(const PreservedAnalyses &);
+};
+
+template <> CFG &MethodAnalyses::get<CFG>();
+template <> DominatorTree &MethodAnalyses::get<DominatorTree>();
+template <> Liveness &MethodAnalyses::get<Liveness>();
+template <> ReachingDefinitions &MethodAnalyses::get<ReachingDefinitions>();
+
+/***********************
+ *                     *
+ *   AnalysisManager   *
+ *                     *
+ **********************/
+
+/// Cached analyses of every method of a universe. Methods are added the first
+/// time they are asked for, so a method must be asked for once on one thread
+/// before several threads can ask for different methods at the same time.
+class AnalysisManager {
+private:
+  std::unordered_map<const Method *, std::unique_ptr<MethodAnalyses>>
+      methods;
+  SymbolMap<bool> pure_classes;
+
+public:
+  MethodAnalyses &of(Method &);
+
+  /// Facts about the whole universe, which method passes cannot find on their
+  /// own. Set before any method is asked for, and kept until the end.
+  void set_pure_classes(SymbolMap<bool>);
+
+  /// Drops every analysis not preserved, in every method
+  void invalidate(const PreservedAnalyses &);
+  /// Adds the hits and misses of every method since the last report to the
+  /// statistics, so that they show up under the pass that caused them
+  void report_statistics();
+  /// Forgets every method, reporting what is left to report
+  void clear();
+};
+
+} // namespace hlir
+
+#endif // !_HLIR_ANALYSIS_H
@@ -0,0 +1,141 @@
+#ifndef _HLIR_CFG_H
+#define _HLIR_CFG_H
+
+#include "hlir.h"
+#include "printer.h"
+#include "symbol.h"
+#include <span>
+#include <vector>
+
+namespace hlir {
+
+typedef int BlockIdx;
+
+const BlockIdx NO_BLOCK = -1;
+
+/***********************
+ *                     *
+ *     BasicBlock      *
+ *                     *
+ **********************/
+
+/// Run of instructions that is only entered at its first instruction and only
+/// left after its last one. Blocks are views: their instructions stay in the
+/// InstructionList of the method, from first to last inclusive. A block left
+/// empty by erasing has both set to nullptr.
+class BasicBlock {
+public:
+  class iterator {
+  private:
+    Instruction *node;
+    Instruction *last;
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Instruction *value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Instruction *pointer;
+    typedef Instruction *reference;
+
+    iterator(Instruction *n, Instruction *l);
+
+    Instruction *operator*() const;
+    iterator &operator++();
+    iterator operator++(int);
+
+    bool operator==(const iterator &) const;
+  };
+
+  BlockIdx idx;
+  Instruction *first;
+  Instruction *last;
+
+  /// Edges are unique: a conditional branch to the next block is one edge
+  std::vector<BlockIdx> preds;
+  std::vector<BlockIdx> succs;
+  /// Successor reached by running past the last instruction, or NO_BLOCK
+  BlockIdx fallthrough;
+
+  explicit BasicBlock(BlockIdx);
+
+  iterator begin() const;
+  iterator end() const;
+
+  bool empty() const;
+  /// The Branch or unconditional Error ending the block, if any
+  Instruction *terminator() const;
+};
+
+/***********************
+ *                     *
+ *         CFG         *
+ *                     *
+ **********************/
+
+/// Control-flow graph of one Method, built over its instruction list.
+///
+/// Blocks are numbered in list order and the first one is the entry. Blocks
+/// start at labels (consecutive labels share a block) and after instructions
+/// that leave the block: branches and unconditional errors. Running off the
+/// end of the last block returns from the method.
+///
+/// Instructions can be added and removed through insert and erase, which keep
+/// block bounds right. Edges are only recomputed by rebuild, which must be
+/// called after changing labels or terminators. Rebuilding is one pass over
+/// the instructions and reuses the storage of the previous graph.
+class CFG {
+private:
+  Method &method;
+  std::vector<BasicBlock> blocks_;
+  size_t size_;
+  /// Block holding each label, by label index
+  std::vector<BlockIdx> label_blocks;
+
+  BlockIdx start_block(Instruction *);
+  void add_edge(BlockIdx from, BlockIdx to);
+  /// Index of the label at the start of a block, adding one if it has none
+  int ensure_label(BlockIdx, const SymbolTable &);
+
+public:
+  explicit CFG(Method &);
+
+  CFG(const CFG &) = delete;
+  CFG &operator=(const CFG &) = delete;
+
+  void rebuild();
+
+  Method &get_method() const;
+
+  size_t size() const;
+  BlockIdx entry() const;
+  BasicBlock &block(BlockIdx);
+  const BasicBlock &block(BlockIdx) const;
+  std::span<BasicBlock> blocks();
+  std::span<const BasicBlock> blocks() const;
+
+  /// Target block of a label, or NO_BLOCK if it is not in the method
+  BlockIdx block_of_label(int label_idx) const;
+
+  /// Blocks reachable from the entry, each before its successors except
+  /// along back edges
+  std::vector<BlockIdx> reverse_postorder() const;
+
+  /// Inserts before position, which must be in the block. A null position
+  /// appends after the last instruction of the block.
+  void insert(BlockIdx, Instruction *position, Instruction *);
+  /// Unlinks an instruction of the block from the method
+  void erase(BlockIdx, Instruction *);
+
+  /// Rewrites the method with its blocks laid out in the given order, then
+  /// rebuilds. Blocks left out are dropped, so none of the blocks kept may
+  /// branch or fall through to them. Jumps and labels are added where a block
+  /// no longer falls through to its successor, and jumps to the block right
+  /// after are removed.
+  void linearize(std::span<const BlockIdx> order, const SymbolTable &);
+
+  void print(Printer, const SymbolTable &) const;
+};
+
+} // namespace hlir
+
+#endif // !_HLIR_CFG_H
@@ -0,0 +1,147 @@
+#ifndef _HLIR_DATAFLOW_H
+#define _HLIR_DATAFLOW_H
+
+#include "bitset.h"
+#include "hlir.h"
+#include "hlir_cfg.h"
+#include "symbol_map.h"
+#include <vector>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *    VariableIndex    *
+ *                     *
+ **********************/
+
+/// Dense ids for the values of a method that hold state between instructions:
+/// acc, then every temporary and local it reads or writes. Used to index
+/// dataflow bitsets.
+class VariableIndex {
+private:
+  std::vector<int> temps;
+  SmallSymbolMap<int> locals;
+  std::vector<Value> values;
+
+public:
+  static constexpr int ACC = 0;
+
+  explicit VariableIndex(const Method &);
+
+  size_t size() const;
+  /// Id of a value, or -1 if it is not a variable
+  int of(Value) const;
+  /// A value with the given id, typed as first seen
+  Value value(int id) const;
+};
+
+/***********************
+ *                     *
+ *   DataflowProblem   *
+ *                     *
+ **********************/
+
+enum class Direction {
+  FORWARD,
+  BACKWARD,
+};
+
+/// A monotone dataflow problem over bitsets, solved by solve_dataflow.
+///
+/// Problems describe one block at a time: transfer computes the fact at one
+/// end of a block from the fact at the other, and meet combines the facts
+/// flowing into a block from its neighbours. Blocks with no neighbours on the
+/// incoming side start from boundary instead.
+class DataflowProblem {
+public:
+  Direction direction;
+  size_t num_bits;
+
+  DataflowProblem(Direction, size_t num_bits);
+  virtual ~DataflowProblem() = default;
+
+  /// Fact every block starts with before solving. Empty by default, which is
+  /// right for problems meeting with union.
+  virtual BitSet initial() const;
+  /// Fact entering the method (forward) or leaving the block (backward) at
+  /// the given block, which has no neighbours on that side. Empty by default.
+  virtual BitSet boundary(const CFG &, BlockIdx) const;
+  /// into = into meet from. Union by default.
+  virtual void meet(BitSet &into, const BitSet &from) const;
+  /// Sets out from in and returns whether out changed
+  virtual bool transfer(BlockIdx, const BitSet &in, BitSet &out) const = 0;
+};
+
+/// Problems whose transfer is out = gen | (in & ~kill) with fixed sets per
+/// block, which subclasses fill in
+class GenKillProblem : public DataflowProblem {
+protected:
+  std::vector<BitSet> gen;
+  std::vector<BitSet> kill;
+
+public:
+  GenKillProblem(Direction, size_t num_bits, size_t num_blocks);
+
+  bool transfer(BlockIdx, const BitSet &in, BitSet &out) const override;
+};
+
+/// Facts at the start and at the end of every block, whatever the direction
+struct DataflowResult {
+  std::vector<BitSet> in;
+  std::vector<BitSet> out;
+};
+
+/// Iterates the problem to its fixed point. Blocks are visited in reverse
+/// postorder (postorder for backward problems), sweeping again over the ones
+/// whose inputs changed until none do. Unreachable blocks are solved too,
+/// after the others.
+DataflowResult solve_dataflow(const CFG &, const DataflowProblem &);
+
+/***********************
+ *                     *
+ *      Liveness       *
+ *                     *
+ **********************/
+
+/// Variables whose current value may still be read. acc is live at the end of
+/// the returning block, since it holds the value of the method.
+class Liveness {
+private:
+  VariableIndex index;
+  DataflowResult result;
+
+public:
+  explicit Liveness(const CFG &);
+
+  const VariableIndex &variables() const;
+  const BitSet &live_in(BlockIdx) const;
+  const BitSet &live_out(BlockIdx) const;
+};
+
+/***********************
+ *                     *
+ * ReachingDefinitions *
+ *                     *
+ **********************/
+
+/// Writes to variables that may reach each point without being overwritten.
+/// Bit i stands for definitions()[i], numbered in list order.
+class ReachingDefinitions {
+private:
+  VariableIndex index;
+  std::vector<Instruction *> definitions_;
+  DataflowResult result;
+
+public:
+  explicit ReachingDefinitions(const CFG &);
+
+  const VariableIndex &variables() const;
+  const std::vector<Instruction *> &definitions() const;
+  const BitSet &reaching_in(BlockIdx) const;
+  const BitSet &reaching_out(BlockIdx) const;
+};
+
+} // namespace hlir
+
+#endif // !_HLIR_DATAFLOW_H
@@ -0,0 +1,55 @@
+#ifndef _HLIR_DOMINATORS_H
+#define _HLIR_DOMINATORS_H
+
+#include "hlir_cfg.h"
+#include <vector>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *    DominatorTree    *
+ *                     *
+ **********************/
+
+/// Immediate dominators and dominance frontiers of the blocks of a CFG, using
+/// the iterative algorithm of Cooper, Harvey and Kennedy ("A Simple, Fast
+/// Dominance Algorithm"). Blocks unreachable from the entry are not part of
+/// the tree.
+///
+/// The tree describes the CFG at the time it was built and must be built
+/// again after the CFG changes shape.
+class DominatorTree {
+private:
+  std::vector<BlockIdx> order;
+  std::vector<BlockIdx> idoms;
+  std::vector<std::vector<BlockIdx>> children_;
+  std::vector<std::vector<BlockIdx>> frontiers;
+  // Preorder and postorder numbers in the tree, to answer dominates() in
+  // constant time
+  std::vector<int> preorder;
+  std::vector<int> postorder;
+
+  BlockIdx intersect(BlockIdx, BlockIdx,
+                     const std::vector<int> &rpo_numbers) const;
+  void number_tree(BlockIdx root);
+
+public:
+  explicit DominatorTree(const CFG &);
+
+  bool reachable(BlockIdx) const;
+  /// NO_BLOCK for the entry and unreachable blocks
+  BlockIdx idom(BlockIdx) const;
+  /// Whether every path from the entry to b goes through a. Blocks dominate
+  /// themselves.
+  bool dominates(BlockIdx a, BlockIdx b) const;
+
+  const std::vector<BlockIdx> &children(BlockIdx) const;
+  const std::vector<BlockIdx> &frontier(BlockIdx) const;
+  /// Reachable blocks in reverse postorder of the CFG
+  const std::vector<BlockIdx> &reverse_postorder() const;
+};
+
+} // namespace hlir
+
+#endif // !_HLIR_DOMINATORS_H
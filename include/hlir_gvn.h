@@ -0,0 +1,42 @@
+#ifndef _HLIR_GVN_H
+#define _HLIR_GVN_H
+
+#include "hlir.h"
+#include "hlir_cfg.h"
+#include "hlir_dominators.h"
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *         GVN         *
+ *                     *
+ **********************/
+
+/// Dominator-based global value numbering over a method in SSA form (see
+/// hlir_ssa.h).
+///
+/// Blocks are visited down the dominator tree with a scoped table of the
+/// pure computations seen on the way from the entry. A computation of the
+/// same operation on the same values as one in a dominating block is removed
+/// and its readers use the earlier temporary instead. Copies and phis whose
+/// arguments all agree are removed the same way.
+///
+/// Attributes are memory, so a load is only replaced by an earlier load or
+/// store of the same attribute when nothing in between can have changed it.
+/// Only movs count as stores; any other instruction writing an attribute
+/// leaves its contents unknown.
+/// Calls and object creation run arbitrary code and forget every attribute,
+/// and so does entering a block with several predecessors, since another
+/// path may have stored to it.
+///
+/// Only instructions are removed, so the CFG keeps its shape. Returns whether
+/// a computation, a phi or a load was. Copies alone do not count, since
+/// going through SSA form adds them back.
+bool number_values(CFG &);
+/// Same, walking a dominator tree already built for the CFG
+bool number_values(CFG &, const DominatorTree &);
+
+} // namespace hlir
+
+#endif // !_HLIR_GVN_H
@@ -2,7 +2,13 @@
 #define _HLIR_OPTIMIZER_H
 
 #include "hlir.h"
+#include "hlir_analysis.h"
 #include "optimizer_config.h"
+#include "symbol.h"
+#include "thread_pool.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace hlir {
 
@@ -16,29 +22,69 @@ class Pass {
 public:
   std::string name;
   PassScope pass_scope;
+  /// Analyses still valid after the pass runs, which the PassManager keeps.
+  /// The pass must invalidate them itself if it asks for them again after
+  /// breaking them.
+  PreservedAnalyses preserves;
 
-  Pass(std::string n, PassScope ps);
+  Pass(std::string n, PassScope ps,
+       PreservedAnalyses p = PreservedAnalyses::none());
 
-  virtual void run(hlir::Universe &, const OptimizerConfig &) const;
-  virtual void run_class(hlir::Class &, const OptimizerConfig &) const;
-  virtual void run_method(hlir::InstructionList &,
-                          const OptimizerConfig &) const;
+  // Each returns whether it changed anything
+  virtual bool run(hlir::Universe &, AnalysisManager &,
+                   const OptimizerConfig &, const SymbolTable &) const;
+  virtual bool run_class(hlir::Class &, AnalysisManager &,
+                         const OptimizerConfig &, const SymbolTable &) const;
+  virtual bool run_method(hlir::Method &, MethodAnalyses &,
+                          const OptimizerConfig &, const SymbolTable &) const;
 };
 
+/// Splits a pipeline string at the commas outside parentheses, dropping
+/// empty items
+std::vector<std::string> split_pipeline(const std::string &);
+
+/// The pass with a name, or nullptr if there is none. "fixpoint(a,b,...)"
+/// names a group of Method passes run over each method in turn, again and
+/// again until none of them changes it (or OptimizerConfig::fixpoint_rounds
+/// runs out).
+std::unique_ptr<Pass> make_pass(const std::string &name);
+
+/// Names of the passes run at a level, in order
+std::vector<std::string> default_pipeline(OptimizationLevel);
+
+/// Runs the pass pipeline over a universe: the passes the config names, or
+/// else the pipeline of its level. Method passes only ever touch one
+/// method at a time, so with a ThreadPool they run on every method (and class
+/// initializer) concurrently. Other passes always run on the calling thread.
+///
+/// Analyses are cached across passes, and after each pass only those it does
+/// not preserve are dropped. The cache goes once the pipeline is done.
 class PassManager {
 private:
   std::vector<std::unique_ptr<Pass>> pass_pipeline;
   hlir::Universe &universe;
   const OptimizerConfig &config;
+  const SymbolTable &symbols;
+  ThreadPool *pool;
+  AnalysisManager analyses;
 
   int current_pass;
 
+  /// Runs the Method passes in [first, last) of the pipeline. Each method goes
+  /// through all of them before the next one starts, while it is still hot in
+  /// cache.
+  void run_method_passes(int first, int last);
+
 public:
-  PassManager(hlir::Universe &, const OptimizerConfig &);
+  PassManager(hlir::Universe &, const OptimizerConfig &, const SymbolTable &,
+              ThreadPool * = nullptr);
 
   bool is_done();
 
   const Pass &run_pass();
+  /// Runs every consecutive Method pass starting at the current one together,
+  /// or a single pass of any other scope. Returns the passes it ran.
+  std::vector<const Pass *> run_stage();
 };
 
 } // namespace hlir
@@ -0,0 +1,40 @@
+#ifndef _HLIR_SCCP_H
+#define _HLIR_SCCP_H
+
+#include "hlir.h"
+#include "hlir_cfg.h"
+#include "symbol.h"
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *        SCCP         *
+ *                     *
+ **********************/
+
+/// Sparse conditional constant propagation (Wegman and Zadeck) over a method
+/// in SSA form (see hlir_ssa.h).
+///
+/// Every temporary starts out undefined and only moves down towards "not a
+/// constant", while only the edges out of blocks that can run, and that their
+/// branches can take given the constants found so far, are followed. This
+/// finds constants flowing around loops and through branches that a pass
+/// assuming every edge can be taken would miss.
+///
+/// The method is then rewritten: reads of constant temporaries become the
+/// constant and their writes go, branches on constants become unconditional
+/// or go, and blocks that can never run are dropped together with their phi
+/// arguments. The result is still in SSA form and the CFG is rebuilt.
+///
+/// Each temporary is lowered at most twice and each edge followed once, so
+/// solving is linear in the size of the method.
+///
+/// Returns whether anything was rewritten beyond what going through SSA form
+/// adds and leaving it puts back: a computation or copy found constant, a
+/// constant read in its place, a branch resolved or a block dropped.
+bool propagate_constants(CFG &, const SymbolTable &);
+
+} // namespace hlir
+
+#endif // !_HLIR_SCCP_H
@@ -0,0 +1,91 @@
+#ifndef _HLIR_SSA_H
+#define _HLIR_SSA_H
+
+#include "hlir.h"
+#include "hlir_analysis.h"
+#include "hlir_cfg.h"
+#include "symbol.h"
+#include <vector>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *      SSA form       *
+ *                     *
+ **********************/
+
+/// Rewrites a method into SSA form: every write to acc, a local or a
+/// temporary becomes the only write to a fresh temporary, and reads use the
+/// temporary of the write that reaches them, joined by Phi instructions where
+/// control flow merges.
+///
+/// Phis are placed on the dominance frontiers of the writes, only for names
+/// read in a block other than the one writing them (semi-pruned SSA).
+/// Unreachable blocks are dropped first, since they have no dominators, and a
+/// method starting with a loop gets a separate entry block.
+///
+/// Reads that no write reaches, such as method arguments, keep their original
+/// value. Attributes are memory and are not renamed. The value of the method
+/// stays in acc: the returning block ends with a mov of the last value of acc
+/// into it, which is the only write to acc in SSA form.
+///
+/// The CFG is rebuilt when blocks are dropped. Any DominatorTree of it must be
+/// built again afterwards.
+void to_ssa(CFG &, const SymbolTable &);
+/// Same, over the cached CFG of a method. Its dominator tree is reused unless
+/// blocks are dropped, and is the only other analysis left valid.
+void to_ssa(MethodAnalyses &, const SymbolTable &);
+
+/// Replaces every Phi with copies on its incoming edges. Each phi gets a
+/// temporary of its own, written at the end of every predecessor and read at
+/// the start of the phi block, so copies for different phis can never
+/// overwrite each other and critical edges need no splitting.
+void from_ssa(CFG &);
+
+/// The instructions of a method and their operands, taken before to_ssa, so
+/// that a pass finding nothing to rewrite in SSA form can put the method back
+/// as it was instead of leaving the copies of from_ssa behind. Instructions
+/// created in between stay unused in the arena.
+class SSASnapshot {
+private:
+  Method &method;
+  std::vector<Instruction *> instructions;
+  std::vector<BranchCondition> conditions;
+  // Destination and arguments of each instruction, in list order
+  std::vector<Value> operands;
+
+public:
+  explicit SSASnapshot(Method &);
+
+  /// Puts back the instructions and operands. Any CFG of the method must be
+  /// rebuilt afterwards.
+  void restore();
+};
+
+/***********************
+ *                     *
+ *       DefUse        *
+ *                     *
+ **********************/
+
+/// Sparse def-use chains for the temporaries of a method in SSA form, so that
+/// passes can go from a value to its readers without scanning the method.
+/// Chains describe the method when they were built.
+class DefUse {
+private:
+  std::vector<Instruction *> defs;
+  std::vector<std::vector<Instruction *>> uses_;
+
+public:
+  explicit DefUse(const Method &);
+
+  /// The instruction writing a temporary, or nullptr if none does
+  Instruction *def(int temp) const;
+  /// Every instruction reading a temporary, once each, in list order
+  const std::vector<Instruction *> &uses(int temp) const;
+};
+
+} // namespace hlir
+
+#endif // !_HLIR_SSA_H
@@ -0,0 +1,98 @@
+#ifndef _OBJECT_LAYOUT_H
+#define _OBJECT_LAYOUT_H
+
+#include "symbol.h"
+#include "symbol_map.h"
+#include <vector>
+
+/***********************
+ *                     *
+ *      FieldKind      *
+ *                     *
+ **********************/
+
+/// How an attribute is stored inside an object
+enum class FieldKind {
+  /// Pointer to another object (including String and every user class)
+  REFERENCE,
+  /// Unboxed 32-bit integer
+  INT,
+  /// Unboxed 8-bit boolean
+  BOOL,
+};
+
+std::string to_string(FieldKind);
+
+/***********************
+ *                     *
+ *        Field        *
+ *                     *
+ **********************/
+
+class Field {
+public:
+  Symbol name;
+  Symbol type;
+  FieldKind kind;
+  /// Byte offset from the start of the object, header included
+  int offset;
+
+  int size() const;
+};
+
+/***********************
+ *                     *
+ *     ObjectLayout    *
+ *                     *
+ **********************/
+
+/// Where each attribute of a class lives in memory.
+///
+/// Objects start with a fixed header (class tag, object size and dispatch
+/// table). After it comes the layout of the superclass unchanged, so code
+/// compiled against a superclass can read fields of any subclass. The fields a
+/// class adds follow, with reference fields grouped together and Int and Bool
+/// attributes stored unboxed. Small fields first fill the padding left at the
+/// end of the superclass layout.
+class ObjectLayout {
+private:
+  std::vector<Field> fields_;
+  SmallSymbolMap<int> field_idx;
+  std::vector<int> reference_offsets_;
+  /// End of the last field, before rounding up to the object alignment
+  int end;
+
+  void add_field(Symbol name, Symbol type, FieldKind kind, int offset);
+
+public:
+  static constexpr int HEADER_SIZE = 16;
+  static constexpr int REFERENCE_SIZE = 8;
+  static constexpr int INT_SIZE = 4;
+  static constexpr int BOOL_SIZE = 1;
+  /// Objects are allocated at multiples of this
+  static constexpr int ALIGNMENT = 8;
+
+  /// Layout for a class without attributes
+  ObjectLayout();
+
+  /// Extends a superclass layout with the attributes a class adds, given as
+  /// (name, declared type) in declaration order. Attributes the superclass
+  /// already has keep their inherited field.
+  static ObjectLayout
+  extend(const ObjectLayout &superclass,
+         const std::vector<std::pair<Symbol, Symbol>> &attributes,
+         const SymbolTable &);
+
+  static FieldKind field_kind(Symbol type, const SymbolTable &);
+
+  /// Size of an instance in bytes, header included
+  int size() const;
+
+  const Field *field(Symbol name) const;
+  /// All fields by increasing offset
+  const std::vector<Field> &fields() const;
+  /// Offsets of every reference field, which is what a collector has to scan
+  const std::vector<int> &reference_offsets() const;
+};
+
+#endif // !_OBJECT_LAYOUT_H
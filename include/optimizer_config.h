@@ -1,7 +1,35 @@
 #ifndef _OPTIMIZER_CONFIG_H
 #define _OPTIMIZER_CONFIG_H
 
-// TODO(IT) design and implement configuration parameters
-struct OptimizerConfig {};
+#include <string>
+#include <vector>
+
+/// How hard the optimizer tries, trading compile time for better code
+enum class OptimizationLevel {
+  /// No passes at all
+  O0,
+  /// Cheap cleanups that need no SSA form
+  O1,
+  /// Every pass once
+  O2,
+  /// The O1 cleanups first, iterated to a fixed point, so that the SSA
+  /// passes work on smaller methods
+  O3,
+};
+
+struct OptimizerConfig {
+  OptimizationLevel level = OptimizationLevel::O2;
+  /// Passes to run by name, in order, instead of the pipeline of the level
+  std::vector<std::string> passes;
+
+  /// Most rounds constant_folding runs on a method, or 0 for no limit
+  unsigned int folding_rounds = 0;
+  /// Most sweeps dce makes over a method, or 0 for no limit
+  unsigned int dce_sweeps = 0;
+  /// Most rounds a fixpoint(...) group runs on a method, or 0 for no limit.
+  /// Every pass settles on its own, so this only bounds how long a group may
+  /// keep finding more.
+  unsigned int fixpoint_rounds = 8;
+};
 
 #endif // !_OPTIMIZER_CONFIG_H
@@ -1,10 +1,11 @@
 #ifndef _RUNTIME_H
 #define _RUNTIME_H
 
+#include <cstdint>
 #include <string>
 
 namespace runtime {
-enum class Error {
+enum class Error : uint8_t {
   CASE_VOID,
   CASE_UNMATCHED,
 };
@@ -3,8 +3,11 @@
 
 #include "ast.h"
 #include "lifetime.h"
+#include "object_layout.h"
 #include "symbol.h"
-#include <forward_list>
+#include "symbol_map.h"
+#include <unordered_set>
+#include <vector>
 
 /***********************
  *                     *
@@ -32,7 +35,11 @@ public:
 
 class Scopes {
 private:
-  std::forward_list<std::unordered_map<int, VarInfo>> scopes;
+  // Every binding of a name, innermost last, with the depth of its scope. Each
+  // lookup is then a single index, however deep the scopes are nested.
+  SymbolMap<std::vector<std::pair<size_t, VarInfo>>> bindings;
+  // Names bound in each open scope, innermost last, to unbind on exit
+  std::vector<std::vector<Symbol>> scopes;
 
 public:
   Scopes();
@@ -56,8 +63,8 @@ typedef int ClassIdx;
 
 class ClassInfo {
 private:
-  std::unordered_map<int, MethodNode *> methods_;
-  std::unordered_map<int, AttributeNode *> attributes_;
+  SmallSymbolMap<MethodNode *> methods_;
+  SmallSymbolMap<AttributeNode *> attributes_;
   ClassNode *class_node;
   int depth_;
 
@@ -70,8 +77,8 @@ public:
   Symbol name() const;
   Symbol superclass() const;
 
-  MethodNode *method(Symbol name);
-  AttributeNode *attribute(Symbol name);
+  MethodNode *method(Symbol name) const;
+  AttributeNode *attribute(Symbol name) const;
 
   std::vector<Symbol> methods() const;
   std::vector<Symbol> attributes() const;
@@ -86,9 +93,16 @@ public:
 class ClassTree {
 private:
   std::vector<ClassInfo> classes;
-  std::unordered_map<int, ClassIdx> classes_by_name;
+  SymbolMap<ClassIdx> classes_by_name;
   SymbolTable &symbols;
 
+  std::vector<ObjectLayout> layouts;
+
+  // Features visible in each class, indexed like classes. Each table is
+  // derived from its superclass's and shares its storage.
+  std::vector<PersistentSymbolMap<MethodNode *>> visible_methods;
+  std::vector<PersistentSymbolMap<AttributeNode *>> visible_attributes;
+
   // Nodes for builtin classes
   std::unique_ptr<ClassNode> objectClassNode;
   std::unique_ptr<ClassNode> ioClassNode;
@@ -96,7 +110,7 @@ private:
   std::unique_ptr<ClassNode> intClassNode;
   std::unique_ptr<ClassNode> boolClassNode;
 
-  void check_class_hierarchy(const std::unordered_map<int, ClassNode *> &,
+  void check_class_hierarchy(const SymbolMap<ClassNode *> &,
                              ModuleNode *);
 
   std::unique_ptr<MethodNode>
@@ -104,12 +118,15 @@ private:
                       std::vector<Symbol> parameter_names,
                       std::vector<Symbol> parameter_types);
 
-  std::unordered_map<int, ClassNode *> get_class_node_map(ModuleNode *) const;
+  SymbolMap<ClassNode *> get_class_node_map(ModuleNode *) const;
   std::vector<Symbol> get_classes_by_depth(ModuleNode *) const;
 
   void add_default_classes();
   void add_class(ClassNode *, int depth);
 
+  /// The index of the class with a name, or nullptr for unknown classes
+  const ClassIdx *find(Symbol name) const;
+
 public:
   ClassTree(ModuleNode *, SymbolTable &);
 
@@ -129,9 +146,18 @@ public:
   bool is_subclass(Symbol name_a, Symbol name_b) const;
   bool is_subclass(const ClassInfo &class_a, const ClassInfo &class_b) const;
 
+  /// Nearest definition of a feature in a class or its superclasses, found
+  /// with one lookup in the class's table of visible features.
   MethodNode *get_method(Symbol class_name, Symbol method_name) const;
   AttributeNode *get_attribute(Symbol class_name, Symbol attribute_name) const;
 
+  /// All attributes visible in a class, each with its nearest definition.
+  /// Empty for unknown classes.
+  const PersistentSymbolMap<AttributeNode *> &
+  get_attributes(Symbol class_name) const;
+  /// Memory layout of instances of a class. Empty for unknown classes.
+  const ObjectLayout &get_layout(Symbol class_name) const;
+
   void print(std::ostream *out);
 };
 
@@ -149,13 +175,66 @@ public:
   Symbol current_class;
   const ClassTree &class_tree;
   SymbolTable &symbols;
+  /// When set, collects the classes whose signatures the typecheck consulted
+  std::unordered_set<int> *dependencies;
+
+  void depend_on(Symbol class_name) const;
 
   bool match(Symbol type_a, Symbol type_b) const;
 
   VarInfo get_var(Symbol name) const;
   MethodNode *get_method(Symbol class_name, Symbol method_name) const;
+  std::optional<ClassInfo> common_ancestor(Symbol type_a, Symbol type_b) const;
 
   void assign_attributes(Symbol class_name);
 };
 
+/***********************
+ *                     *
+ * IncrementalAnalysis *
+ *                     *
+ **********************/
+
+/// Keeps the typed AST between runs of semantic analysis, so that re-analysing
+/// an edited program only typechecks the classes affected by the edit.
+///
+/// A class is checked again when its own body changed, when a class whose
+/// signature it consulted changed its signature (or disappeared), or when it
+/// failed to typecheck last time. Any other class keeps its typed nodes from
+/// the previous run, including their token positions.
+///
+/// Not used by the driver yet: coolc analyses each file once, through
+/// run_semantic_analysis, and has no re-analysis path to plug this into. It is
+/// only exercised by test/test_incremental.cc for now.
+class IncrementalAnalysis {
+private:
+  struct ClassRecord {
+    size_t body_hash;
+    bool check;
+    /// Signature hash of every class consulted, as seen when checking
+    std::unordered_map<int, size_t> dependencies;
+  };
+
+  SymbolTable &symbols;
+  std::unique_ptr<ModuleNode> module;
+  std::unique_ptr<ClassTree> class_tree;
+  std::unordered_map<int, ClassRecord> records;
+  std::vector<Symbol> rechecked_;
+
+  size_t body_hash(ClassNode *) const;
+  std::unordered_map<int, size_t> signature_hashes(ModuleNode *) const;
+
+public:
+  IncrementalAnalysis(SymbolTable &);
+
+  /// Analyses a freshly parsed module, taking ownership of it. Returns whether
+  /// types are consistent.
+  bool analyze(std::unique_ptr<ModuleNode>, ThreadPool *pool = nullptr);
+
+  ModuleNode *get_module() const;
+  const ClassTree &get_class_tree() const;
+  /// Classes that were typechecked by the last call to analyze
+  const std::vector<Symbol> &rechecked() const;
+};
+
 #endif
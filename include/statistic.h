@@ -0,0 +1,49 @@
+#ifndef _STATISTIC_H
+#define _STATISTIC_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/***********************
+ *                     *
+ *      Statistic      *
+ *                     *
+ **********************/
+
+/// Process-wide counter of something the compiler did, such as instructions a
+/// pass removed. Each one is a static global that registers itself on
+/// construction, so reports find every counter without a central list.
+///
+/// Counters may be bumped from several threads at once. Passes should add
+/// their total once per method rather than once per change.
+class Statistic {
+private:
+  const char *group_;
+  const char *name_;
+  const char *description_;
+  std::atomic<uint64_t> value;
+
+public:
+  Statistic(const char *group, const char *name, const char *description);
+
+  Statistic(const Statistic &) = delete;
+  Statistic &operator=(const Statistic &) = delete;
+
+  const char *group() const { return group_; }
+  const char *name() const { return name_; }
+  const char *description() const { return description_; }
+
+  uint64_t get() const { return value.load(std::memory_order_relaxed); }
+  void add(uint64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+  void reset() { value.store(0, std::memory_order_relaxed); }
+
+  /// Every registered counter, sorted by group and name
+  static std::vector<const Statistic *> all();
+};
+
+/// Prints the counters that are not zero, one per line
+void print_statistics(std::ostream &);
+
+#endif // !_STATISTIC_H
@@ -1,6 +1,8 @@
 #ifndef _SYMBOL_H
 #define _SYMBOL_H
 
+#include <deque>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -18,10 +20,15 @@ public:
   bool operator==(const Symbol &) const;
 };
 
+/// Interns strings into Symbols. Safe to use from several threads at once:
+/// lookups share a lock and only interning a new string takes it exclusively.
 class SymbolTable {
 private:
-  std::vector<std::string> strings;
+  // A deque never moves its elements, so references returned by get_string
+  // stay valid while other threads intern new strings.
+  std::deque<std::string> strings;
   std::unordered_map<std::string, int> id_map;
+  mutable std::shared_mutex mutex;
 
 public:
   SymbolTable();
@@ -67,6 +74,8 @@ public:
   Symbol string_empty;
   Symbol void_value;
   Symbol type_id_type;
+  Symbol initializer_method;
+  Symbol block_label;
 };
 
 #endif
@@ -0,0 +1,340 @@
+#ifndef _SYMBOL_MAP_H
+#define _SYMBOL_MAP_H
+
+#include "symbol.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/***********************
+ *                     *
+ *      SymbolMap      *
+ *                     *
+ **********************/
+
+/// Map keyed by Symbol, stored as a vector indexed by Symbol::id. Symbol ids
+/// are small and dense, so this trades a bit of memory for lookups that are
+/// a single index. Use it for maps with one instance per program (e.g. one
+/// entry per class); for the many small per-class or per-scope maps prefer
+/// SmallSymbolMap.
+///
+/// Iteration goes through an occupancy bitmap, in increasing Symbol::id order.
+template <typename T> class SymbolMap {
+public:
+  typedef std::pair<Symbol, T> value_type;
+
+private:
+  std::vector<std::optional<value_type>> slots;
+  std::vector<uint64_t> occupied;
+  size_t count;
+
+  bool is_occupied(size_t idx) const {
+    return idx / 64 < occupied.size() && (occupied[idx / 64] >> (idx % 64)) & 1;
+  }
+
+  template <typename Map, typename Value> class base_iterator {
+  private:
+    Map *map;
+    size_t idx;
+
+    void skip_empty() {
+      while (idx < map->slots.size()) {
+        uint64_t word = map->occupied[idx / 64] >> (idx % 64);
+        if (word != 0) {
+          idx += std::countr_zero(word);
+          return;
+        }
+        idx = (idx / 64 + 1) * 64;
+      }
+      idx = map->slots.size();
+    }
+
+  public:
+    base_iterator(Map *m, size_t i) : map(m), idx(i) { skip_empty(); }
+
+    Value &operator*() const { return *map->slots[idx]; }
+    Value *operator->() const { return &*map->slots[idx]; }
+
+    base_iterator &operator++() {
+      idx++;
+      skip_empty();
+      return *this;
+    }
+
+    bool operator==(const base_iterator &other) const {
+      return idx == other.idx;
+    }
+  };
+
+public:
+  typedef base_iterator<SymbolMap, value_type> iterator;
+  typedef base_iterator<const SymbolMap, const value_type> const_iterator;
+
+  SymbolMap() : count(0) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  bool contains(Symbol key) const {
+    return key.id >= 0 && is_occupied(key.id);
+  }
+
+  T *find(Symbol key) {
+    return contains(key) ? &slots[key.id]->second : nullptr;
+  }
+  const T *find(Symbol key) const {
+    return contains(key) ? &slots[key.id]->second : nullptr;
+  }
+
+  T &at(Symbol key) {
+    if (!contains(key))
+      throw std::out_of_range("SymbolMap::at");
+    return slots[key.id]->second;
+  }
+  const T &at(Symbol key) const {
+    if (!contains(key))
+      throw std::out_of_range("SymbolMap::at");
+    return slots[key.id]->second;
+  }
+
+  /// Inserts a value built from args, unless key is already present. Returns
+  /// whether it inserted.
+  template <typename... Args> bool emplace(Symbol key, Args &&...args) {
+    assert(key.id >= 0 && "SymbolMap: negative Symbol id");
+    if (contains(key))
+      return false;
+
+    size_t idx = key.id;
+    if (idx >= slots.size()) {
+      slots.resize(std::max(idx + 1, slots.size() * 2));
+      occupied.resize((slots.size() + 63) / 64, 0);
+    }
+
+    slots[idx].emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+    occupied[idx / 64] |= uint64_t(1) << (idx % 64);
+    count++;
+    return true;
+  }
+
+  T &operator[](Symbol key) {
+    emplace(key);
+    return slots[key.id]->second;
+  }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, slots.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, slots.size()); }
+};
+
+/***********************
+ *                     *
+ *    SmallSymbolMap   *
+ *                     *
+ **********************/
+
+/// Map keyed by Symbol, stored as a vector sorted by Symbol::id. Lookups are a
+/// binary search over contiguous memory, and an empty map allocates nothing.
+/// Meant for maps with a handful of entries that exist in large numbers, such
+/// as the features of a class or the variables of a scope.
+///
+/// Same interface as SymbolMap. Iterates in increasing Symbol::id order.
+template <typename T> class SmallSymbolMap {
+public:
+  typedef std::pair<Symbol, T> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+private:
+  std::vector<value_type> entries;
+
+  static bool key_less(const value_type &entry, Symbol key) {
+    return entry.first.id < key.id;
+  }
+
+  iterator lower_bound(Symbol key) {
+    return std::lower_bound(entries.begin(), entries.end(), key, key_less);
+  }
+  const_iterator lower_bound(Symbol key) const {
+    return std::lower_bound(entries.begin(), entries.end(), key, key_less);
+  }
+
+public:
+  size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+
+  bool contains(Symbol key) const { return find(key) != nullptr; }
+
+  T *find(Symbol key) {
+    auto found = lower_bound(key);
+    if (found == entries.end() || found->first != key)
+      return nullptr;
+    return &found->second;
+  }
+  const T *find(Symbol key) const {
+    auto found = lower_bound(key);
+    if (found == entries.end() || found->first != key)
+      return nullptr;
+    return &found->second;
+  }
+
+  T &at(Symbol key) {
+    T *found = find(key);
+    if (!found)
+      throw std::out_of_range("SmallSymbolMap::at");
+    return *found;
+  }
+  const T &at(Symbol key) const {
+    const T *found = find(key);
+    if (!found)
+      throw std::out_of_range("SmallSymbolMap::at");
+    return *found;
+  }
+
+  /// Inserts a value built from args, unless key is already present. Returns
+  /// whether it inserted.
+  template <typename... Args> bool emplace(Symbol key, Args &&...args) {
+    auto position = lower_bound(key);
+    if (position != entries.end() && position->first == key)
+      return false;
+
+    entries.emplace(position, std::piecewise_construct,
+                    std::forward_as_tuple(key),
+                    std::forward_as_tuple(std::forward<Args>(args)...));
+    return true;
+  }
+
+  T &operator[](Symbol key) {
+    auto position = lower_bound(key);
+    if (position == entries.end() || position->first != key)
+      position = entries.emplace(position, std::piecewise_construct,
+                                 std::forward_as_tuple(key),
+                                 std::forward_as_tuple());
+    return position->second;
+  }
+
+  iterator begin() { return entries.begin(); }
+  iterator end() { return entries.end(); }
+  const_iterator begin() const { return entries.begin(); }
+  const_iterator end() const { return entries.end(); }
+};
+
+/***********************
+ *                     *
+ * PersistentSymbolMap *
+ *                     *
+ **********************/
+
+/// Map keyed by Symbol whose copies share their storage. It is a trie over
+/// Symbol::id with 16 children per node, and assign() copies only the nodes
+/// on the path to the key it changes. A map derived from another (e.g. the
+/// features visible in a subclass, derived from those of its superclass) so
+/// costs O(log id) per entry it adds, and lookups never leave the map.
+///
+/// for_each visits entries in increasing Symbol::id order.
+template <typename T> class PersistentSymbolMap {
+private:
+  static constexpr int BITS = 4;
+  static constexpr size_t WIDTH = size_t(1) << BITS;
+
+  struct Node {
+    std::array<std::shared_ptr<const Node>, WIDTH> children;
+    std::array<std::optional<T>, WIDTH> values;
+  };
+
+  std::shared_ptr<const Node> root;
+  // Levels below the root; ids up to WIDTH^(height + 1) - 1 fit
+  int height;
+  size_t count;
+
+  static size_t slot(size_t idx, int level) {
+    return (idx >> (level * BITS)) & (WIDTH - 1);
+  }
+
+  bool fits(size_t idx) const {
+    return (height + 1) * BITS >= 64 || idx >> ((height + 1) * BITS) == 0;
+  }
+
+  static std::shared_ptr<const Node> assign(const Node *node, int level,
+                                            size_t idx, T value, bool &added) {
+    auto copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+    if (level == 0) {
+      added = !copy->values[slot(idx, 0)].has_value();
+      copy->values[slot(idx, 0)] = std::move(value);
+    } else {
+      std::shared_ptr<const Node> &child = copy->children[slot(idx, level)];
+      child = assign(child.get(), level - 1, idx, std::move(value), added);
+    }
+    return copy;
+  }
+
+  template <typename F>
+  static void for_each(const Node *node, int level, size_t prefix, F &f) {
+    for (size_t i = 0; i < WIDTH; i++) {
+      size_t idx = (prefix << BITS) | i;
+      if (level == 0) {
+        if (node->values[i].has_value())
+          f(Symbol(static_cast<int>(idx)), *node->values[i]);
+      } else if (node->children[i]) {
+        for_each(node->children[i].get(), level - 1, idx, f);
+      }
+    }
+  }
+
+public:
+  PersistentSymbolMap() : height(0), count(0) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  bool contains(Symbol key) const { return find(key) != nullptr; }
+
+  const T *find(Symbol key) const {
+    if (key.id < 0 || !fits(key.id))
+      return nullptr;
+
+    const Node *node = root.get();
+    for (int level = height; node && level > 0; level--)
+      node = node->children[slot(key.id, level)].get();
+
+    if (!node || !node->values[slot(key.id, 0)].has_value())
+      return nullptr;
+    return &*node->values[slot(key.id, 0)];
+  }
+
+  /// Inserts or overwrites the value of key. Other maps sharing storage with
+  /// this one are unaffected.
+  void assign(Symbol key, T value) {
+    assert(key.id >= 0 && "PersistentSymbolMap: negative Symbol id");
+    size_t idx = key.id;
+
+    while (!fits(idx)) {
+      if (root) {
+        auto grown = std::make_shared<Node>();
+        grown->children[0] = std::move(root);
+        root = std::move(grown);
+      }
+      height++;
+    }
+
+    bool added = false;
+    root = assign(root.get(), height, idx, std::move(value), added);
+    if (added)
+      count++;
+  }
+
+  template <typename F> void for_each(F &&f) const {
+    if (root)
+      for_each(root.get(), height, 0, f);
+  }
+};
+
+#endif // !_SYMBOL_MAP_H
@@ -0,0 +1,48 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************
+ *                     *
+ *      ThreadPool     *
+ *                     *
+ **********************/
+
+/// Fixed set of worker threads used by the phases of the compiler that can
+/// work on independent classes or methods at the same time.
+class ThreadPool {
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex tasks_mutex;
+  std::condition_variable tasks_available;
+  bool stopping;
+
+  void work();
+
+public:
+  /// Starts `threads - 1` workers. The thread calling parallel_for always
+  /// takes part in the work, so a pool of size 1 runs everything inline.
+  ThreadPool(unsigned int threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned int size() const;
+
+  /// Calls body(i) for every i in [0, count) and returns once all calls
+  /// finished. body must not throw.
+  void parallel_for(size_t count, const std::function<void(size_t)> &body);
+
+  static unsigned int hardware_threads();
+};
+
+#endif // !_THREAD_POOL_H
@@ -0,0 +1,115 @@
+#ifndef _TIME_REPORT_H
+#define _TIME_REPORT_H
+
+#include "symbol.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/***********************
+ *                     *
+ *     Allocations     *
+ *                     *
+ **********************/
+
+/// Heap allocations made through operator new, over all threads
+struct Allocations {
+  uint64_t count;
+  uint64_t bytes;
+};
+
+/// Allocations made since the program started. Every operator new is counted,
+/// so differences between two calls tell what the code in between allocated.
+Allocations allocations_so_far();
+
+/***********************
+ *                     *
+ *     TimeReport      *
+ *                     *
+ **********************/
+
+/// Wall time, heap allocations and statistics (statistic.h) of each phase of
+/// a compilation, for --time-report. Phases are timed between start() and
+/// stop(), which names them, and cannot nest. Allocations and statistics are
+/// counted on every thread, so phases must not overlap with other work.
+class TimeReport {
+public:
+  struct Entry {
+    /// "phase" for the driver, "pass" for optimizer passes
+    std::string kind;
+    std::string name;
+    double seconds;
+    Allocations allocations;
+    /// Statistics that changed, by "group.name", and by how much
+    std::vector<std::pair<std::string, uint64_t>> counters;
+  };
+
+private:
+  std::vector<Entry> entries_;
+
+  // State of the running phase
+  std::chrono::steady_clock::time_point start_time;
+  Allocations start_allocations;
+  std::vector<uint64_t> start_counters;
+  bool running;
+
+public:
+  TimeReport();
+
+  void start();
+  void stop(std::string kind, std::string name);
+
+  const std::vector<Entry> &entries() const;
+
+  /// One line per phase, with the statistics it changed under it
+  void print_table(std::ostream &) const;
+  void print_json(std::ostream &) const;
+};
+
+/***********************
+ *                     *
+ *        Trace        *
+ *                     *
+ **********************/
+
+/// Starts recording trace spans for --trace, counting time from now. Must be
+/// called before any other thread records a span.
+void enable_tracing();
+bool tracing_enabled();
+
+/// Times the scope it lives in as a span of the trace, shown in Chrome's
+/// about:tracing or Perfetto. Spans go to a buffer of the thread running them,
+/// so threads never wait on each other, and cost one branch while tracing is
+/// off.
+class TraceSpan {
+private:
+  const char *category;
+  std::string name;
+  std::chrono::steady_clock::time_point start;
+  bool recording;
+
+public:
+  TraceSpan(const char *category, std::string_view name);
+  /// Named "scope.name", which is only put together while tracing
+  TraceSpan(const char *category, std::string_view scope,
+            std::string_view name);
+  /// Named after symbols, which are only looked up while tracing, since the
+  /// lookup takes the lock of the table
+  TraceSpan(const char *category, const SymbolTable &, Symbol name);
+  TraceSpan(const char *category, const SymbolTable &, Symbol scope,
+            Symbol name);
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+/// Writes every span recorded so far as Chrome trace-event JSON. No other
+/// thread may be recording spans while it runs.
+void write_trace(std::ostream &);
+
+#endif // !_TIME_REPORT_H
@@ -0,0 +1,83 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+
+/***********************
+ *                     *
+ *        Arena        *
+ *                     *
+ **********************/
+
+Arena::Arena() : cursor(nullptr), remaining(0), allocated(0) {}
+
+Arena::~Arena() { destroy_all(); }
+
+Arena::Arena(Arena &&other) noexcept
+    : chunks(std::move(other.chunks)),
+      destructors(std::move(other.destructors)), cursor(other.cursor),
+      remaining(other.remaining), allocated(other.allocated) {
+  other.chunks.clear();
+  other.destructors.clear();
+  other.cursor = nullptr;
+  other.remaining = 0;
+  other.allocated = 0;
+}
+
+Arena &Arena::operator=(Arena &&other) noexcept {
+  if (this == &other)
+    return *this;
+
+  destroy_all();
+
+  chunks = std::move(other.chunks);
+  destructors = std::move(other.destructors);
+  cursor = other.cursor;
+  remaining = other.remaining;
+  allocated = other.allocated;
+
+  other.chunks.clear();
+  other.destructors.clear();
+  other.cursor = nullptr;
+  other.remaining = 0;
+  other.allocated = 0;
+
+  return *this;
+}
+
+void Arena::destroy_all() {
+  for (auto it = destructors.rbegin(); it != destructors.rend(); it++)
+    it->destroy(it->object);
+
+  destructors.clear();
+  chunks.clear();
+  cursor = nullptr;
+  remaining = 0;
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  size_t padding =
+      (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+
+  if (cursor == nullptr || padding + size > remaining) {
+    // Chunks grow up to 16x with the arena, so long methods need few of them.
+    // Oversized requests always fit.
+    size_t chunk_size = CHUNK_SIZE << std::min<size_t>(chunks.size(), 4);
+    chunk_size = std::max(chunk_size, size + alignment);
+
+    chunks.push_back(std::unique_ptr<std::byte[]>(new std::byte[chunk_size]));
+    cursor = chunks.back().get();
+    remaining = chunk_size;
+
+    padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) %
+              alignment;
+  }
+
+  void *memory = cursor + padding;
+  cursor += padding + size;
+  remaining -= padding + size;
+  allocated += size;
+
+  return memory;
+}
+
+size_t Arena::bytes_allocated() const { return allocated; }
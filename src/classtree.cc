@@ -9,8 +9,7 @@ ClassTree::ClassTree(ModuleNode *module, SymbolTable &symbs) : symbols(symbs) {
 
   add_default_classes();
 
-  std::unordered_map<int, ClassNode *> class_node_map =
-      get_class_node_map(module);
+  SymbolMap<ClassNode *> class_node_map = get_class_node_map(module);
 
   check_class_hierarchy(class_node_map, module);
 
@@ -18,10 +17,10 @@ ClassTree::ClassTree(ModuleNode *module, SymbolTable &symbs) : symbols(symbs) {
 
   for (const auto &cls_name : classes_by_depth) {
 
-    if (class_node_map.find(cls_name.id) == class_node_map.end())
+    if (!class_node_map.contains(cls_name))
       continue;
 
-    ClassNode *class_node = class_node_map[cls_name.id];
+    ClassNode *class_node = class_node_map[cls_name];
 
     Token class_token = class_node->start_token;
     std::optional<ClassInfo> stored_class = get(cls_name);
@@ -67,21 +66,20 @@ ClassTree::ClassTree(ModuleNode *module, SymbolTable &symbs) : symbols(symbs) {
   }
 }
 
-std::unordered_map<int, ClassNode *>
-ClassTree::get_class_node_map(ModuleNode *module) const {
-  std::unordered_map<int, ClassNode *> class_node_map;
+SymbolMap<ClassNode *> ClassTree::get_class_node_map(ModuleNode *module) const {
+  SymbolMap<ClassNode *> class_node_map;
 
   for (const auto &class_node : module->classes) {
-    class_node_map[class_node->name.id] = class_node.get();
+    class_node_map[class_node->name] = class_node.get();
   }
 
   return class_node_map;
 }
 
 std::vector<Symbol> ClassTree::get_classes_by_depth(ModuleNode *module) const {
-  std::unordered_map<int, std::vector<Symbol>> dependants;
+  SymbolMap<std::vector<Symbol>> dependants;
   for (const auto &class_node : module->classes) {
-    dependants[class_node->superclass.id].push_back(class_node->name);
+    dependants[class_node->superclass].push_back(class_node->name);
   }
 
   std::vector<Symbol> classes_by_depth;
@@ -94,7 +92,7 @@ std::vector<Symbol> ClassTree::get_classes_by_depth(ModuleNode *module) const {
   // Now add all dependants in order: superclass precedes subclass
   for (int i = 0; i < classes_by_depth.size(); i++) {
     Symbol class_name = classes_by_depth[i];
-    for (const auto &subclass : dependants[class_name.id]) {
+    for (const auto &subclass : dependants[class_name]) {
       classes_by_depth.push_back(subclass);
     }
   }
@@ -103,12 +101,12 @@ std::vector<Symbol> ClassTree::get_classes_by_depth(ModuleNode *module) const {
 }
 
 void ClassTree::check_class_hierarchy(
-    const std::unordered_map<int, ClassNode *> &class_node_map,
+    const SymbolMap<ClassNode *> &class_node_map,
     ModuleNode *module) {
   for (const auto &class_node : module->classes) {
     Symbol superclass_name = class_node->superclass;
     if (!exists(superclass_name) &&
-        class_node_map.find(superclass_name.id) == class_node_map.end()) {
+        !class_node_map.contains(superclass_name)) {
       fatal(std::format("Undefined superclass {} for class {}",
                         symbols.get_string(class_node->superclass),
                         symbols.get_string(class_node->name)),
@@ -218,20 +216,47 @@ void ClassTree::add_default_classes() {
 void ClassTree::add_class(ClassNode *class_node, int depth) {
   int next_position = classes.size();
 
+  // Superclasses are always added before their subclasses
+  std::vector<std::pair<Symbol, Symbol>> own_attributes;
+  for (const auto &attribute : class_node->attributes)
+    own_attributes.emplace_back(attribute->object_id, attribute->declared_type);
+
+  ObjectLayout layout = ObjectLayout::extend(
+      get_layout(class_node->superclass), own_attributes, symbols);
+
+  layouts.push_back(std::move(layout));
+
+  // Start from the superclass's tables, which share their storage with ours
+  PersistentSymbolMap<MethodNode *> methods;
+  PersistentSymbolMap<AttributeNode *> attributes;
+  if (const ClassIdx *super_idx = find(class_node->superclass)) {
+    methods = visible_methods[*super_idx];
+    attributes = visible_attributes[*super_idx];
+  }
+
+  for (const auto &method : class_node->methods)
+    methods.assign(method->name, method.get());
+  for (const auto &attribute : class_node->attributes)
+    attributes.assign(attribute->object_id, attribute.get());
+
+  visible_methods.push_back(std::move(methods));
+  visible_attributes.push_back(std::move(attributes));
+
   classes.push_back(ClassInfo(class_node, depth));
-  classes_by_name[class_node->name.id] = ClassIdx(next_position);
+  classes_by_name[class_node->name] = ClassIdx(next_position);
 }
 
 bool ClassTree::exists(Symbol name) const {
-  if (classes_by_name.find(name.id) == classes_by_name.end())
+  const ClassIdx *idx = classes_by_name.find(name);
+  if (!idx)
     return false;
-  return exists(classes_by_name.at(name.id));
+  return exists(*idx);
 }
 bool ClassTree::exists(ClassIdx idx) const { return idx < classes.size(); }
 
 std::optional<ClassInfo> ClassTree::get(Symbol name) const {
   if (exists(name)) {
-    ClassIdx idx = classes_by_name.at(name.id);
+    ClassIdx idx = classes_by_name.at(name);
     return get(idx);
   }
   return std::nullopt;
@@ -279,7 +304,7 @@ ClassTree::common_ancestor(const ClassInfo &class_a,
       superclass = b_side->superclass();
 
     if (exists(superclass))
-      idx = classes_by_name.at(superclass.id);
+      idx = classes_by_name.at(superclass);
     else
       return std::nullopt;
 
@@ -340,41 +365,51 @@ bool ClassTree::is_subclass(const ClassInfo &class_a,
   }
 }
 
-MethodNode *ClassTree::get_method(Symbol class_name, Symbol method_name) const {
-  while (class_name != symbols.tree_root_type) {
-    std::optional<ClassInfo> cls = get(class_name);
-
-    if (!cls.has_value())
-      return nullptr;
-
-    MethodNode *cls_method = cls.value().method(method_name);
-
-    if (cls_method)
-      return cls_method;
+const ClassIdx *ClassTree::find(Symbol name) const {
+  const ClassIdx *idx = classes_by_name.find(name);
+  if (!idx || !exists(*idx))
+    return nullptr;
+  return idx;
+}
 
-    class_name = cls.value().superclass();
-  }
+MethodNode *ClassTree::get_method(Symbol class_name, Symbol method_name) const {
+  const ClassIdx *idx = find(class_name);
+  if (!idx)
+    return nullptr;
 
-  return nullptr;
+  MethodNode *const *method = visible_methods[*idx].find(method_name);
+  return method ? *method : nullptr;
 }
 
 AttributeNode *ClassTree::get_attribute(Symbol class_name,
                                         Symbol attribute_name) const {
-  while (class_name != symbols.tree_root_type) {
-    std::optional<ClassInfo> cls = get(class_name);
+  const ClassIdx *idx = find(class_name);
+  if (!idx)
+    return nullptr;
 
-    if (!cls.has_value())
-      return nullptr;
+  AttributeNode *const *attribute =
+      visible_attributes[*idx].find(attribute_name);
+  return attribute ? *attribute : nullptr;
+}
 
-    AttributeNode *cls_attribute = cls.value().attribute(attribute_name);
+const PersistentSymbolMap<AttributeNode *> NO_ATTRIBUTES;
 
-    if (cls_attribute)
-      return cls_attribute;
+const PersistentSymbolMap<AttributeNode *> &
+ClassTree::get_attributes(Symbol class_name) const {
+  const ClassIdx *idx = find(class_name);
+  if (!idx)
+    return NO_ATTRIBUTES;
 
-    class_name = cls.value().superclass();
-  }
+  return visible_attributes[*idx];
+}
+
+const ObjectLayout NO_LAYOUT;
+
+const ObjectLayout &ClassTree::get_layout(Symbol class_name) const {
+  if (!exists(class_name))
+    return NO_LAYOUT;
 
-  return nullptr;
+  return layouts[classes_by_name.at(class_name)];
 }
 
 void ClassTree::print(std::ostream *out) {
@@ -397,6 +432,16 @@ void ClassTree::print(std::ostream *out) {
 
         for (const auto &meth : cls.methods())
           printer.println(std::format("method {} ", symbols.get_string(meth)));
+
+        const ObjectLayout &layout = get_layout(cls.name());
+        printer.println(std::format("layout; size {}", layout.size()));
+
+        printer.enter();
+        for (const auto &field : layout.fields())
+          printer.println(std::format("{} {} {}", field.offset,
+                                      to_string(field.kind),
+                                      symbols.get_string(field.name)));
+        printer.exit();
       }
       printer.exit();
     }
@@ -26,3 +26,52 @@ Symbol string_eval(Symbol literal, SymbolTable &symbols) {
                       symbols.get_string(literal)));
   return Symbol{}; // fool linter
 }
+
+hlir::Value fold_constants(hlir::Op op, std::span<const hlir::Value> args,
+                           Symbol type) {
+  using hlir::Op;
+  using hlir::Value;
+
+  // Computed unsigned, where overflow wraps around instead of being undefined
+  auto wrap = [&](uint32_t result) {
+    return Value::constant(int32_t(result), type);
+  };
+  auto a = [&]() { return uint32_t(args[0].num()); };
+  auto b = [&]() { return uint32_t(args[1].num()); };
+
+  switch (op) {
+  case Op::ADD:
+    return wrap(a() + b());
+  case Op::SUB:
+    return wrap(a() - b());
+  case Op::MULT:
+    return wrap(a() * b());
+  case Op::NEG:
+    return wrap(0 - a());
+
+  case Op::DIV:
+    if (args[1].num() == 0)
+      return Value::empty();
+    // The only quotient that overflows, INT_MIN / -1
+    if (args[1].num() == -1)
+      return wrap(0 - a());
+    return Value::constant(args[0].num() / args[1].num(), type);
+
+  case Op::LESS_THAN:
+    return Value::constant(args[0].num() < args[1].num(), type);
+  case Op::LESS_EQUAL:
+    return Value::constant(args[0].num() <= args[1].num(), type);
+  case Op::NOT:
+    return Value::constant(!args[0].boolean(), type);
+
+  // Constants of the same type are equal when they hold the same payload,
+  // since strings are interned
+  case Op::EQUAL:
+    if (args[0].static_type() != args[1].static_type())
+      return Value::empty();
+    return Value::constant(args[0] == args[1], type);
+
+  default:
+    return Value::empty();
+  }
+}
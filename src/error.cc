@@ -1,7 +1,10 @@
 #include "error.h"
 #include "token.h"
+#include <format>
 #include <iostream>
 
+thread_local Diagnostics *captured_diagnostics = nullptr;
+
 enum LogLevel {
   WARNING,
   ERROR,
@@ -22,12 +25,17 @@ void _message(std::string message, LogLevel level, Token token) {
     break;
   }
 
+  std::string line;
   if (token == Token{})
-    std::cerr << level_name << ": " << message << std::endl;
+    line = std::format("{}: {}", level_name, message);
+  else
+    line = std::format("{}:{} {} at {}: {}", token.line(), token.column(),
+                       level_name, to_string(token.type()), message);
+
+  if (captured_diagnostics)
+    captured_diagnostics->messages.push_back(line);
   else
-    std::cerr << token.line() << ":" << token.column() << " " << level_name
-              << " at " << to_string(token.type()) << ": " << message
-              << std::endl;
+    std::cerr << line << std::endl;
 }
 
 void warning(std::string message, Token token) {
@@ -40,6 +48,13 @@ void error(std::string message, Token token) {
 
 void fatal(std::string message, Token token, int errorcode) {
   _message(message, FATAL, token);
+
+  if (captured_diagnostics) {
+    captured_diagnostics->has_fatal = true;
+    captured_diagnostics->fatal_errorcode = errorcode;
+    throw FatalDiagnostic{};
+  }
+
   exit(errorcode);
 }
 
@@ -50,3 +65,26 @@ void fatal(std::string message, int errorcode) {
 }
 
 void fatal(std::string message) { fatal(message, 1); }
+
+/***********************
+ *                     *
+ *     Diagnostics     *
+ *                     *
+ **********************/
+
+Diagnostics::Diagnostics() : has_fatal(false), fatal_errorcode(0) {}
+
+void Diagnostics::emit() const {
+  for (const auto &message : messages)
+    std::cerr << message << std::endl;
+
+  if (has_fatal)
+    exit(fatal_errorcode);
+}
+
+DiagnosticCapture::DiagnosticCapture(Diagnostics &diagnostics)
+    : previous(captured_diagnostics) {
+  captured_diagnostics = &diagnostics;
+}
+
+DiagnosticCapture::~DiagnosticCapture() { captured_diagnostics = previous; }
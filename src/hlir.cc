@@ -37,35 +37,36 @@ std::string to_string(ValueKind kind) {
 }
 
 std::string to_string(Value value, const SymbolTable &symbols) {
-  ValueKind kind = value.kind;
+  ValueKind kind = value.kind();
 
   switch (kind) {
   case ValueKind::SELF:
     return "[self]";
 
   case ValueKind::LOCAL:
-    return std::format("[local: {}]", symbols.get_string(value.symbol));
+    return std::format("[local: {}]", symbols.get_string(value.symbol()));
 
   case ValueKind::ATTRIBUTE:
-    return std::format("[attr: {}]", symbols.get_string(value.symbol));
+    return std::format("[attr: {} @{}]", symbols.get_string(value.symbol()),
+                       value.offset());
 
   case ValueKind::TEMP:
-    return std::format("[temp: {}]", value.num);
+    return std::format("[temp: {}]", value.num());
 
   case ValueKind::ACC:
     return "[acc]";
 
   case ValueKind::CONSTANT:
-    if (value.static_type == symbols.bool_type)
-      return std::format("{}", value.boolean);
+    if (value.static_type() == symbols.bool_type)
+      return std::format("{}", value.boolean());
 
-    if (value.static_type == symbols.int_type)
-      return std::format("{}", value.num);
+    if (value.static_type() == symbols.int_type)
+      return std::format("{}", value.num());
 
-    if (value.static_type == symbols.string_type)
-      return std::format("\"{}\"", value.num);
+    if (value.static_type() == symbols.string_type)
+      return std::format("\"{}\"", value.num());
 
-    return std::format("{}", symbols.get_string(value.symbol));
+    return std::format("{}", symbols.get_string(value.symbol()));
 
   case ValueKind::EMPTY:
     return "[empty]";
@@ -78,57 +79,76 @@ std::string to_string(Value value, const SymbolTable &symbols) {
 // Private constructors
 //
 
-Value::Value(ValueKind k, int i, Symbol st)
-    : kind(k), num(i), static_type(st) {}
+Value::Value(ValueKind k, Symbol st, uint64_t payload) {
+  // Symbol ids are dense, so running out of bits takes a program with millions
+  // of distinct names
+  if (st.id + 1 < 0 || uint64_t(st.id + 1) > TYPE_MASK)
+    fatal(std::format("Too many symbols: type id {} does not fit in an HLIR "
+                      "value",
+                      st.id));
 
-Value::Value(ValueKind k, Symbol n, Symbol st)
-    : kind(k), symbol(n), static_type(st) {}
-
-Value::Value(ValueKind k, Symbol st) : kind(k), static_type(st) {}
+  bits = (uint64_t(k) << (PAYLOAD_BITS + TYPE_BITS)) |
+         (uint64_t(st.id + 1) << PAYLOAD_BITS) | (payload & PAYLOAD_MASK);
+}
 
 //
 // Public constructors
 //
 
 Value Value::self(Symbol static_type) {
-  return Value(ValueKind::SELF, static_type);
+  return Value(ValueKind::SELF, static_type, 0);
 }
 
-Value Value::attr(Symbol name, Symbol static_type) {
-  return Value(ValueKind::ATTRIBUTE, name, static_type);
+Value Value::attr(Symbol name, int offset, Symbol static_type) {
+  if (name.id < 0 || uint64_t(name.id) > ATTRIBUTE_NAME_MASK)
+    fatal(std::format("Too many symbols: attribute name id {} does not fit in "
+                      "an HLIR value",
+                      name.id));
+
+  if (offset < 0 || offset >= (1 << (PAYLOAD_BITS - ATTRIBUTE_NAME_BITS)))
+    fatal(std::format("Object too large: attribute offset {} does not fit in "
+                      "an HLIR value",
+                      offset));
+
+  return Value(ValueKind::ATTRIBUTE, static_type,
+               uint64_t(name.id) | (uint64_t(offset) << ATTRIBUTE_NAME_BITS));
 }
 
 Value Value::local(Symbol name, Symbol static_type) {
-  return Value(ValueKind::LOCAL, name, static_type);
+  return Value(ValueKind::LOCAL, static_type, uint32_t(name.id));
 }
 
 Value Value::temp(int id, Symbol static_type) {
-  return Value(ValueKind::TEMP, id, static_type);
+  return Value(ValueKind::TEMP, static_type, uint32_t(id));
 }
 
 Value Value::acc(Symbol static_type) {
-  return Value(ValueKind::ACC, static_type);
+  return Value(ValueKind::ACC, static_type, 0);
 }
 
 Value Value::constant(int value, Symbol static_type) {
-  return Value(ValueKind::CONSTANT, value, static_type);
+  return Value(ValueKind::CONSTANT, static_type, uint32_t(value));
 }
 
 Value Value::constant(bool value, Symbol static_type) {
-  return Value(ValueKind::CONSTANT, value, static_type);
+  return Value(ValueKind::CONSTANT, static_type, value ? 1 : 0);
 }
 
 Value Value::constant(Symbol value, Symbol static_type) {
-  return Value(ValueKind::CONSTANT, value, static_type);
+  return Value(ValueKind::CONSTANT, static_type, uint32_t(value.id));
 }
 
-Value Value::empty() { return Value(ValueKind::EMPTY, Symbol{}); }
+Value Value::empty() { return Value(ValueKind::EMPTY, Symbol{}, 0); }
+
+Value Value::with_type(Symbol static_type) const {
+  return Value(kind(), static_type, payload());
+}
 
 //
 // Accessors
 //
 
-bool Value::is_empty() const { return kind == ValueKind::EMPTY; }
+bool Value::is_empty() const { return kind() == ValueKind::EMPTY; }
 
 /***********************
  *                     *
@@ -174,6 +194,8 @@ std::string to_string(Op op) {
     return "typeof";
   case Op::SUPERCLASS:
     return "superclass";
+  case Op::PHI:
+    return "phi";
   }
 }
 
@@ -216,15 +238,26 @@ std::string to_string(Position position) {
 // Base Instruction
 //
 
-Instruction::Instruction(Op o, Token t) : op(o), token(t) {}
-
-void Instruction::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println("__undefined_instruction_print__");
-  printer.exit();
+Instruction::Instruction(Op o, Token t, Value dest,
+                         std::initializer_list<Value> args)
+    : prev(nullptr), next(nullptr), op(o),
+      condition(BranchCondition::ALWAYS), error(runtime::Error::CASE_VOID),
+      has_dest_(op_has_dest(o)), arg_count(args.size()), label(0),
+      tail(nullptr), operands{Value::empty(), Value::empty(), Value::empty()},
+      token(t) {
+  int operand = 0;
+  if (has_dest_)
+    operands[operand++] = dest;
+
+  for (const Value &arg : args)
+    operands[operand++] = arg;
 }
 
-bool Instruction::has_dest() {
+Instruction *Instruction::get_prev() const { return prev; }
+
+Instruction *Instruction::get_next() const { return next; }
+
+bool Instruction::op_has_dest(Op op) {
   switch (op) {
   case Op::ADD:
   case Op::SUB:
@@ -241,6 +274,7 @@ bool Instruction::has_dest() {
   case Op::MOV:
   case Op::TYPE_ID_OF:
   case Op::SUPERCLASS:
+  case Op::PHI:
     return true;
 
   case Op::BRANCH:
@@ -248,237 +282,378 @@ bool Instruction::has_dest() {
   case Op::ERROR:
     return false;
   }
+  return false;
 }
 
-Value &Instruction::get_dest() {
-  fatal("INTERNAL: trying to get_dest in unsupported instruction");
+Value &Instruction::missing(const char *accessor) {
+  fatal(std::format("INTERNAL: trying to {} in unsupported instruction",
+                    accessor));
 
   // the following is just to fool the linter
   return DUMMY_EMPTY_VALUE;
 }
 
-int Instruction::num_args() {
+void Instruction::print(Printer printer, const SymbolTable &symbols) const {
+  if (op == Op::LABEL) {
+    printer.println(
+        std::format("{}: // {}", label, symbols.get_string(symbol)));
+    return;
+  }
+
+  printer.enter();
+
+  // We will form this line out of several parts
+  printer.beginln();
+
   switch (op) {
-  case Op::ADD:
-  case Op::SUB:
-  case Op::MULT:
-  case Op::DIV:
-  case Op::EQUAL:
-  case Op::LESS_EQUAL:
-  case Op::LESS_THAN:
-    return 2;
+  case Op::BRANCH:
+    printer.print(std::format(
+        "{}.{} {} {}", hlir::to_string(op), hlir::to_string(condition),
+        hlir::to_string(args()[0], symbols), hlir::to_string(Position(label))));
+    break;
 
-  case Op::NEG:
-  case Op::NOT:
-  case Op::IS_VOID:
-  case Op::NEW:
-  case Op::MOV:
-  case Op::TYPE_ID_OF:
-  case Op::SUPERCLASS:
   case Op::ERROR:
-  case Op::BRANCH:
-    return 1;
+    printer.print(std::format(
+        "{}.{} {} {}", hlir::to_string(op), hlir::to_string(condition),
+        hlir::to_string(args()[0], symbols), runtime::to_string(error)));
+    break;
+
+  case Op::NEW:
+    printer.print(std::format("{} {}, {}", hlir::to_string(op),
+                              hlir::to_string(get_dest(), symbols),
+                              symbols.get_string(symbol)));
+    break;
 
   case Op::CALL:
-    // TODO(IT) consider how to deal with CALL arguments
-    return 1;
+    printer.print(std::format("{} {}, {}, {}, (", hlir::to_string(op),
+                              hlir::to_string(get_dest(), symbols),
+                              hlir::to_string(args()[0], symbols),
+                              symbols.get_string(symbol)));
 
-  case Op::LABEL:
-    return 0;
-  }
-}
+    for (int i = 1; i < arg_count; i++) {
+      if (i > 1)
+        printer.print(" ");
 
-Value &Instruction::get_arg1() {
-  fatal("INTERNAL: trying to get_arg1 in unsupported instruction");
+      printer.print(hlir::to_string(args()[i], symbols));
+    }
 
-  // the following is just to fool the linter
-  return DUMMY_EMPTY_VALUE;
-}
+    printer.print(")");
+    break;
 
-Value &Instruction::get_arg2() {
-  fatal("INTERNAL: trying to get_arg2 in unsupported instruction");
+  default:
+    printer.print(std::format("{} {}", hlir::to_string(op),
+                              hlir::to_string(get_dest(), symbols)));
 
-  // the following is just to fool the linter
-  return DUMMY_EMPTY_VALUE;
+    for (const Value &arg : args())
+      printer.print(std::format(", {}", hlir::to_string(arg, symbols)));
+  }
+
+  printer.endln();
+  printer.exit();
 }
 
 //
 // Unary
 //
 
-Unary::Unary(Op o, Value d, Value c, Token t)
-    : dest(d), arg(c), Instruction(o, t) {}
-
-void Unary::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println(std::format("{} {}, {}", hlir::to_string(op),
-                              hlir::to_string(dest, symbols),
-                              hlir::to_string(arg, symbols)));
-  printer.exit();
-}
-
-Value &Unary::get_dest() { return dest; }
-
-Value &Unary::get_arg1() { return arg; }
+Unary::Unary(Op o, Value d, Value a, Token t) : Instruction(o, t, d, {a}) {}
 
 //
 // New
 //
 
-New::New(Op o, Value d, Symbol ty, Token to)
-    : dest(d), type(ty), Instruction(o, to) {}
-
-void New::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println(std::format("{} {}, {}", hlir::to_string(op),
-                              hlir::to_string(dest, symbols),
-                              symbols.get_string((type))));
-  printer.exit();
+New::New(Op o, Value d, Symbol ty, Token t) : Instruction(o, t, d, {}) {
+  symbol = ty;
 }
 
-Value &New::get_dest() { return dest; }
+Symbol New::get_type() const { return symbol; }
 
 //
 // Binary
 //
 
 Binary::Binary(Op o, Value d, Value l, Value r, Token t)
-    : dest(d), left(l), right(r), Instruction(o, t) {}
+    : Instruction(o, t, d, {l, r}) {}
 
-void Binary::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println(std::format(
-      "{} {}, {}, {}", hlir::to_string(op), hlir::to_string(dest, symbols),
-      hlir::to_string(left, symbols), hlir::to_string(right, symbols)));
-  printer.exit();
-}
+//
+// Call
+//
+
+Call::Call(Value d, Value target, Symbol method_name,
+           const std::vector<Value> &call_args, Arena &arena, Token t)
+    : Instruction(Op::CALL, t, d, {}) {
+  symbol = method_name;
+  arg_count = call_args.size() + 1;
 
-Value &Binary::get_dest() { return dest; }
+  tail = static_cast<Value *>(
+      arena.allocate(sizeof(Value) * arg_count, alignof(Value)));
 
-Value &Binary::get_arg1() { return left; }
+  new (&tail[0]) Value(target);
+  for (size_t i = 0; i < call_args.size(); i++)
+    new (&tail[i + 1]) Value(call_args[i]);
+}
 
-Value &Binary::get_arg2() { return right; }
+Symbol Call::get_method_name() const { return symbol; }
+
+std::span<Value> Call::call_args() { return args().subspan(1); }
 
 //
-// Call
+// Phi
 //
 
-Call::Call(Value d, Value ta, Symbol n, Token to)
-    : dest(d), target(ta), method_name(n), Instruction(Op::CALL, to) {}
+Phi::Phi(Value d, const std::vector<Value> &incoming, Arena &arena, Token t)
+    : Instruction(Op::PHI, t, d, {}) {
+  arg_count = incoming.size();
 
-void Call::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
+  tail = static_cast<Value *>(
+      arena.allocate(sizeof(Value) * arg_count, alignof(Value)));
 
-  // We will form this line out of several parts
-  printer.beginln();
-  printer.print(std::format(
-      "{} {}, {}, {}, (", hlir::to_string(op), hlir::to_string(dest, symbols),
-      hlir::to_string(target, symbols), symbols.get_string(method_name)));
+  for (size_t i = 0; i < incoming.size(); i++)
+    new (&tail[i]) Value(incoming[i]);
+}
 
-  for (int i = 0; i < args.size(); i++) {
-    const auto &arg = args[i];
+//
+// Branch
+//
 
-    if (i > 0)
-      printer.print(" ");
+Branch::Branch(BranchCondition bc, Value v, Position target, Token t)
+    : Instruction(Op::BRANCH, t, Value::empty(), {v}) {
+  condition = bc;
+  label = target.label_idx;
+}
 
-    printer.print(hlir::to_string(arg, symbols));
-  }
+Position Branch::get_target() const { return Position(label); }
 
-  printer.print(")");
-  printer.endln();
+//
+// Label
+//
 
-  printer.exit();
+Label::Label(int idx, Symbol name, Token t)
+    : Instruction(Op::LABEL, t, Value::empty(), {}) {
+  label = idx;
+  symbol = name;
 }
 
-void Call::add_arg(const Value &arg) { args.push_back(arg); }
+int Label::get_idx() const { return label; }
 
-Value &Call::get_dest() { return dest; }
-
-Value &Call::get_arg1() { return target; }
+Symbol Label::get_name() const { return symbol; }
 
 //
-// Branch
+// Mov
 //
 
-Branch::Branch(BranchCondition bc, Value v, Position l, Token t)
-    : value(v), condition(bc), target(l), Instruction(Op::BRANCH, t) {}
+Mov::Mov(Value d, Value s, Token t) : Instruction(Op::MOV, t, d, {s}) {}
 
-void Branch::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println(std::format(
-      "{}.{} {} {}", hlir::to_string(op), hlir::to_string(condition),
-      hlir::to_string(value, symbols), hlir::to_string(target)));
-  printer.exit();
+//
+// Error
+//
+
+Error::Error(BranchCondition ec, Value v, runtime::Error re, Token t)
+    : Instruction(Op::ERROR, t, Value::empty(), {v}) {
+  condition = ec;
+  error = re;
 }
 
-Value &Branch::get_arg1() { return value; }
+// Views must not add data: they are only ever created in place of an
+// Instruction of the same size
+static_assert(sizeof(Unary) == sizeof(Instruction));
+static_assert(sizeof(New) == sizeof(Instruction));
+static_assert(sizeof(Binary) == sizeof(Instruction));
+static_assert(sizeof(Call) == sizeof(Instruction));
+static_assert(sizeof(Phi) == sizeof(Instruction));
+static_assert(sizeof(Branch) == sizeof(Instruction));
+static_assert(sizeof(Label) == sizeof(Instruction));
+static_assert(sizeof(Mov) == sizeof(Instruction));
+static_assert(sizeof(Error) == sizeof(Instruction));
+static_assert(std::is_trivially_destructible_v<Instruction>);
+
+/***********************
+ *                     *
+ *   InstructionList   *
+ *                     *
+ **********************/
+
 //
-// Label
+// Iterator
 //
 
-Label::Label(int i, Symbol n, Token t)
-    : idx(i), name(n), Instruction(Op::LABEL, t) {}
+InstructionList::iterator::iterator(Instruction *n, const InstructionList *l)
+    : node(n), list(l) {}
 
-void Label::print(Printer printer, const SymbolTable &symbols) const {
-  printer.println(std::format("{}: // {}", idx, symbols.get_string(name)));
+Instruction *InstructionList::iterator::operator*() const { return node; }
+
+Instruction *InstructionList::iterator::operator->() const { return node; }
+
+InstructionList::iterator &InstructionList::iterator::operator++() {
+  node = node->next;
+  return *this;
+}
+
+InstructionList::iterator InstructionList::iterator::operator++(int) {
+  iterator previous = *this;
+  ++*this;
+  return previous;
+}
+
+InstructionList::iterator &InstructionList::iterator::operator--() {
+  // end() has no node, so stepping back from it lands on the tail
+  node = node == nullptr ? list->tail : node->prev;
+  return *this;
+}
+
+InstructionList::iterator InstructionList::iterator::operator--(int) {
+  iterator previous = *this;
+  --*this;
+  return previous;
+}
+
+bool InstructionList::iterator::operator==(const iterator &other) const {
+  return node == other.node;
 }
 
 //
-// Mov
+// List
 //
 
-Mov::Mov(Value d, Value s, Token t)
-    : dest(d), src(s), Instruction(Op::MOV, t) {}
+InstructionList::InstructionList() : head(nullptr), tail(nullptr), size_(0) {}
 
-void Mov::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println(std::format("{} {}, {}", hlir::to_string(op),
-                              hlir::to_string(dest, symbols),
-                              hlir::to_string(src, symbols)));
-  printer.exit();
+InstructionList::InstructionList(InstructionList &&other) noexcept
+    : head(other.head), tail(other.tail), size_(other.size_) {
+  other.head = nullptr;
+  other.tail = nullptr;
+  other.size_ = 0;
 }
 
-Value &Mov::get_dest() { return dest; }
+InstructionList &InstructionList::operator=(InstructionList &&other) noexcept {
+  if (this == &other)
+    return *this;
 
-Value &Mov::get_arg1() { return src; }
+  head = other.head;
+  tail = other.tail;
+  size_ = other.size_;
 
-//
-// Error
-//
+  other.head = nullptr;
+  other.tail = nullptr;
+  other.size_ = 0;
 
-Error::Error(BranchCondition ec, Value v, runtime::Error re, Token t)
-    : error(re), condition(ec), check(v), Instruction(Op::ERROR, t) {}
+  return *this;
+}
 
-void Error::print(Printer printer, const SymbolTable &symbols) const {
-  printer.enter();
-  printer.println(std::format(
-      "{}.{} {} {}", hlir::to_string(op), hlir::to_string(condition),
-      hlir::to_string(check, symbols), runtime::to_string(error)));
-  printer.exit();
+InstructionList::iterator InstructionList::begin() const {
+  return iterator(head, this);
 }
 
-Value &Error::get_arg1() { return check; }
+InstructionList::iterator InstructionList::end() const {
+  return iterator(nullptr, this);
+}
 
-/***********************
- *                     *
- *      Context        *
- *                     *
- **********************/
+size_t InstructionList::size() const { return size_; }
 
-Context::Context(SymbolTable &s) : temporaries(0), labels(0), symbols(s) {}
+bool InstructionList::empty() const { return size_ == 0; }
 
-Value Context::create_temporary(Symbol static_type) {
-  return Value::temp(temporaries++, static_type);
+Instruction *InstructionList::front() const { return head; }
+
+Instruction *InstructionList::back() const { return tail; }
+
+void InstructionList::link_before(Instruction *position,
+                                  Instruction *instruction) {
+  Instruction *before = position == nullptr ? tail : position->prev;
+
+  instruction->prev = before;
+  instruction->next = position;
+
+  if (before == nullptr)
+    head = instruction;
+  else
+    before->next = instruction;
+
+  if (position == nullptr)
+    tail = instruction;
+  else
+    position->prev = instruction;
+
+  size_++;
+}
+
+void InstructionList::push_back(Instruction *instruction) {
+  link_before(nullptr, instruction);
+}
+
+void InstructionList::push_front(Instruction *instruction) {
+  link_before(head, instruction);
+}
+
+InstructionList::iterator InstructionList::insert(iterator position,
+                                                  Instruction *instruction) {
+  link_before(*position, instruction);
+  return iterator(instruction, this);
+}
+
+InstructionList::iterator InstructionList::erase(iterator position) {
+  Instruction *instruction = *position;
+  Instruction *after = instruction->next;
+
+  if (instruction->prev == nullptr)
+    head = after;
+  else
+    instruction->prev->next = after;
+
+  if (after == nullptr)
+    tail = instruction->prev;
+  else
+    after->prev = instruction->prev;
+
+  instruction->prev = nullptr;
+  instruction->next = nullptr;
+  size_--;
+
+  return iterator(after, this);
 }
 
-int Context::create_label_idx() { return labels++; }
+void InstructionList::splice(iterator position, InstructionList &&other) {
+  if (other.empty() || &other == this)
+    return;
+
+  Instruction *at = *position;
+  Instruction *before = at == nullptr ? tail : at->prev;
+
+  other.head->prev = before;
+  other.tail->next = at;
+
+  if (before == nullptr)
+    head = other.head;
+  else
+    before->next = other.head;
+
+  if (at == nullptr)
+    tail = other.tail;
+  else
+    at->prev = other.tail;
+
+  size_ += other.size_;
+
+  other.head = nullptr;
+  other.tail = nullptr;
+  other.size_ = 0;
+}
 
 /***********************
  *                     *
  *        Method       *
  *                     *
  **********************/
-Method::Method(Symbol n) : name(n) {}
+
+Method::Method(Symbol n) : temporaries(0), labels(0), name(n) {}
+
+Value Method::create_temporary(Symbol static_type) {
+  return Value::temp(temporaries++, static_type);
+}
+
+int Method::create_label_idx() { return labels++; }
+
+int Method::num_temporaries() const { return temporaries; }
+
+int Method::num_labels() const { return labels; }
 
 void Method::print(Printer printer, const SymbolTable &symbols) const {
   printer.println(std::format("{} {{", symbols.get_string(name)));
@@ -490,13 +665,47 @@ void Method::print(Printer printer, const SymbolTable &symbols) const {
   printer.println("}");
 }
 
+/***********************
+ *                     *
+ *       Builder       *
+ *                     *
+ **********************/
+
+Builder::Builder(Method &m) : method(m) {}
+
+/***********************
+ *                     *
+ *       Context       *
+ *                     *
+ **********************/
+
+Context::Context(SymbolTable &s, const ObjectLayout &l, Method &m,
+                 Lowering lw)
+    : symbols(s), layout(l), method(m), lowering(lw), builder(m) {}
+
+Value Context::create_temporary(Symbol static_type) {
+  return method.create_temporary(static_type);
+}
+
+int Context::create_label_idx() { return method.create_label_idx(); }
+
+Value Context::attribute(Symbol name, Symbol static_type) const {
+  const Field *field = layout.field(name);
+  if (field == nullptr)
+    fatal(std::format("INTERNAL: attribute {} missing from object layout",
+                      symbols.get_string(name)));
+
+  return Value::attr(name, field->offset, static_type);
+}
+
 /***********************
  *                     *
  *        Class        *
  *                     *
  **********************/
 
-Class::Class(Symbol n) : name(n) {}
+Class::Class(Symbol n, Symbol initializer_name)
+    : name(n), initializer(initializer_name) {}
 
 void Class::print(Printer printer, const SymbolTable &symbols) const {
   printer.println(symbols.get_string(name));
@@ -504,11 +713,7 @@ void Class::print(Printer printer, const SymbolTable &symbols) const {
 
   printer.enter();
 
-  printer.println("__initializer__ {");
-  for (const auto &instruction : initializer) {
-    instruction->print(printer, symbols);
-  }
-  printer.println("}");
+  initializer.print(printer, symbols);
 
   for (const auto &[_, method] : methods) {
     method.print(printer, symbols);
@@ -0,0 +1,185 @@
+#include "hlir_analysis.h"
+#include "statistic.h"
+#include <bit>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *  PreservedAnalyses  *
+ *                     *
+ **********************/
+
+PreservedAnalyses::PreservedAnalyses(std::initializer_list<Analysis> analyses)
+    : bits(0) {
+  for (Analysis analysis : analyses)
+    bits |= static_cast<uint8_t>(analysis);
+}
+
+PreservedAnalyses PreservedAnalyses::none() {
+  return PreservedAnalyses(std::initializer_list<Analysis>{});
+}
+
+PreservedAnalyses PreservedAnalyses::all() {
+  return PreservedAnalyses{Analysis::CFG, Analysis::DOMINATORS,
+                           Analysis::LIVENESS, Analysis::REACHING_DEFINITIONS};
+}
+
+bool PreservedAnalyses::preserves(Analysis analysis) const {
+  // Nothing survives a change to the CFG
+  uint8_t needed =
+      static_cast<uint8_t>(analysis) | static_cast<uint8_t>(Analysis::CFG);
+  return (bits & needed) == needed;
+}
+
+/***********************
+ *                     *
+ *   MethodAnalyses    *
+ *                     *
+ **********************/
+
+// Indexed by bit position of the Analysis
+static Statistic analysis_hits[] = {
+    {"analysis", "cfg_hits", "Control-flow graphs reused"},
+    {"analysis", "dominators_hits", "Dominator trees reused"},
+    {"analysis", "liveness_hits", "Liveness results reused"},
+    {"analysis", "reaching_definitions_hits",
+     "Reaching definitions results reused"},
+};
+
+static Statistic analysis_misses[] = {
+    {"analysis", "cfg_misses", "Control-flow graphs built"},
+    {"analysis", "dominators_misses", "Dominator trees built"},
+    {"analysis", "liveness_misses", "Liveness results computed"},
+    {"analysis", "reaching_definitions_misses",
+     "Reaching definitions results computed"},
+};
+
+static int bit_position(Analysis analysis) {
+  return std::countr_zero(static_cast<uint8_t>(analysis));
+}
+
+MethodAnalyses::MethodAnalyses(Method &m, const SymbolMap<bool> *pc)
+    : method(m), pure_classes_(pc), cfg_valid(false), hit_counts{},
+      miss_counts{}, reported_hits{}, reported_misses{} {}
+
+MethodAnalyses::~MethodAnalyses() { report_statistics(); }
+
+void MethodAnalyses::report_statistics() {
+  for (int i = 0; i < 4; i++) {
+    analysis_hits[i].add(hit_counts[i] - reported_hits[i]);
+    analysis_misses[i].add(miss_counts[i] - reported_misses[i]);
+    reported_hits[i] = hit_counts[i];
+    reported_misses[i] = miss_counts[i];
+  }
+}
+
+Method &MethodAnalyses::get_method() const { return method; }
+
+const SymbolMap<bool> &MethodAnalyses::pure_classes() const {
+  static const SymbolMap<bool> NO_PURE_CLASSES;
+  return pure_classes_ != nullptr ? *pure_classes_ : NO_PURE_CLASSES;
+}
+
+void MethodAnalyses::record(Analysis analysis, bool hit) {
+  (hit ? hit_counts : miss_counts)[bit_position(analysis)]++;
+}
+
+uint64_t MethodAnalyses::hits(Analysis analysis) const {
+  return hit_counts[bit_position(analysis)];
+}
+
+uint64_t MethodAnalyses::misses(Analysis analysis) const {
+  return miss_counts[bit_position(analysis)];
+}
+
+template <> CFG &MethodAnalyses::get<CFG>() {
+  record(Analysis::CFG, cfg_valid);
+  if (!cfg_valid) {
+    if (cfg)
+      cfg->rebuild();
+    else
+      cfg = std::make_unique<CFG>(method);
+    cfg_valid = true;
+  }
+  return *cfg;
+}
+
+template <> DominatorTree &MethodAnalyses::get<DominatorTree>() {
+  record(Analysis::DOMINATORS, dominators != nullptr);
+  if (!dominators)
+    dominators = std::make_unique<DominatorTree>(get<CFG>());
+  return *dominators;
+}
+
+template <> Liveness &MethodAnalyses::get<Liveness>() {
+  record(Analysis::LIVENESS, liveness != nullptr);
+  if (!liveness)
+    liveness = std::make_unique<Liveness>(get<CFG>());
+  return *liveness;
+}
+
+template <> ReachingDefinitions &MethodAnalyses::get<ReachingDefinitions>() {
+  record(Analysis::REACHING_DEFINITIONS, reaching_definitions != nullptr);
+  if (!reaching_definitions)
+    reaching_definitions = std::make_unique<ReachingDefinitions>(get<CFG>());
+  return *reaching_definitions;
+}
+
+void MethodAnalyses::invalidate(Analysis analysis) {
+  switch (analysis) {
+  case Analysis::CFG:
+    cfg_valid = false;
+    dominators.reset();
+    liveness.reset();
+    reaching_definitions.reset();
+    break;
+  case Analysis::DOMINATORS:
+    dominators.reset();
+    break;
+  case Analysis::LIVENESS:
+    liveness.reset();
+    break;
+  case Analysis::REACHING_DEFINITIONS:
+    reaching_definitions.reset();
+    break;
+  }
+}
+
+void MethodAnalyses::invalidate(const PreservedAnalyses &preserved) {
+  for (Analysis analysis : {Analysis::CFG, Analysis::DOMINATORS,
+                            Analysis::LIVENESS, Analysis::REACHING_DEFINITIONS})
+    if (!preserved.preserves(analysis))
+      invalidate(analysis);
+}
+
+/***********************
+ *                     *
+ *   AnalysisManager   *
+ *                     *
+ **********************/
+
+MethodAnalyses &AnalysisManager::of(Method &method) {
+  std::unique_ptr<MethodAnalyses> &analyses = methods[&method];
+  if (!analyses)
+    analyses = std::make_unique<MethodAnalyses>(method, &pure_classes);
+  return *analyses;
+}
+
+void AnalysisManager::set_pure_classes(SymbolMap<bool> pc) {
+  pure_classes = std::move(pc);
+}
+
+void AnalysisManager::invalidate(const PreservedAnalyses &preserved) {
+  for (auto &[method, analyses] : methods)
+    analyses->invalidate(preserved);
+}
+
+void AnalysisManager::report_statistics() {
+  for (auto &[method, analyses] : methods)
+    analyses->report_statistics();
+}
+
+void AnalysisManager::clear() { methods.clear(); }
+
+} // namespace hlir
@@ -0,0 +1,369 @@
+#include "hlir_cfg.h"
+#include "error.h"
+#include <algorithm>
+#include <format>
+#include <utility>
+
+namespace hlir {
+
+static bool ends_block(const Instruction *instruction) {
+  return instruction->op == Op::BRANCH ||
+         (instruction->op == Op::ERROR &&
+          instruction->condition == BranchCondition::ALWAYS);
+}
+
+static int branch_label(Instruction *branch) {
+  return static_cast<Branch *>(branch)->get_target().label_idx;
+}
+
+static std::string to_string(const std::vector<BlockIdx> &blocks) {
+  std::string result;
+  for (BlockIdx block : blocks) {
+    if (!result.empty())
+      result += ", ";
+    result += std::to_string(block);
+  }
+  return result;
+}
+
+/***********************
+ *                     *
+ *     BasicBlock      *
+ *                     *
+ **********************/
+
+BasicBlock::iterator::iterator(Instruction *n, Instruction *l)
+    : node(n), last(l) {}
+
+Instruction *BasicBlock::iterator::operator*() const { return node; }
+
+BasicBlock::iterator &BasicBlock::iterator::operator++() {
+  node = node == last ? nullptr : node->get_next();
+  return *this;
+}
+
+BasicBlock::iterator BasicBlock::iterator::operator++(int) {
+  iterator previous = *this;
+  ++*this;
+  return previous;
+}
+
+bool BasicBlock::iterator::operator==(const iterator &other) const {
+  return node == other.node;
+}
+
+BasicBlock::BasicBlock(BlockIdx i)
+    : idx(i), first(nullptr), last(nullptr), fallthrough(NO_BLOCK) {}
+
+BasicBlock::iterator BasicBlock::begin() const { return iterator(first, last); }
+
+BasicBlock::iterator BasicBlock::end() const { return iterator(nullptr, last); }
+
+bool BasicBlock::empty() const { return first == nullptr; }
+
+Instruction *BasicBlock::terminator() const {
+  return last != nullptr && ends_block(last) ? last : nullptr;
+}
+
+/***********************
+ *                     *
+ *         CFG         *
+ *                     *
+ **********************/
+
+CFG::CFG(Method &m) : method(m), size_(0) { rebuild(); }
+
+BlockIdx CFG::start_block(Instruction *instruction) {
+  if (size_ == blocks_.size())
+    blocks_.emplace_back(size_);
+
+  BasicBlock &block = blocks_[size_];
+  block.first = instruction;
+  block.last = instruction;
+  block.preds.clear();
+  block.succs.clear();
+  block.fallthrough = NO_BLOCK;
+
+  return size_++;
+}
+
+void CFG::add_edge(BlockIdx from, BlockIdx to) {
+  std::vector<BlockIdx> &succs = blocks_[from].succs;
+  if (std::find(succs.begin(), succs.end(), to) != succs.end())
+    return;
+
+  succs.push_back(to);
+  blocks_[to].preds.push_back(from);
+}
+
+void CFG::rebuild() {
+  size_ = 0;
+  label_blocks.assign(method.num_labels(), NO_BLOCK);
+
+  // Split the list into blocks. A label starts a new block unless it follows
+  // other labels, since falling from one into the next is not a real edge.
+  BlockIdx current = NO_BLOCK;
+  bool open = false;
+
+  for (Instruction *instruction : method.instructions) {
+    bool is_label = instruction->op == Op::LABEL;
+    bool joins_labels =
+        is_label && open && blocks_[current].last->op == Op::LABEL;
+
+    if (!open || (is_label && !joins_labels))
+      current = start_block(instruction);
+
+    if (is_label) {
+      int label_idx = static_cast<Label *>(instruction)->get_idx();
+      if (label_idx < 0 ||
+          static_cast<size_t>(label_idx) >= label_blocks.size())
+        fatal(std::format("INTERNAL: label {} was not created by its method",
+                          label_idx));
+      label_blocks[label_idx] = current;
+    }
+
+    blocks_[current].last = instruction;
+    open = !ends_block(instruction);
+  }
+
+  // Then connect them
+  BlockIdx count = static_cast<BlockIdx>(size_);
+  for (BlockIdx idx = 0; idx < count; idx++) {
+    BasicBlock &block = blocks_[idx];
+    BlockIdx next = idx + 1 < count ? idx + 1 : NO_BLOCK;
+    Instruction *terminator = block.terminator();
+
+    if (terminator == nullptr) {
+      block.fallthrough = next;
+    } else if (terminator->op == Op::BRANCH) {
+      BlockIdx target = block_of_label(branch_label(terminator));
+      if (target == NO_BLOCK)
+        fatal(std::format("INTERNAL: branch to label {} outside of its method",
+                          branch_label(terminator)));
+      add_edge(idx, target);
+
+      if (terminator->condition != BranchCondition::ALWAYS)
+        block.fallthrough = next;
+    }
+
+    if (block.fallthrough != NO_BLOCK)
+      add_edge(idx, block.fallthrough);
+  }
+}
+
+Method &CFG::get_method() const { return method; }
+
+size_t CFG::size() const { return size_; }
+
+BlockIdx CFG::entry() const { return size_ == 0 ? NO_BLOCK : 0; }
+
+BasicBlock &CFG::block(BlockIdx idx) { return blocks_[idx]; }
+
+const BasicBlock &CFG::block(BlockIdx idx) const { return blocks_[idx]; }
+
+std::span<BasicBlock> CFG::blocks() {
+  return std::span<BasicBlock>(blocks_.data(), size_);
+}
+
+std::span<const BasicBlock> CFG::blocks() const {
+  return std::span<const BasicBlock>(blocks_.data(), size_);
+}
+
+BlockIdx CFG::block_of_label(int label_idx) const {
+  if (label_idx < 0 || static_cast<size_t>(label_idx) >= label_blocks.size())
+    return NO_BLOCK;
+  return label_blocks[label_idx];
+}
+
+std::vector<BlockIdx> CFG::reverse_postorder() const {
+  std::vector<BlockIdx> order;
+  if (size_ == 0)
+    return order;
+
+  // Iterative DFS, remembering the next successor to visit for each block on
+  // the stack
+  std::vector<bool> visited(size_, false);
+  std::vector<std::pair<BlockIdx, size_t>> stack = {{entry(), 0}};
+  visited[entry()] = true;
+
+  while (!stack.empty()) {
+    auto &[idx, next_succ] = stack.back();
+    const std::vector<BlockIdx> &succs = blocks_[idx].succs;
+
+    if (next_succ == succs.size()) {
+      order.push_back(idx);
+      stack.pop_back();
+      continue;
+    }
+
+    BlockIdx succ = succs[next_succ++];
+    if (!visited[succ]) {
+      visited[succ] = true;
+      stack.push_back({succ, 0});
+    }
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+void CFG::insert(BlockIdx idx, Instruction *position,
+                 Instruction *instruction) {
+  BasicBlock &block = blocks_[idx];
+  InstructionList &instructions = method.instructions;
+
+  if (block.empty()) {
+    // Blocks are in list order, so an empty block sits right before the next
+    // block that has instructions
+    Instruction *before = nullptr;
+    for (size_t next = idx + 1; next < size_ && before == nullptr; next++)
+      before = blocks_[next].first;
+
+    instructions.insert(InstructionList::iterator(before, &instructions),
+                        instruction);
+    block.first = instruction;
+    block.last = instruction;
+    return;
+  }
+
+  if (position == nullptr) {
+    instructions.insert(
+        InstructionList::iterator(block.last->get_next(), &instructions),
+        instruction);
+    block.last = instruction;
+    return;
+  }
+
+  instructions.insert(InstructionList::iterator(position, &instructions),
+                      instruction);
+  if (position == block.first)
+    block.first = instruction;
+}
+
+void CFG::erase(BlockIdx idx, Instruction *instruction) {
+  BasicBlock &block = blocks_[idx];
+
+  if (instruction == block.first && instruction == block.last) {
+    block.first = nullptr;
+    block.last = nullptr;
+  } else if (instruction == block.first) {
+    block.first = instruction->get_next();
+  } else if (instruction == block.last) {
+    block.last = instruction->get_prev();
+  }
+
+  method.instructions.erase(
+      InstructionList::iterator(instruction, &method.instructions));
+}
+
+int CFG::ensure_label(BlockIdx idx, const SymbolTable &symbols) {
+  BasicBlock &block = blocks_[idx];
+
+  if (block.first != nullptr && block.first->op == Op::LABEL)
+    return static_cast<Label *>(block.first)->get_idx();
+
+  int label_idx = method.create_label_idx();
+  Token token = block.first != nullptr ? block.first->token : Token();
+
+  insert(idx, block.first,
+         method.create<Label>(label_idx, symbols.block_label, token));
+
+  label_blocks.resize(method.num_labels(), NO_BLOCK);
+  label_blocks[label_idx] = idx;
+
+  return label_idx;
+}
+
+void CFG::linearize(std::span<const BlockIdx> order,
+                    const SymbolTable &symbols) {
+  std::vector<int> position(size_, -1);
+  for (size_t k = 0; k < order.size(); k++) {
+    if (order[k] < 0 || static_cast<size_t>(order[k]) >= size_ ||
+        position[order[k]] != -1)
+      fatal(std::format("INTERNAL: block {} laid out twice or unknown",
+                        order[k]));
+    position[order[k]] = k;
+  }
+
+  for (size_t k = 0; k < order.size(); k++) {
+    const BasicBlock &block = blocks_[order[k]];
+
+    for (BlockIdx succ : block.succs)
+      if (position[succ] == -1)
+        fatal(std::format("INTERNAL: block {} reaches dropped block {}",
+                          block.idx, succ));
+
+    // Only the last block of the list may run off the end of the method
+    if (block.terminator() == nullptr && block.fallthrough == NO_BLOCK &&
+        k + 1 != order.size())
+      fatal(std::format("INTERNAL: returning block {} must be laid out last",
+                        block.idx));
+  }
+
+  // Find the jumps we need first, while empty blocks can still be given
+  // labels in their original place
+  std::vector<int> jump_labels(order.size(), -1);
+  for (size_t k = 0; k < order.size(); k++) {
+    BlockIdx next = k + 1 < order.size() ? order[k + 1] : NO_BLOCK;
+    BlockIdx fallthrough = blocks_[order[k]].fallthrough;
+
+    if (fallthrough != NO_BLOCK && fallthrough != next)
+      jump_labels[k] = ensure_label(fallthrough, symbols);
+  }
+
+  InstructionList &old_instructions = method.instructions;
+  InstructionList instructions;
+
+  for (size_t k = 0; k < order.size(); k++) {
+    const BasicBlock &block = blocks_[order[k]];
+    BlockIdx next = k + 1 < order.size() ? order[k + 1] : NO_BLOCK;
+
+    Instruction *useless_jump = block.terminator();
+    if (useless_jump != nullptr &&
+        (useless_jump->op != Op::BRANCH ||
+         useless_jump->condition != BranchCondition::ALWAYS ||
+         block_of_label(branch_label(useless_jump)) != next))
+      useless_jump = nullptr;
+
+    // Move the instructions of the block over, in place
+    Instruction *instruction = block.first;
+    while (instruction != nullptr) {
+      Instruction *following =
+          instruction == block.last ? nullptr : instruction->get_next();
+
+      old_instructions.erase(
+          InstructionList::iterator(instruction, &old_instructions));
+      if (instruction != useless_jump)
+        instructions.push_back(instruction);
+
+      instruction = following;
+    }
+
+    if (jump_labels[k] != -1) {
+      Token token = block.last != nullptr ? block.last->token : Token();
+      instructions.push_back(method.create<Branch>(
+          BranchCondition::ALWAYS, Value::constant(true, symbols.bool_type),
+          Position(jump_labels[k]), token));
+    }
+  }
+
+  method.instructions = std::move(instructions);
+  rebuild();
+}
+
+void CFG::print(Printer printer, const SymbolTable &symbols) const {
+  printer.println(std::format("{} {{", symbols.get_string(method.name)));
+
+  for (const BasicBlock &block : blocks()) {
+    printer.println(std::format("block {} (preds: [{}], succs: [{}])",
+                                block.idx, to_string(block.preds),
+                                to_string(block.succs)));
+
+    for (Instruction *instruction : block)
+      instruction->print(printer, symbols);
+  }
+
+  printer.println("}");
+}
+
+} // namespace hlir
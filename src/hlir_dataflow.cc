@@ -0,0 +1,326 @@
+#include "hlir_dataflow.h"
+#include <algorithm>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *    VariableIndex    *
+ *                     *
+ **********************/
+
+VariableIndex::VariableIndex(const Method &method) {
+  values.push_back(Value::acc(Symbol()));
+  bool acc_seen = false;
+
+  auto add = [&](Value value) {
+    switch (value.kind()) {
+    case ValueKind::ACC:
+      if (!acc_seen) {
+        values[ACC] = value;
+        acc_seen = true;
+      }
+      break;
+
+    case ValueKind::TEMP:
+      if (static_cast<size_t>(value.num()) >= temps.size())
+        temps.resize(value.num() + 1, -1);
+
+      if (temps[value.num()] == -1) {
+        temps[value.num()] = values.size();
+        values.push_back(value);
+      }
+      break;
+
+    case ValueKind::LOCAL:
+      if (locals.emplace(value.symbol(), values.size()))
+        values.push_back(value);
+      break;
+
+    default:
+      break;
+    }
+  };
+
+  for (Instruction *instruction : method.instructions) {
+    if (instruction->has_dest())
+      add(instruction->get_dest());
+
+    for (Value arg : instruction->args())
+      add(arg);
+  }
+}
+
+size_t VariableIndex::size() const { return values.size(); }
+
+int VariableIndex::of(Value value) const {
+  switch (value.kind()) {
+  case ValueKind::ACC:
+    return ACC;
+  case ValueKind::TEMP:
+    return static_cast<size_t>(value.num()) < temps.size()
+               ? temps[value.num()]
+               : -1;
+  case ValueKind::LOCAL: {
+    const int *id = locals.find(value.symbol());
+    return id == nullptr ? -1 : *id;
+  }
+  default:
+    return -1;
+  }
+}
+
+Value VariableIndex::value(int id) const { return values[id]; }
+
+/***********************
+ *                     *
+ *   DataflowProblem   *
+ *                     *
+ **********************/
+
+DataflowProblem::DataflowProblem(Direction d, size_t n)
+    : direction(d), num_bits(n) {}
+
+BitSet DataflowProblem::initial() const { return BitSet(num_bits); }
+
+BitSet DataflowProblem::boundary(const CFG &, BlockIdx) const {
+  return BitSet(num_bits);
+}
+
+void DataflowProblem::meet(BitSet &into, const BitSet &from) const {
+  into.union_with(from);
+}
+
+GenKillProblem::GenKillProblem(Direction d, size_t n, size_t num_blocks)
+    : DataflowProblem(d, n), gen(num_blocks, BitSet(n)),
+      kill(num_blocks, BitSet(n)) {}
+
+bool GenKillProblem::transfer(BlockIdx block, const BitSet &in,
+                              BitSet &out) const {
+  return out.assign_transfer(gen[block], in, kill[block]);
+}
+
+DataflowResult solve_dataflow(const CFG &cfg, const DataflowProblem &problem) {
+  bool forward = problem.direction == Direction::FORWARD;
+
+  // Visit blocks after the ones they depend on as much as loops allow, then
+  // whatever is unreachable
+  std::vector<BlockIdx> order = cfg.reverse_postorder();
+  if (!forward)
+    std::reverse(order.begin(), order.end());
+
+  std::vector<bool> pending(cfg.size(), false);
+  for (BlockIdx block : order)
+    pending[block] = true;
+
+  for (size_t block = 0; block < cfg.size(); block++) {
+    if (!pending[block]) {
+      pending[block] = true;
+      order.push_back(block);
+    }
+  }
+
+  // input is the side of the block facts flow into, output the other one
+  BitSet initial = problem.initial();
+  std::vector<BitSet> input(cfg.size(), initial);
+  std::vector<BitSet> output(cfg.size(), initial);
+
+  bool sweep = true;
+  while (sweep) {
+    sweep = false;
+
+    for (BlockIdx idx : order) {
+      if (!pending[idx])
+        continue;
+      pending[idx] = false;
+
+      const BasicBlock &block = cfg.block(idx);
+      const std::vector<BlockIdx> &sources = forward ? block.preds : block.succs;
+      BitSet &in = input[idx];
+
+      if (sources.empty()) {
+        in = problem.boundary(cfg, idx);
+      } else {
+        in = output[sources[0]];
+        for (size_t i = 1; i < sources.size(); i++)
+          problem.meet(in, output[sources[i]]);
+
+        // Edges back to the entry join the one entering the method
+        if (forward && idx == cfg.entry())
+          problem.meet(in, problem.boundary(cfg, idx));
+      }
+
+      if (!problem.transfer(idx, in, output[idx]))
+        continue;
+
+      for (BlockIdx dependent : forward ? block.succs : block.preds) {
+        pending[dependent] = true;
+        sweep = true;
+      }
+    }
+  }
+
+  if (forward)
+    return DataflowResult{std::move(input), std::move(output)};
+  return DataflowResult{std::move(output), std::move(input)};
+}
+
+/***********************
+ *                     *
+ *      Liveness       *
+ *                     *
+ **********************/
+
+/// Backward, with reads as gen and writes as kill. Phi arguments count as read
+/// at the start of the phi block, which is conservative.
+class LivenessProblem : public GenKillProblem {
+private:
+  const VariableIndex &index;
+
+public:
+  LivenessProblem(const CFG &cfg, const VariableIndex &i)
+      : GenKillProblem(Direction::BACKWARD, i.size(), cfg.size()), index(i) {
+    for (const BasicBlock &block : cfg.blocks()) {
+      BitSet &block_gen = gen[block.idx];
+      BitSet &block_kill = kill[block.idx];
+
+      for (Instruction *instruction = block.last; instruction != nullptr;
+           instruction = instruction == block.first ? nullptr
+                                                    : instruction->get_prev()) {
+        if (instruction->has_dest()) {
+          int id = index.of(instruction->get_dest());
+          if (id != -1) {
+            block_gen.reset(id);
+            block_kill.set(id);
+          }
+        }
+
+        for (Value arg : instruction->args()) {
+          int id = index.of(arg);
+          if (id != -1)
+            block_gen.set(id);
+        }
+      }
+    }
+  }
+
+  BitSet boundary(const CFG &cfg, BlockIdx idx) const override {
+    BitSet live(num_bits);
+
+    // The returning block hands acc to the caller. Errors do not return.
+    if (cfg.block(idx).terminator() == nullptr)
+      live.set(VariableIndex::ACC);
+
+    return live;
+  }
+};
+
+Liveness::Liveness(const CFG &cfg)
+    : index(cfg.get_method()),
+      result(solve_dataflow(cfg, LivenessProblem(cfg, index))) {}
+
+const VariableIndex &Liveness::variables() const { return index; }
+
+const BitSet &Liveness::live_in(BlockIdx block) const {
+  return result.in[block];
+}
+
+const BitSet &Liveness::live_out(BlockIdx block) const {
+  return result.out[block];
+}
+
+/***********************
+ *                     *
+ * ReachingDefinitions *
+ *                     *
+ **********************/
+
+/// Forward, with the last write to each variable in a block as gen and every
+/// write to the same variables as kill
+class ReachingDefinitionsProblem : public GenKillProblem {
+public:
+  ReachingDefinitionsProblem(const CFG &cfg, const VariableIndex &index,
+                             const std::vector<Instruction *> &definitions)
+      : GenKillProblem(Direction::FORWARD, definitions.size(), cfg.size()) {
+    std::vector<int> variable_of(definitions.size());
+    std::vector<int> writes(index.size(), 0);
+
+    for (size_t i = 0; i < definitions.size(); i++) {
+      variable_of[i] = index.of(definitions[i]->get_dest());
+      writes[variable_of[i]]++;
+    }
+
+    // Every write to each variable written more than once. A variable written
+    // once is only killed by its own write, which gen adds back.
+    std::vector<int> mask_of(index.size(), -1);
+    std::vector<BitSet> masks;
+    for (size_t i = 0; i < definitions.size(); i++) {
+      int variable = variable_of[i];
+      if (writes[variable] < 2)
+        continue;
+
+      if (mask_of[variable] == -1) {
+        mask_of[variable] = masks.size();
+        masks.emplace_back(definitions.size());
+      }
+      masks[mask_of[variable]].set(i);
+    }
+
+    // Definitions are numbered in block order, so each block owns a range
+    std::vector<int> last_in_block(index.size(), -1);
+    std::vector<int> written;
+    size_t next = 0;
+
+    for (const BasicBlock &block : cfg.blocks()) {
+      written.clear();
+
+      for (Instruction *instruction : block) {
+        if (next == definitions.size() || instruction != definitions[next])
+          continue;
+
+        int variable = variable_of[next];
+        if (last_in_block[variable] == -1)
+          written.push_back(variable);
+        last_in_block[variable] = next++;
+      }
+
+      for (int variable : written) {
+        if (mask_of[variable] != -1)
+          kill[block.idx].union_with(masks[mask_of[variable]]);
+        gen[block.idx].set(last_in_block[variable]);
+        last_in_block[variable] = -1;
+      }
+    }
+  }
+};
+
+static std::vector<Instruction *> collect_definitions(const CFG &cfg,
+                                                      const VariableIndex &index) {
+  std::vector<Instruction *> definitions;
+  for (const BasicBlock &block : cfg.blocks())
+    for (Instruction *instruction : block)
+      if (instruction->has_dest() && index.of(instruction->get_dest()) != -1)
+        definitions.push_back(instruction);
+  return definitions;
+}
+
+ReachingDefinitions::ReachingDefinitions(const CFG &cfg)
+    : index(cfg.get_method()), definitions_(collect_definitions(cfg, index)),
+      result(solve_dataflow(
+          cfg, ReachingDefinitionsProblem(cfg, index, definitions_))) {}
+
+const VariableIndex &ReachingDefinitions::variables() const { return index; }
+
+const std::vector<Instruction *> &ReachingDefinitions::definitions() const {
+  return definitions_;
+}
+
+const BitSet &ReachingDefinitions::reaching_in(BlockIdx block) const {
+  return result.in[block];
+}
+
+const BitSet &ReachingDefinitions::reaching_out(BlockIdx block) const {
+  return result.out[block];
+}
+
+} // namespace hlir
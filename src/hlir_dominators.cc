@@ -0,0 +1,141 @@
+#include "hlir_dominators.h"
+#include <utility>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *    DominatorTree    *
+ *                     *
+ **********************/
+
+DominatorTree::DominatorTree(const CFG &cfg)
+    : order(cfg.reverse_postorder()), idoms(cfg.size(), NO_BLOCK),
+      children_(cfg.size()), frontiers(cfg.size()), preorder(cfg.size(), -1),
+      postorder(cfg.size(), -1) {
+  if (order.empty())
+    return;
+
+  std::vector<int> rpo_numbers(cfg.size(), -1);
+  for (size_t i = 0; i < order.size(); i++)
+    rpo_numbers[order[i]] = i;
+
+  // Refine the dominators of each block in reverse postorder until nothing
+  // changes. The entry is its own dominator while iterating.
+  BlockIdx entry = order[0];
+  idoms[entry] = entry;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (size_t i = 1; i < order.size(); i++) {
+      BlockIdx block = order[i];
+      BlockIdx new_idom = NO_BLOCK;
+
+      for (BlockIdx pred : cfg.block(block).preds) {
+        if (idoms[pred] == NO_BLOCK)
+          continue;
+
+        new_idom = new_idom == NO_BLOCK
+                       ? pred
+                       : intersect(pred, new_idom, rpo_numbers);
+      }
+
+      if (idoms[block] != new_idom) {
+        idoms[block] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  idoms[entry] = NO_BLOCK;
+
+  for (size_t i = 1; i < order.size(); i++)
+    children_[idoms[order[i]]].push_back(order[i]);
+
+  number_tree(entry);
+
+  // A join point is in the frontier of every block between each of its
+  // predecessors and its immediate dominator. The entry joins the edges
+  // coming back to it with the one entering the method.
+  for (BlockIdx block : order) {
+    const std::vector<BlockIdx> &preds = cfg.block(block).preds;
+    if (preds.size() < (block == entry ? 1 : 2))
+      continue;
+
+    for (BlockIdx pred : preds) {
+      if (!reachable(pred))
+        continue;
+
+      for (BlockIdx runner = pred; runner != idoms[block];
+           runner = idoms[runner]) {
+        std::vector<BlockIdx> &frontier = frontiers[runner];
+        if (frontier.empty() || frontier.back() != block)
+          frontier.push_back(block);
+
+        // The entry has no dominator to stop at
+        if (runner == entry)
+          break;
+      }
+    }
+  }
+}
+
+BlockIdx DominatorTree::intersect(BlockIdx a, BlockIdx b,
+                                  const std::vector<int> &rpo_numbers) const {
+  while (a != b) {
+    while (rpo_numbers[a] > rpo_numbers[b])
+      a = idoms[a];
+    while (rpo_numbers[b] > rpo_numbers[a])
+      b = idoms[b];
+  }
+  return a;
+}
+
+void DominatorTree::number_tree(BlockIdx root) {
+  // Iterative DFS, since trees of long methods can be deep
+  std::vector<std::pair<BlockIdx, size_t>> stack = {{root, 0}};
+  int counter = 0;
+  preorder[root] = counter++;
+
+  while (!stack.empty()) {
+    auto &[block, next_child] = stack.back();
+
+    if (next_child == children_[block].size()) {
+      postorder[block] = counter++;
+      stack.pop_back();
+      continue;
+    }
+
+    BlockIdx child = children_[block][next_child++];
+    preorder[child] = counter++;
+    stack.push_back({child, 0});
+  }
+}
+
+bool DominatorTree::reachable(BlockIdx block) const {
+  return preorder[block] != -1;
+}
+
+BlockIdx DominatorTree::idom(BlockIdx block) const { return idoms[block]; }
+
+bool DominatorTree::dominates(BlockIdx a, BlockIdx b) const {
+  if (!reachable(a) || !reachable(b))
+    return false;
+  return preorder[a] <= preorder[b] && postorder[b] <= postorder[a];
+}
+
+const std::vector<BlockIdx> &DominatorTree::children(BlockIdx block) const {
+  return children_[block];
+}
+
+const std::vector<BlockIdx> &DominatorTree::frontier(BlockIdx block) const {
+  return frontiers[block];
+}
+
+const std::vector<BlockIdx> &DominatorTree::reverse_postorder() const {
+  return order;
+}
+
+} // namespace hlir
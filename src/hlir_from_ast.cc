@@ -2,7 +2,11 @@
 #include "constant_eval.h"
 #include "error.h"
 #include "hlir.h"
+#include "semantic.h"
+#include "thread_pool.h"
+#include "time_report.h"
 #include <format>
+#include <optional>
 
 /***********************
  *                     *
@@ -10,87 +14,229 @@
  *                     *
  **********************/
 
-hlir::Universe ModuleNode::to_hlir_universe(SymbolTable &symbols) const {
+hlir::Universe ModuleNode::to_hlir_universe(SymbolTable &symbols,
+                                            const ClassTree &class_tree,
+                                            hlir::Lowering lowering) const {
   auto universe = hlir::Universe();
   for (const auto &cls : classes) {
-    universe.classes.emplace(cls->name.id, cls->to_hlir_class(symbols));
+    universe.classes.emplace(
+        cls->name, cls->to_hlir_class(
+                       symbols, class_tree.get_layout(cls->name), lowering));
   }
 
   return universe;
 }
 
-hlir::InstructionList default_initialize(Symbol object_id, Symbol type,
-                                         const SymbolTable &symbols,
-                                         Token token) {
-  hlir::InstructionList instructions;
+hlir::Universe ModuleNode::to_hlir_universe(SymbolTable &symbols,
+                                            const ClassTree &class_tree,
+                                            ThreadPool &pool,
+                                            hlir::Lowering lowering) const {
+  // Every initializer and method is lowered into its own Method, reading only
+  // its own nodes, the (already built) ClassTree and the SymbolTable, so they
+  // can all be lowered independently of each other. A null method stands for
+  // the initializer of its class.
+  struct Job {
+    const ClassNode *cls;
+    const MethodNode *method;
+  };
+
+  std::vector<Job> jobs;
+  for (const auto &cls : classes) {
+    jobs.push_back({cls.get(), nullptr});
+    for (const auto &method : cls->methods)
+      jobs.push_back({cls.get(), method.get()});
+  }
+
+  std::vector<std::optional<hlir::Method>> lowered(jobs.size());
+  std::vector<Diagnostics> diagnostics(jobs.size());
+
+  pool.parallel_for(jobs.size(), [&](size_t i) {
+    DiagnosticCapture capture(diagnostics[i]);
+    const ObjectLayout &layout = class_tree.get_layout(jobs[i].cls->name);
+    TraceSpan span("method", symbols, jobs[i].cls->name,
+                   jobs[i].method ? jobs[i].method->name
+                                  : symbols.initializer_method);
+
+    try {
+      if (jobs[i].method)
+        lowered[i].emplace(
+            jobs[i].method->to_hlir_method(symbols, layout, lowering));
+      else
+        lowered[i].emplace(
+            jobs[i].cls->to_hlir_initializer(symbols, layout, lowering));
+    } catch (const FatalDiagnostic &) {
+    }
+  });
+
+  // Exits at the first fatal diagnostic, so every job below was lowered
+  for (const auto &job_diagnostics : diagnostics)
+    job_diagnostics.emit();
+
+  auto universe = hlir::Universe();
+  size_t job = 0;
+  for (const auto &cls : classes) {
+    auto lowered_class = hlir::Class(cls->name, symbols.initializer_method);
+    lowered_class.parent = cls->superclass;
+    lowered_class.initializer = std::move(*lowered[job++]);
+
+    for (const auto &method : cls->methods)
+      lowered_class.methods.emplace(method->name, std::move(*lowered[job++]));
+
+    universe.classes.emplace(cls->name, std::move(lowered_class));
+  }
+
+  return universe;
+}
+
+void default_initialize(hlir::Value dest, hlir::Context &context,
+                        Token token) {
+  const SymbolTable &symbols = context.symbols;
+  Symbol type = dest.static_type();
 
   if (type == symbols.int_type) {
-    instructions.push_back(
-        std::make_unique<hlir::Mov>(hlir::Value::attr(object_id, type),
-                                    hlir::Value::constant(0, type), token));
+    context.emit<hlir::Mov>(dest, hlir::Value::constant(0, type), token);
 
   } else if (type == symbols.bool_type) {
-    instructions.push_back(
-        std::make_unique<hlir::Mov>(hlir::Value::attr(object_id, type),
-                                    hlir::Value::constant(false, type), token));
+    context.emit<hlir::Mov>(dest, hlir::Value::constant(false, type), token);
 
   } else if (type == symbols.string_type) {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::attr(object_id, type),
-        hlir::Value::constant(symbols.string_empty, type), token));
+    context.emit<hlir::Mov>(
+        dest, hlir::Value::constant(symbols.string_empty, type), token);
 
   } else {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::attr(object_id, type),
-        hlir::Value::constant(symbols.void_value, type), token));
+    context.emit<hlir::Mov>(
+        dest, hlir::Value::constant(symbols.void_value, type), token);
   }
+}
 
-  return instructions;
+static bool passing_destinations(const hlir::Context &context) {
+  return context.lowering == hlir::Lowering::DESTINATION_PASSING;
 }
 
-hlir::Class ClassNode::to_hlir_class(SymbolTable &symbols) const {
-  auto cls = hlir::Class(name);
+// Destination for a value that is never read
+static hlir::Value discarded(const hlir::Context &context, Symbol type) {
+  return passing_destinations(context) ? hlir::Value::empty()
+                                       : hlir::Value::acc(type);
+}
 
-  auto initializer_context = hlir::Context(symbols);
+// Where an instruction that has to write its result somewhere puts it
+static hlir::Value sink(hlir::Value dest, Symbol type) {
+  return dest.is_empty() ? hlir::Value::acc(type) : dest;
+}
 
-  for (const auto &attribute : attributes) {
-    if (attribute->initializer.has_value()) {
-
-      cls.initializer.splice(
-          cls.initializer.end(),
-          attribute->initializer.value()->to_hlir(initializer_context));
-
-      cls.initializer.push_back(std::make_unique<hlir::Mov>(
-          hlir::Value::attr(attribute->object_id, attribute->declared_type),
-          hlir::Value::acc(attribute->initializer.value()->static_type.value()),
-          start_token));
-
-    } else {
-      cls.initializer.splice(cls.initializer.end(),
-                             default_initialize(attribute->object_id,
-                                                attribute->declared_type,
-                                                symbols, start_token));
-    }
+// Lowers an expression whose value is stored in dest, which through acc takes
+// a copy out of acc
+static void lower_into(const ExpressionNode &expression, hlir::Value dest,
+                       hlir::Context &context, Token token) {
+  if (passing_destinations(context)) {
+    expression.to_hlir(context, dest);
+    return;
+  }
+
+  hlir::Value acc = hlir::Value::acc(expression.static_type.value());
+  expression.to_hlir(context, acc);
+  context.emit<hlir::Mov>(dest, acc, token);
+}
+
+// Lowers an operand and returns where the operation reads it from. Through
+// acc, every operand but the last one is copied to a temporary before the
+// next one overwrites acc. Passing destinations, each operand gets its own
+// temporary, unless it is a constant or a variable that cannot change before
+// it is read, because it is read last or only reads follow it (stable).
+static hlir::Value lower_operand(const ExpressionNode &operand, bool last,
+                                 bool stable, hlir::Context &context,
+                                 Token token) {
+  Symbol type = operand.static_type.value();
+
+  if (passing_destinations(context)) {
+    hlir::Value place = operand.value_in_place(context);
+    bool fixed = place.kind() == hlir::ValueKind::CONSTANT ||
+                 place.kind() == hlir::ValueKind::SELF;
+    if (!place.is_empty() && (fixed || last || stable))
+      return place;
+
+    hlir::Value temporary = context.create_temporary(type);
+    operand.to_hlir(context, temporary);
+    return temporary;
+  }
+
+  hlir::Value acc = hlir::Value::acc(type);
+  operand.to_hlir(context, acc);
+  if (last)
+    return acc;
+
+  hlir::Value temporary = context.create_temporary(type);
+  context.emit<hlir::Mov>(temporary, acc, token);
+  return temporary;
+}
+
+static bool only_reads(const ExpressionNode &expression,
+                       const hlir::Context &context) {
+  return !expression.value_in_place(context).is_empty();
+}
+
+hlir::Class ClassNode::to_hlir_class(SymbolTable &symbols,
+                                     const ObjectLayout &layout,
+                                     hlir::Lowering lowering) const {
+  auto cls = hlir::Class(name, symbols.initializer_method);
+  cls.parent = superclass;
+  {
+    TraceSpan span("method", symbols, name, symbols.initializer_method);
+    cls.initializer = to_hlir_initializer(symbols, layout, lowering);
   }
 
   for (const auto &method : methods) {
-    cls.methods.emplace(method->name.id, method->to_hlir_method(symbols));
+    TraceSpan span("method", symbols, name, method->name);
+    cls.methods.emplace(method->name,
+                        method->to_hlir_method(symbols, layout, lowering));
   }
   return cls;
 }
 
-hlir::Method MethodNode::to_hlir_method(SymbolTable &symbols) const {
+hlir::Method ClassNode::to_hlir_initializer(SymbolTable &symbols,
+                                            const ObjectLayout &layout,
+                                            hlir::Lowering lowering) const {
+  auto initializer = hlir::Method(symbols.initializer_method);
+  auto context = hlir::Context(symbols, layout, initializer, lowering);
+
+  // Every attribute holds its default value before any initializer runs, since
+  // initializers may read attributes declared after them
+  for (const auto &attribute : attributes) {
+    default_initialize(
+        context.attribute(attribute->object_id, attribute->declared_type),
+        context, start_token);
+  }
+
+  for (const auto &attribute : attributes) {
+    if (!attribute->initializer.has_value())
+      continue;
+
+    lower_into(*attribute->initializer.value(),
+               context.attribute(attribute->object_id,
+                                 attribute->declared_type),
+               context, start_token);
+  }
+
+  return initializer;
+}
+
+hlir::Method MethodNode::to_hlir_method(SymbolTable &symbols,
+                                        const ObjectLayout &layout,
+                                        hlir::Lowering lowering) const {
   auto method = hlir::Method(name);
-  auto context = hlir::Context(symbols);
+  auto context = hlir::Context(symbols, layout, method, lowering);
 
-  method.instructions = body->to_hlir(context);
+  body->to_hlir(context, hlir::Value::acc(body->static_type.value()));
 
   return method;
 }
 
-hlir::InstructionList ExpressionNode::to_hlir(hlir::Context &context) const {
+void ExpressionNode::to_hlir(hlir::Context &, hlir::Value) const {
   fatal("INTERNAL: Should not call to_hlir on bare ExpressionNode");
-  return hlir::InstructionList(); // fool linter
+}
+
+hlir::Value ExpressionNode::value_in_place(const hlir::Context &) const {
+  return hlir::Value::empty();
 }
 /***********************
  *                     *
@@ -99,59 +245,45 @@ hlir::InstructionList ExpressionNode::to_hlir(hlir::Context &context) const {
  **********************/
 
 // TODO(IT) fill in
-hlir::InstructionList BuiltinNode::to_hlir(hlir::Context &context) const {
-  return hlir::InstructionList();
-}
+void BuiltinNode::to_hlir(hlir::Context &, hlir::Value) const {}
 
-hlir::InstructionList LiteralNode::to_hlir(hlir::Context &context) const {
+hlir::Value LiteralNode::value_in_place(const hlir::Context &context) const {
   Symbol literal_type = static_type.value();
-  auto instructions = hlir::InstructionList();
-
-  if (literal_type == context.symbols.int_type) {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::acc(literal_type),
-        hlir::Value::constant(int_eval(value, context.symbols), literal_type),
-        start_token));
-
-  } else if (literal_type == context.symbols.bool_type) {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::acc(literal_type),
-        hlir::Value::constant(bool_eval(value, context.symbols), literal_type),
-        start_token));
-
-  } else if (literal_type == context.symbols.bool_type) {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::acc(literal_type),
-        hlir::Value::constant(string_eval(value, context.symbols),
-                              literal_type),
-        start_token));
 
-  } else {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::acc(literal_type),
-        hlir::Value::constant(value, literal_type), start_token));
-  }
+  if (literal_type == context.symbols.int_type)
+    return hlir::Value::constant(int_eval(value, context.symbols),
+                                 literal_type);
 
-  return instructions;
-}
+  if (literal_type == context.symbols.bool_type)
+    return hlir::Value::constant(bool_eval(value, context.symbols),
+                                 literal_type);
 
-hlir::InstructionList VariableNode::to_hlir(hlir::Context &context) const {
-  auto instructions = hlir::InstructionList();
+  return hlir::Value::constant(value, literal_type);
+}
 
-  hlir::Value from = hlir::Value::attr(name, static_type.value());
+void LiteralNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  if (!dest.is_empty())
+    context.emit<hlir::Mov>(dest, value_in_place(context), start_token);
+}
 
+hlir::Value VariableNode::value_in_place(const hlir::Context &context) const {
   if (lifetime == Lifetime::ATTRIBUTE)
-    from.kind = hlir::ValueKind::ATTRIBUTE;
-  else if (lifetime == Lifetime::SELF)
-    from.kind = hlir::ValueKind::SELF;
-  else if (lifetime != Lifetime::LOCAL && lifetime != Lifetime::ARGUMENT)
-    fatal("INTERNAL: VariableNode has invalid lifetime. Expected ATTRIBUTE, "
-          "LOCAL, ARGUMENT or SELF.");
+    return context.attribute(name, static_type.value());
+  if (lifetime == Lifetime::SELF)
+    return hlir::Value::self(static_type.value());
+  if (lifetime == Lifetime::LOCAL || lifetime == Lifetime::ARGUMENT)
+    return hlir::Value::local(name, static_type.value());
+
+  fatal("INTERNAL: VariableNode has invalid lifetime. Expected ATTRIBUTE, "
+        "LOCAL, ARGUMENT or SELF.");
+  return hlir::Value::empty(); // fool linter
+}
 
-  instructions.push_back(std::make_unique<hlir::Mov>(
-      hlir::Value::acc(static_type.value()), from, start_token));
+void VariableNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  hlir::Value from = value_in_place(context);
 
-  return instructions;
+  if (!dest.is_empty() && dest != from)
+    context.emit<hlir::Mov>(dest, from, start_token);
 }
 
 /***********************
@@ -160,8 +292,8 @@ hlir::InstructionList VariableNode::to_hlir(hlir::Context &context) const {
  *                     *
  **********************/
 
-hlir::InstructionList UnaryOpNode::to_hlir(hlir::Context &context) const {
-  hlir::InstructionList instructions = child->to_hlir(context);
+void UnaryOpNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  hlir::Value operand = lower_operand(*child, true, true, context, start_token);
 
   hlir::Op hlir_op;
   Symbol result_type;
@@ -182,16 +314,14 @@ hlir::InstructionList UnaryOpNode::to_hlir(hlir::Context &context) const {
   default:
     fatal("INTERNAL: unsupported token type {} in UnaryOpNode when translating "
           "to hlir");
+    return; // fool linter
   }
 
-  instructions.push_back(std::make_unique<hlir::Unary>(
-      hlir_op, hlir::Value::acc(result_type),
-      hlir::Value::acc(child->static_type.value()), start_token));
-
-  return instructions;
+  context.emit<hlir::Unary>(hlir_op, sink(dest, result_type), operand,
+                            start_token);
 }
 
-hlir::InstructionList BinaryOpNode::to_hlir(hlir::Context &context) const {
+void BinaryOpNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
   hlir::Op hlir_op;
   Symbol result_type;
   if (op == context.symbols.add_op) {
@@ -219,91 +349,74 @@ hlir::InstructionList BinaryOpNode::to_hlir(hlir::Context &context) const {
     fatal(std::format(
         "INTERNAL: unsupported op {} in BinaryOpNode when translating to hlir.",
         context.symbols.get_string(op)));
+    return; // fool linter
   }
 
-  auto instructions = left->to_hlir(context);
-
-  hlir::Value left_temp = context.create_temporary(left->static_type.value());
-
-  instructions.push_back(std::make_unique<hlir::Mov>(
-      left_temp, hlir::Value::acc(left->static_type.value()), start_token));
+  hlir::Value left_operand = lower_operand(
+      *left, false, only_reads(*right, context), context, start_token);
+  hlir::Value right_operand =
+      lower_operand(*right, true, true, context, start_token);
 
-  instructions.splice(instructions.end(), right->to_hlir(context));
-
-  instructions.push_back(std::make_unique<hlir::Binary>(
-      hlir_op, hlir::Value::acc(result_type), left_temp,
-      hlir::Value::acc(right->static_type.value()), start_token));
-
-  return instructions;
+  context.emit<hlir::Binary>(hlir_op, sink(dest, result_type), left_operand,
+                             right_operand, start_token);
 }
 
-hlir::InstructionList NewNode::to_hlir(hlir::Context &context) const {
-  auto instructions = hlir::InstructionList();
-  instructions.push_back(
-      std::make_unique<hlir::New>(hlir::Op::NEW, hlir::Value::acc(created_type),
-                                  created_type, start_token));
-  return instructions;
+void NewNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  context.emit<hlir::New>(hlir::Op::NEW, sink(dest, created_type),
+                          created_type, start_token);
 }
 
-hlir::InstructionList AssignNode::to_hlir(hlir::Context &context) const {
-  auto instructions = expression->to_hlir(context);
-  Symbol type = expression->static_type.value();
-
-  hlir::Value dest = hlir::Value::attr(variable, static_type.value());
+void AssignNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  hlir::Value stored = hlir::Value::empty();
 
   if (lifetime == Lifetime::ATTRIBUTE)
-    dest.kind = hlir::ValueKind::ATTRIBUTE;
-  else if (lifetime != Lifetime::LOCAL)
+    stored = context.attribute(variable, static_type.value());
+  else if (lifetime == Lifetime::LOCAL)
+    stored = hlir::Value::local(variable, static_type.value());
+  else
     fatal("INTERNAL: AssignNode has invalid lifetime. Expected ATTRIBUTE or "
           "LOCAL.");
 
-  instructions.push_back(
-      std::make_unique<hlir::Mov>(dest, hlir::Value::acc(type), start_token));
+  lower_into(*expression, stored, context, start_token);
 
-  return instructions;
+  // Through acc, the value is still in acc as well
+  if (passing_destinations(context) && !dest.is_empty())
+    context.emit<hlir::Mov>(dest, stored, start_token);
 }
 
-hlir::InstructionList DispatchNode::to_hlir(hlir::Context &context) const {
-  auto instructions = hlir::InstructionList();
-  std::vector<hlir::Value> argument_temporaries;
-
-  for (const auto &argument : arguments) {
-    instructions.splice(instructions.end(), argument->to_hlir(context));
-
-    Symbol argument_type = argument->static_type.value();
-
-    hlir::Value temporary = context.create_temporary(argument_type);
-    argument_temporaries.push_back(temporary);
-
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        temporary, hlir::Value::acc(argument_type), start_token));
+void DispatchNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  // Arguments are evaluated before the target, so an argument is stable when
+  // everything after it only reads
+  std::vector<bool> stable(arguments.size(), true);
+  bool reads_follow = !target || only_reads(*target, context);
+  for (size_t i = arguments.size(); i-- > 0;) {
+    stable[i] = reads_follow;
+    reads_follow = reads_follow && only_reads(*arguments[i], context);
   }
 
-  Symbol target_type;
+  std::vector<hlir::Value> argument_values;
+  for (size_t i = 0; i < arguments.size(); i++)
+    argument_values.push_back(lower_operand(*arguments[i], false, stable[i],
+                                            context, start_token));
 
-  if (target) {
-    instructions.splice(instructions.end(), target->to_hlir(context));
-    target_type = target->static_type.value();
+  hlir::Value target_value = hlir::Value::empty();
 
-  } else {
-    instructions.push_back(std::make_unique<hlir::Mov>(
-        hlir::Value::acc(context.symbols.self_type),
-        hlir::Value::self(context.symbols.self_type), start_token));
-
-    target_type = context.symbols.self_type;
-  }
+  if (target) {
+    target_value = lower_operand(*target, true, true, context, start_token);
 
-  auto call = hlir::Call(hlir::Value::acc(static_type.value()),
-                         hlir::Value::acc(target_type), method, start_token);
+  } else if (passing_destinations(context)) {
+    target_value = hlir::Value::self(context.symbols.self_type);
 
-  // Add all the arguments before the call
-  for (const auto &temporary : argument_temporaries) {
-    call.add_arg(temporary);
+  } else {
+    target_value = hlir::Value::acc(context.symbols.self_type);
+    context.emit<hlir::Mov>(target_value,
+                            hlir::Value::self(context.symbols.self_type),
+                            start_token);
   }
 
-  instructions.push_back(std::make_unique<hlir::Call>(call));
-
-  return instructions;
+  context.emit<hlir::Call>(sink(dest, static_type.value()), target_value,
+                           method, argument_values, context.method.arena,
+                           start_token);
 }
 
 /***********************
@@ -312,123 +425,113 @@ hlir::InstructionList DispatchNode::to_hlir(hlir::Context &context) const {
  *                     *
  **********************/
 
-hlir::InstructionList BlockNode::to_hlir(hlir::Context &context) const {
-  auto instructions = hlir::InstructionList();
-  for (const auto &expression : expressions) {
-    instructions.splice(instructions.end(), expression->to_hlir(context));
+void BlockNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  for (size_t i = 0; i < expressions.size(); i++) {
+    const auto &expression = expressions[i];
+    hlir::Value value_dest =
+        i + 1 == expressions.size()
+            ? dest
+            : discarded(context, expression->static_type.value());
+    expression->to_hlir(context, value_dest);
   }
-  return instructions;
 }
 
-hlir::InstructionList IfNode::to_hlir(hlir::Context &context) const {
+void IfNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
   int else_label_idx = context.create_label_idx();
   int exit_label_idx = context.create_label_idx();
 
-  auto instructions = condition_expr->to_hlir(context);
+  hlir::Value condition =
+      lower_operand(*condition_expr, true, true, context, start_token);
 
   hlir::Position else_position = hlir::Position(else_label_idx);
   hlir::Position exit_position = hlir::Position(exit_label_idx);
 
   // Insert the jump to the else block
-  instructions.push_back(std::make_unique<hlir::Branch>(
-      hlir::BranchCondition::FALSE,
-      hlir::Value::acc(condition_expr->static_type.value()), else_position,
-      condition_expr->start_token));
+  context.emit<hlir::Branch>(hlir::BranchCondition::FALSE, condition,
+                             else_position, condition_expr->start_token);
 
   // Add the then part right after the check
-  instructions.splice(instructions.end(), then_expr->to_hlir(context));
+  then_expr->to_hlir(context, dest);
 
   // Add a jump to the exit after the then, skipping the else section
-  instructions.push_back(std::make_unique<hlir::Branch>(
+  context.emit<hlir::Branch>(
       hlir::BranchCondition::ALWAYS,
       hlir::Value::constant(true, context.symbols.bool_type), exit_position,
-      then_expr->start_token));
+      then_expr->start_token);
 
   // Now add the else label and body
-  instructions.push_back(std::make_unique<hlir::Label>(
-      else_label_idx, context.symbols.else_kw, else_expr->start_token));
+  context.emit<hlir::Label>(else_label_idx, context.symbols.else_kw,
+                            else_expr->start_token);
 
-  instructions.splice(instructions.end(), else_expr->to_hlir(context));
+  else_expr->to_hlir(context, dest);
 
   // Put an exit label right at the end
-  instructions.push_back(std::make_unique<hlir::Label>(
-      exit_label_idx, context.symbols.fi_kw, start_token));
-
-  return instructions;
+  context.emit<hlir::Label>(exit_label_idx, context.symbols.fi_kw,
+                            start_token);
 }
 
-hlir::InstructionList WhileNode::to_hlir(hlir::Context &context) const {
-  auto instructions = hlir::InstructionList();
-
+void WhileNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
   int condition_label_idx = context.create_label_idx();
   int exit_label_idx = context.create_label_idx();
 
   hlir::Position condition_position = hlir::Position(condition_label_idx);
   hlir::Position exit_position = hlir::Position(exit_label_idx);
 
-  instructions.push_back(std::make_unique<hlir::Label>(
-      condition_label_idx, context.symbols.loop_kw, start_token));
+  context.emit<hlir::Label>(condition_label_idx, context.symbols.loop_kw,
+                            start_token);
 
-  instructions.splice(instructions.end(), condition_expr->to_hlir(context));
+  hlir::Value condition =
+      lower_operand(*condition_expr, true, true, context, start_token);
 
   // Insert the branch after the condition evaluation
-  instructions.push_back(std::make_unique<hlir::Branch>(
-      hlir::BranchCondition::FALSE,
-      hlir::Value::acc(condition_expr->static_type.value()), exit_position,
-      body_expr->start_token));
+  context.emit<hlir::Branch>(hlir::BranchCondition::FALSE, condition,
+                             exit_position, body_expr->start_token);
 
   // Now put the while body right after that
-  instructions.splice(instructions.end(), body_expr->to_hlir(context));
+  body_expr->to_hlir(context,
+                     discarded(context, body_expr->static_type.value()));
 
   // At the end of the while, we unconditionally return to the
   // condition evaluation
-  instructions.push_back(std::make_unique<hlir::Branch>(
+  context.emit<hlir::Branch>(
       hlir::BranchCondition::ALWAYS,
       hlir::Value::constant(true, context.symbols.bool_type),
-      condition_position, body_expr->start_token));
+      condition_position, body_expr->start_token);
 
   // This is the exit from the while loop
-  instructions.push_back(std::make_unique<hlir::Label>(
-      exit_label_idx, context.symbols.pool_kw, start_token));
-
-  return instructions;
+  context.emit<hlir::Label>(exit_label_idx, context.symbols.pool_kw,
+                            start_token);
+
+  // A loop evaluates to void
+  if (passing_destinations(context) && !dest.is_empty())
+    context.emit<hlir::Mov>(
+        dest,
+        hlir::Value::constant(context.symbols.void_value, static_type.value()),
+        start_token);
 }
 
-hlir::InstructionList LetNode::to_hlir(hlir::Context &context) const {
-  auto instructions = hlir::InstructionList();
-
+void LetNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
   for (const auto &declaration : declarations) {
-    if (declaration->initializer.has_value()) {
-      instructions.splice(instructions.end(),
-                          declaration->initializer.value()->to_hlir(context));
-
-      instructions.push_back(std::make_unique<hlir::Mov>(
-          hlir::Value::local(declaration->object_id,
-                             declaration->declared_type),
-          hlir::Value::acc(declaration->declared_type),
-          declaration->start_token));
-
-    } else {
-      instructions.splice(
-          instructions.end(),
-          default_initialize(declaration->object_id, declaration->declared_type,
-                             context.symbols, declaration->start_token));
-    }
+    hlir::Value local = hlir::Value::local(declaration->object_id,
+                                           declaration->declared_type);
+
+    if (declaration->initializer.has_value())
+      lower_into(*declaration->initializer.value(), local, context,
+                 declaration->start_token);
+    else
+      default_initialize(local, context, declaration->start_token);
   }
 
-  instructions.splice(instructions.end(), body_expr->to_hlir(context));
-
-  return instructions;
+  body_expr->to_hlir(context, dest);
 }
 
-hlir::InstructionList CaseBranchNode::to_hlir(hlir::Context &context) const {
-  return body_expr->to_hlir(context);
+void CaseBranchNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  body_expr->to_hlir(context, dest);
 }
 
-hlir::InstructionList CaseNode::to_hlir(hlir::Context &context) const {
-  hlir::InstructionList instructions = eval_expr->to_hlir(context);
-
-  Symbol parent_type = eval_expr->static_type.value();
+void CaseNode::to_hlir(hlir::Context &context, hlir::Value dest) const {
+  hlir::Value evaluated =
+      lower_operand(*eval_expr, true, true, context, start_token);
 
   int case_loop_idx = context.create_label_idx();
   hlir::Position case_loop_position{case_loop_idx};
@@ -441,32 +544,29 @@ hlir::InstructionList CaseNode::to_hlir(hlir::Context &context) const {
 
   // Initial checks for case expression:
   // check if void (case_void error)
-  instructions.push_back(std::make_unique<hlir::Unary>(
-      hlir::Op::IS_VOID, bool_acc, hlir::Value::acc(parent_type), start_token));
+  context.emit<hlir::Unary>(hlir::Op::IS_VOID, bool_acc, evaluated,
+                            start_token);
 
-  instructions.push_back(
-      std::make_unique<hlir::Error>(hlir::BranchCondition::TRUE, bool_acc,
-                                    runtime::Error::CASE_VOID, start_token));
+  context.emit<hlir::Error>(hlir::BranchCondition::TRUE, bool_acc,
+                            runtime::Error::CASE_VOID, start_token);
 
   // get type of expression
-  instructions.push_back(std::make_unique<hlir::Unary>(
-      hlir::Op::TYPE_ID_OF, current_type, hlir::Value::acc(parent_type),
-      start_token));
+  context.emit<hlir::Unary>(hlir::Op::TYPE_ID_OF, current_type, evaluated,
+                            start_token);
 
   // set up label for superclass loop
-  instructions.push_back(std::make_unique<hlir::Label>(
-      case_loop_idx, context.symbols.case_kw, start_token));
+  context.emit<hlir::Label>(case_loop_idx, context.symbols.case_kw,
+                            start_token);
 
   // check if type is tree_root_type (case_unmatched error)
-  instructions.push_back(std::make_unique<hlir::Binary>(
+  context.emit<hlir::Binary>(
       hlir::Op::EQUAL, bool_acc, current_type,
       hlir::Value::constant(context.symbols.tree_root_type,
                             context.symbols.type_id_type),
-      start_token));
+      start_token);
 
-  instructions.push_back(std::make_unique<hlir::Error>(
-      hlir::BranchCondition::TRUE, bool_acc, runtime::Error::CASE_UNMATCHED,
-      start_token));
+  context.emit<hlir::Error>(hlir::BranchCondition::TRUE, bool_acc,
+                            runtime::Error::CASE_UNMATCHED, start_token);
 
   int exit_label_idx = context.create_label_idx();
   hlir::Position exit_position = hlir::Position(exit_label_idx);
@@ -478,47 +578,44 @@ hlir::InstructionList CaseNode::to_hlir(hlir::Context &context) const {
         hlir::Position(context.create_label_idx());
 
     // Check if type matches,
-    instructions.push_back(std::make_unique<hlir::Binary>(
+    context.emit<hlir::Binary>(
         hlir::Op::EQUAL, bool_acc, current_type,
         hlir::Value::constant(branch->declared_type,
                               context.symbols.type_id_type),
-        branch->start_token));
+        branch->start_token);
 
     // Jump to the branch if it does
-    instructions.push_back(std::make_unique<hlir::Branch>(
-        hlir::BranchCondition::TRUE,
-        hlir::Value::acc(context.symbols.bool_type), branch_label_position,
-        branch->start_token));
+    context.emit<hlir::Branch>(hlir::BranchCondition::TRUE,
+                               hlir::Value::acc(context.symbols.bool_type),
+                               branch_label_position, branch->start_token);
   }
 
   // If no checks matched, get superclass and start checks again
-  instructions.push_back(std::make_unique<hlir::Unary>(
-      hlir::Op::SUPERCLASS, current_type, current_type, start_token));
+  context.emit<hlir::Unary>(hlir::Op::SUPERCLASS, current_type, current_type,
+                            start_token);
 
-  instructions.push_back(std::make_unique<hlir::Branch>(
+  context.emit<hlir::Branch>(
       hlir::BranchCondition::ALWAYS,
       hlir::Value::constant(true, context.symbols.bool_type),
-      case_loop_position, start_token));
+      case_loop_position, start_token);
 
   // Now add the labels and bodies for all of the branches
   for (int i = 0; i < branches.size(); i++) {
     const auto &case_branch = branches[i];
 
-    instructions.push_back(std::make_unique<hlir::Label>(
-        base_branch_label_idx + i, case_branch->declared_type,
-        case_branch->start_token));
+    context.emit<hlir::Label>(base_branch_label_idx + i,
+                              case_branch->declared_type,
+                              case_branch->start_token);
 
-    instructions.splice(instructions.end(), case_branch->to_hlir(context));
+    case_branch->to_hlir(context, dest);
 
-    instructions.push_back(std::make_unique<hlir::Branch>(
+    context.emit<hlir::Branch>(
         hlir::BranchCondition::ALWAYS,
         hlir::Value::constant(true, context.symbols.bool_type), exit_position,
-        case_branch->start_token));
+        case_branch->start_token);
   }
 
   // finally, the exit label
-  instructions.push_back(std::make_unique<hlir::Label>(
-      exit_label_idx, context.symbols.esac_kw, start_token));
-
-  return instructions;
+  context.emit<hlir::Label>(exit_label_idx, context.symbols.esac_kw,
+                            start_token);
 }
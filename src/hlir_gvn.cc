@@ -0,0 +1,364 @@
+#include "hlir_gvn.h"
+#include "hlir_dominators.h"
+#include "statistic.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hlir {
+
+static Statistic redundant_computations("gvn", "redundant",
+                                        "redundant computations removed");
+static Statistic forwarded_copies("gvn", "copies", "copies removed");
+static Statistic trivial_phis("gvn", "phis",
+                              "phis whose arguments all agree removed");
+static Statistic redundant_loads("gvn", "loads",
+                                 "attribute loads replaced by known values");
+
+/***********************
+ *                     *
+ *     Expression      *
+ *                     *
+ **********************/
+
+/// A pure computation, by operation, result type and value numbers of its
+/// arguments
+struct Expression {
+  Op op;
+  Symbol type;
+  Value args[2];
+
+  bool operator==(const Expression &) const = default;
+};
+
+struct ExpressionHash {
+  size_t operator()(const Expression &expression) const {
+    size_t hash = size_t(expression.op);
+    hash = hash * 31 + size_t(expression.type.id);
+    hash = hash * 1000003 + std::hash<uint64_t>{}(expression.args[0].raw());
+    hash = hash * 1000003 + std::hash<uint64_t>{}(expression.args[1].raw());
+    return hash;
+  }
+};
+
+static bool numbered(Op op) {
+  switch (op) {
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MULT:
+  case Op::DIV:
+  case Op::EQUAL:
+  case Op::LESS_THAN:
+  case Op::LESS_EQUAL:
+  case Op::NEG:
+  case Op::NOT:
+  case Op::IS_VOID:
+  case Op::TYPE_ID_OF:
+  case Op::SUPERCLASS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool commutative(Op op) {
+  return op == Op::ADD || op == Op::MULT || op == Op::EQUAL;
+}
+
+// Constants keep their own type, everything else takes the type its reader
+// expects
+static Value retyped(Value value, Symbol type) {
+  return value.kind() == ValueKind::CONSTANT ? value : value.with_type(type);
+}
+
+/***********************
+ *                     *
+ *   ValueNumbering    *
+ *                     *
+ **********************/
+
+class ValueNumbering {
+private:
+  CFG &cfg;
+  const DominatorTree &dominators;
+
+  /// Value standing for each removed temporary, or empty
+  std::vector<Value> replacements;
+
+  std::unordered_map<Expression, Value, ExpressionHash> expressions;
+  std::vector<Expression> expression_log;
+
+  // Known contents of each attribute by byte offset. An entry only holds
+  // while memory is in the generation it was recorded in.
+  struct Known {
+    Value value;
+    uint32_t generation;
+  };
+  std::unordered_map<int, Known> attributes;
+  std::vector<std::pair<int, Known>> attribute_log;
+  uint32_t generation;
+  uint32_t last_generation;
+  std::vector<uint32_t> end_generations;
+
+  uint64_t redundant;
+  uint64_t copies;
+  uint64_t phis;
+  uint64_t loads;
+
+  Value leader(Value) const;
+  Value substitute(Value) const;
+  /// What an attribute is known to hold at this point, or an empty value
+  Value known_contents(Value attribute) const;
+  void replace(BlockIdx, Instruction *, Value);
+  void remember(Value attribute, Value);
+
+  void visit_phi(BlockIdx, Instruction *);
+  void visit_mov(BlockIdx, Instruction *);
+  void visit_computation(BlockIdx, Instruction *);
+  void visit_block(BlockIdx);
+
+public:
+  ValueNumbering(CFG &, const DominatorTree &);
+
+  /// Returns whether a computation, a phi or a load was removed
+  bool run();
+};
+
+ValueNumbering::ValueNumbering(CFG &c, const DominatorTree &d)
+    : cfg(c), dominators(d),
+      replacements(c.get_method().num_temporaries(), Value::empty()),
+      generation(0), last_generation(0), end_generations(c.size(), 0),
+      redundant(0), copies(0), phis(0), loads(0) {}
+
+Value ValueNumbering::leader(Value value) const {
+  while (value.kind() == ValueKind::TEMP &&
+         !replacements[value.num()].is_empty())
+    value = replacements[value.num()];
+  return value;
+}
+
+// The leader of an argument, keeping the static type the reader expects
+Value ValueNumbering::substitute(Value arg) const {
+  return retyped(leader(arg), arg.static_type());
+}
+
+Value ValueNumbering::known_contents(Value attribute) const {
+  auto known = attributes.find(attribute.offset());
+  if (known == attributes.end() || known->second.generation != generation)
+    return Value::empty();
+  return known->second.value;
+}
+
+void ValueNumbering::replace(BlockIdx block, Instruction *instruction,
+                             Value value) {
+  replacements[instruction->get_dest().num()] = value;
+  cfg.erase(block, instruction);
+}
+
+void ValueNumbering::remember(Value attribute, Value value) {
+  auto [known, inserted] =
+      attributes.try_emplace(attribute.offset(), Known{Value::empty(), 0});
+  attribute_log.push_back({attribute.offset(), known->second});
+  known->second = {value, generation};
+}
+
+void ValueNumbering::visit_phi(BlockIdx block, Instruction *phi) {
+  // Arguments from back edges may not be numbered yet, which only hides
+  // agreement
+  Value dest = phi->get_dest();
+  Value same = Value::empty();
+
+  for (Value arg : phi->args()) {
+    Value value = leader(arg);
+    if (value.kind() == ValueKind::TEMP && value.num() == dest.num())
+      continue;
+    if (!same.is_empty() && value != same)
+      return;
+    same = value;
+  }
+
+  if (!same.is_empty()) {
+    replace(block, phi, same);
+    phis++;
+  }
+}
+
+void ValueNumbering::visit_mov(BlockIdx block, Instruction *mov) {
+  Value dest = mov->get_dest();
+  Value source = mov->get_arg1();
+
+  if (dest.kind() == ValueKind::ATTRIBUTE) {
+    // Later loads see what was stored, unless it came from memory itself
+    bool plain = source.kind() != ValueKind::ATTRIBUTE &&
+                 source.kind() != ValueKind::ACC;
+    remember(dest, plain ? leader(source) : Value::empty());
+    return;
+  }
+
+  if (dest.kind() != ValueKind::TEMP)
+    return;
+
+  // Known contents were already substituted
+  if (source.kind() == ValueKind::ATTRIBUTE) {
+    remember(source, dest);
+    return;
+  }
+
+  if (source.kind() != ValueKind::ACC) {
+    replace(block, mov, leader(source));
+    copies++;
+  }
+}
+
+void ValueNumbering::visit_computation(BlockIdx block,
+                                       Instruction *instruction) {
+  Value dest = instruction->get_dest();
+  if (dest.kind() != ValueKind::TEMP)
+    return;
+
+  Expression expression{instruction->op, dest.static_type(),
+                        {Value::empty(), Value::empty()}};
+  std::span<Value> args = instruction->args();
+  for (size_t i = 0; i < args.size(); i++) {
+    // Reads of memory are only numbered through loads
+    if (args[i].kind() == ValueKind::ATTRIBUTE ||
+        args[i].kind() == ValueKind::ACC)
+      return;
+    expression.args[i] = leader(args[i]);
+  }
+
+  if (commutative(expression.op) &&
+      expression.args[1].raw() < expression.args[0].raw())
+    std::swap(expression.args[0], expression.args[1]);
+
+  auto [found, inserted] = expressions.try_emplace(expression, dest);
+  if (inserted) {
+    expression_log.push_back(expression);
+    return;
+  }
+
+  replace(block, instruction, found->second);
+  redundant++;
+}
+
+void ValueNumbering::visit_block(BlockIdx idx) {
+  BasicBlock &block = cfg.block(idx);
+
+  // Memory only carries over from the block that always runs right before
+  if (block.preds.size() == 1)
+    generation = end_generations[block.preds[0]];
+  else
+    generation = ++last_generation;
+
+  Instruction *instruction = block.first;
+  while (instruction != nullptr) {
+    Instruction *next =
+        instruction == block.last ? nullptr : instruction->get_next();
+
+    if (instruction->op == Op::PHI) {
+      visit_phi(idx, instruction);
+    } else {
+      for (Value &arg : instruction->args()) {
+        arg = substitute(arg);
+
+        Value known = arg.kind() == ValueKind::ATTRIBUTE ? known_contents(arg)
+                                                          : Value::empty();
+        if (!known.is_empty()) {
+          arg = retyped(known, arg.static_type());
+          loads++;
+        }
+      }
+
+      if (instruction->op == Op::MOV)
+        visit_mov(idx, instruction);
+      else if (instruction->op == Op::CALL || instruction->op == Op::NEW)
+        generation = ++last_generation;
+      else if (numbered(instruction->op))
+        visit_computation(idx, instruction);
+
+      // Only movs store a value later loads can use. Anything else writing
+      // an attribute, as lowering into destinations does, leaves it unknown.
+      if (instruction->op != Op::MOV && instruction->has_dest() &&
+          instruction->get_dest().kind() == ValueKind::ATTRIBUTE)
+        remember(instruction->get_dest(), Value::empty());
+    }
+
+    instruction = next;
+  }
+
+  end_generations[idx] = generation;
+}
+
+bool ValueNumbering::run() {
+  struct Frame {
+    BlockIdx block;
+    size_t next_child;
+    size_t expression_log_size;
+    size_t attribute_log_size;
+  };
+
+  std::vector<Frame> stack;
+  if (cfg.size() != 0)
+    stack.push_back({cfg.entry(), 0, 0, 0});
+
+  bool entering = true;
+  while (!stack.empty()) {
+    Frame &frame = stack.back();
+
+    if (entering) {
+      frame.expression_log_size = expression_log.size();
+      frame.attribute_log_size = attribute_log.size();
+      visit_block(frame.block);
+    }
+
+    const std::vector<BlockIdx> &children = dominators.children(frame.block);
+    if (frame.next_child < children.size()) {
+      BlockIdx child = children[frame.next_child++];
+      stack.push_back({child, 0, 0, 0});
+      entering = true;
+      continue;
+    }
+
+    while (expression_log.size() > frame.expression_log_size) {
+      expressions.erase(expression_log.back());
+      expression_log.pop_back();
+    }
+
+    while (attribute_log.size() > frame.attribute_log_size) {
+      attributes.at(attribute_log.back().first) = attribute_log.back().second;
+      attribute_log.pop_back();
+    }
+
+    stack.pop_back();
+    entering = false;
+  }
+
+  // Phis read over back edges, and their arguments may have been removed
+  // after them
+  for (BasicBlock &block : cfg.blocks())
+    for (Instruction *instruction : block)
+      for (Value &arg : instruction->args())
+        arg = substitute(arg);
+
+  redundant_computations.add(redundant);
+  forwarded_copies.add(copies);
+  trivial_phis.add(phis);
+  redundant_loads.add(loads);
+
+  return redundant > 0 || phis > 0 || loads > 0;
+}
+
+/***********************
+ *                     *
+ *         GVN         *
+ *                     *
+ **********************/
+
+bool number_values(CFG &cfg) { return number_values(cfg, DominatorTree(cfg)); }
+
+bool number_values(CFG &cfg, const DominatorTree &dominators) {
+  return ValueNumbering(cfg, dominators).run();
+}
+
+} // namespace hlir
@@ -1,7 +1,18 @@
 #include "hlir_optimizer.h"
+#include "constant_eval.h"
 #include "error.h"
+#include "hlir_cfg.h"
+#include "hlir_dataflow.h"
+#include "hlir_gvn.h"
+#include "hlir_sccp.h"
+#include "hlir_ssa.h"
 #include "optimizer_config.h"
+#include "statistic.h"
+#include "symbol_map.h"
+#include "time_report.h"
 #include <format>
+#include <optional>
+#include <unordered_map>
 
 namespace hlir {
 
@@ -11,22 +22,34 @@ namespace hlir {
  *                    *
  *********************/
 
-Pass::Pass(std::string n, PassScope ps) : name(n), pass_scope(ps) {}
+Pass::Pass(std::string n, PassScope ps, PreservedAnalyses p)
+    : name(n), pass_scope(ps), preserves(p) {}
 
-void Pass::run(hlir::Universe &universe, const OptimizerConfig &config) const {
+bool Pass::run(hlir::Universe &universe, AnalysisManager &analyses,
+               const OptimizerConfig &config,
+               const SymbolTable &symbols) const {
+  bool changed = false;
   for (auto &[_, cls] : universe.classes) {
-    run_class(cls, config);
+    TraceSpan span("class", symbols, cls.name);
+    changed |= run_class(cls, analyses, config, symbols);
   }
+  return changed;
 }
-void Pass::run_class(hlir::Class &cls, const OptimizerConfig &config) const {
-  run_method(cls.initializer, config);
+bool Pass::run_class(hlir::Class &cls, AnalysisManager &analyses,
+                     const OptimizerConfig &config,
+                     const SymbolTable &symbols) const {
+  bool changed = run_method(cls.initializer, analyses.of(cls.initializer),
+                            config, symbols);
   for (auto &[_, method] : cls.methods) {
-    run_method(method.instructions, config);
+    changed |= run_method(method, analyses.of(method), config, symbols);
   }
+  return changed;
 }
-void Pass::run_method(hlir::InstructionList &, const OptimizerConfig &) const {
+bool Pass::run_method(hlir::Method &, MethodAnalyses &,
+                      const OptimizerConfig &, const SymbolTable &) const {
   fatal(std::format("INTERNAL: trying to run undefined run_method in Pass {}",
                     name));
+  return false;
 }
 
 /**********************
@@ -41,87 +64,1058 @@ void Pass::run_method(hlir::InstructionList &, const OptimizerConfig &) const {
 //
 // Catches moves into acc that are only used once and immediately rewritten, or
 // never used at all.
+//
+// Erases straight from the instruction list, so it preserves no analysis.
 
 class UselessAccMov : public Pass {
 public:
   UselessAccMov() : Pass("useless_acc_mov", PassScope::Method) {}
-  void run_method(InstructionList &, const OptimizerConfig &) const override;
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
 };
 
-void UselessAccMov::run_method(hlir::InstructionList &instructions,
-                               const OptimizerConfig &config) const {
+bool UselessAccMov::run_method(hlir::Method &method, MethodAnalyses &,
+                               const OptimizerConfig &,
+                               const SymbolTable &) const {
+  hlir::InstructionList &instructions = method.instructions;
   auto instruction_it = instructions.begin();
+  bool changed = false;
 
   while (instruction_it != instructions.end()) {
-    hlir::Instruction *instruction = instruction_it->get();
+    hlir::Instruction *instruction = *instruction_it;
 
     // Start by matching sequences of MOV + mod acc. We'll skip everything else
     if (instruction->op != Op::MOV ||
-        instruction->get_dest().kind != ValueKind::ACC) {
+        instruction->get_dest().kind() != ValueKind::ACC) {
       instruction_it++;
       continue;
     }
 
-    hlir::Instruction *lookahead = std::next(instruction_it, 1)->get();
-    int lookahead_args = lookahead->num_args();
+    hlir::Instruction *lookahead = instruction->get_next();
+
+    // acc may be the value of the whole method, so keep the last mov
+    if (lookahead == nullptr)
+      break;
 
     if (!lookahead->has_dest() ||
-        lookahead->get_dest().kind != ValueKind::ACC) {
+        lookahead->get_dest().kind() != ValueKind::ACC) {
       instruction_it = std::next(instruction_it, 2);
       continue;
     }
 
-    // acc is reset immediately without using. Simply delete
-    if (lookahead_args == 0) {
-      instruction_it = instructions.erase(instruction_it);
-      continue;
+    // The lookahead overwrites acc, so the mov is only needed to feed its
+    // arguments. Read the moved value directly instead (if acc is not read at
+    // all, the mov was useless to begin with).
+    Value stored = instruction->get_arg1();
+
+    for (Value &arg : lookahead->args()) {
+      if (arg.kind() == ValueKind::ACC)
+        arg = stored;
     }
 
-    Value stored = instruction->get_arg1();
+    instruction_it = instructions.erase(instruction_it);
+    changed = true;
+  }
 
-    if (lookahead_args == 1 && lookahead->get_arg1().kind == ValueKind::ACC) {
-      Value &useless_acc_arg = lookahead->get_arg1();
+  return changed;
+};
 
-      instruction_it = instructions.erase(instruction_it);
-      useless_acc_arg = stored; // replace useless_acc_arg
+// DeadCodeElimination
+//
+// Removes instructions whose only effect is writing a variable that is never
+// read afterwards, as found by liveness. Each block is swept backwards so a
+// chain of dead computations goes in one sweep, and sweeps repeat until
+// nothing changes, since removing a read can make a write in another block
+// dead.
+//
+// Only instructions without other effects go: arithmetic, comparisons, movs,
+// division by a constant other than zero, and creating objects whose
+// initializers have no effects either. Writes to attributes are stores and
+// always stay.
+//
+// Liveness is only computed again after a sweep that removed something, and
+// the last one is still valid when the pass ends.
 
-      continue;
+static Statistic dead_instructions("dce", "removed",
+                                   "dead instructions removed");
+
+class DeadCodeElimination : public Pass {
+public:
+  DeadCodeElimination()
+      : Pass("dce", PassScope::Method,
+             {Analysis::CFG, Analysis::DOMINATORS, Analysis::LIVENESS}) {}
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
+};
+
+// Whether removing the instruction could change more than the variable it
+// writes. Classes missing from pure_classes are assumed to have effects.
+static bool has_side_effects(const Instruction *instruction,
+                             const SymbolMap<bool> &pure_classes) {
+  switch (instruction->op) {
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MULT:
+  case Op::EQUAL:
+  case Op::LESS_THAN:
+  case Op::LESS_EQUAL:
+  case Op::NEG:
+  case Op::NOT:
+  case Op::IS_VOID:
+  case Op::MOV:
+  case Op::SUPERCLASS:
+  case Op::PHI:
+    return false;
+
+  case Op::DIV: {
+    Value divisor = instruction->args()[1];
+    return divisor.kind() != ValueKind::CONSTANT || divisor.num() == 0;
+  }
+
+  case Op::NEW: {
+    const bool *pure = pure_classes.find(
+        static_cast<const New *>(instruction)->get_type());
+    return pure == nullptr || !*pure;
+  }
+
+  // TYPE_ID_OF reads through its argument, which may be void
+  default:
+    return true;
+  }
+}
+
+// Classes whose objects can be created and dropped without anyone noticing:
+// neither their initializer nor any inherited one calls a method, fails,
+// loops or creates an object that would be noticed. Built-in superclasses are
+// outside the universe and initialize to defaults, so they count as pure.
+//
+// Needs every class, so the PassManager finds them once before any pass runs
+// and hands them to dce through the analyses. Passes keep what the program
+// does, so a class found pure stays pure.
+static SymbolMap<bool> find_pure_classes(const Universe &universe) {
+  SymbolMap<bool> pure_classes;
+  // Classes each one depends on: its superclass and the ones it creates
+  SymbolMap<std::vector<Symbol>> dependencies;
+
+  for (const auto &[name, cls] : universe.classes) {
+    std::vector<Symbol> depends_on;
+    if (universe.classes.contains(cls.parent))
+      depends_on.push_back(cls.parent);
+
+    // Labels seen so far, to tell loops (branches back to one) apart
+    std::vector<bool> seen_labels(cls.initializer.num_labels(), false);
+    bool pure = true;
+
+    for (const Instruction *instruction : cls.initializer.instructions) {
+      if (instruction->op == Op::LABEL) {
+        seen_labels[static_cast<const Label *>(instruction)->get_idx()] = true;
+      } else if (instruction->op == Op::BRANCH) {
+        pure = !seen_labels[static_cast<const Branch *>(instruction)
+                                  ->get_target()
+                                  .label_idx];
+      } else if (instruction->op == Op::NEW) {
+        depends_on.push_back(static_cast<const New *>(instruction)->get_type());
+      } else {
+        pure = !has_side_effects(instruction, SymbolMap<bool>());
+      }
+
+      if (!pure)
+        break;
+    }
+
+    // Not pure until all its dependencies are, which leaves cycles impure
+    pure_classes.emplace(name, false);
+    if (pure)
+      dependencies.emplace(name, std::move(depends_on));
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (const auto &[name, depends_on] : dependencies) {
+      bool &pure = pure_classes.at(name);
+      if (pure)
+        continue;
+
+      pure = true;
+      for (Symbol dependency : depends_on) {
+        const bool *dependency_pure = pure_classes.find(dependency);
+        if (dependency_pure == nullptr || !*dependency_pure) {
+          pure = false;
+          break;
+        }
+      }
+      changed |= pure;
+    }
+  }
+
+  return pure_classes;
+}
+
+bool DeadCodeElimination::run_method(Method &, MethodAnalyses &analyses,
+                                     const OptimizerConfig &config,
+                                     const SymbolTable &) const {
+  const SymbolMap<bool> &pure_classes = analyses.pure_classes();
+  CFG &cfg = analyses.get<CFG>();
+  uint64_t removed = 0;
+  bool changed = true;
+
+  for (unsigned int sweep = 0;
+       changed && (config.dce_sweeps == 0 || sweep < config.dce_sweeps);
+       sweep++) {
+    changed = false;
+
+    const Liveness &liveness = analyses.get<Liveness>();
+    const VariableIndex &variables = liveness.variables();
+    BitSet live;
+
+    for (const BasicBlock &block : cfg.blocks()) {
+      live = liveness.live_out(block.idx);
+
+      Instruction *instruction = block.last;
+      while (instruction != nullptr) {
+        Instruction *previous =
+            instruction == block.first ? nullptr : instruction->get_prev();
+        int dest = instruction->has_dest()
+                       ? variables.of(instruction->get_dest())
+                       : -1;
+
+        if (dest != -1 && !live.test(dest) &&
+            !has_side_effects(instruction, pure_classes)) {
+          cfg.erase(block.idx, instruction);
+          removed++;
+          changed = true;
+        } else {
+          if (dest != -1)
+            live.reset(dest);
+
+          for (Value arg : instruction->args()) {
+            int id = variables.of(arg);
+            if (id != -1)
+              live.set(id);
+          }
+        }
+
+        instruction = previous;
+      }
+    }
+
+    if (changed)
+      analyses.invalidate(Analysis::LIVENESS);
+  }
+
+  dead_instructions.add(removed);
+  return removed > 0;
+}
+
+// ConstantFolding
+//
+// Computes arithmetic and comparisons on constants at compile time, and
+// forwards constants into the instructions reading them. Branches and errors
+// on a constant condition become unconditional or go away.
+//
+// A variable is constant where every write reaching it (ReachingDefinitions)
+// is a mov of the same constant and every path from the entry writes it, so
+// that arguments and other values coming from outside are never assumed.
+// Folding makes new constants and unreachable edges, so rounds repeat until
+// nothing changes. Reaching definitions are computed again after a round that
+// changed anything, and the CFG after one that resolved branches.
+//
+// Integers wrap around at 32 bits. Division by zero is left for runtime.
+
+static Statistic folded_instructions("constant_folding", "folded",
+                                     "instructions computed at compile time");
+static Statistic propagated_constants("constant_folding", "propagated",
+                                      "constants forwarded into arguments");
+static Statistic folded_branches("constant_folding", "branches",
+                                 "branches and errors on constants resolved");
+
+class ConstantFolding : public Pass {
+public:
+  ConstantFolding()
+      : Pass("constant_folding", PassScope::Method,
+             {Analysis::CFG, Analysis::DOMINATORS,
+              Analysis::REACHING_DEFINITIONS}) {}
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
+};
+
+// Variables written on every path from the entry to the end of each block
+class AssignedProblem : public GenKillProblem {
+public:
+  AssignedProblem(const CFG &cfg, const VariableIndex &variables)
+      : GenKillProblem(Direction::FORWARD, variables.size(), cfg.size()) {
+    for (const BasicBlock &block : cfg.blocks())
+      for (Instruction *instruction : block)
+        if (instruction->has_dest() &&
+            variables.of(instruction->get_dest()) != -1)
+          gen[block.idx].set(variables.of(instruction->get_dest()));
+  }
+
+  BitSet initial() const override {
+    BitSet all(num_bits);
+    all.fill();
+    return all;
+  }
+
+  void meet(BitSet &into, const BitSet &from) const override {
+    into.intersect_with(from);
+  }
+};
+
+// Result of an instruction whose arguments are all constants, or an empty
+// value if it cannot be computed at compile time
+static Value fold(Instruction *instruction) {
+  std::span<Value> args = instruction->args();
+  if (args.empty())
+    return Value::empty();
+
+  for (Value arg : args)
+    if (arg.kind() != ValueKind::CONSTANT)
+      return Value::empty();
+
+  return fold_constants(instruction->op, args,
+                        instruction->get_dest().static_type());
+}
+
+bool ConstantFolding::run_method(Method &method, MethodAnalyses &analyses,
+                                 const OptimizerConfig &config,
+                                 const SymbolTable &) const {
+  uint64_t folded = 0;
+  uint64_t propagated = 0;
+  uint64_t branches = 0;
+  bool changed = true;
+
+  for (unsigned int round = 0;
+       changed && (config.folding_rounds == 0 || round < config.folding_rounds);
+       round++) {
+    changed = false;
+
+    CFG &cfg = analyses.get<CFG>();
+    const ReachingDefinitions &reaching =
+        analyses.get<ReachingDefinitions>();
+    uint64_t changes = folded + propagated + branches;
+    const VariableIndex &variables = reaching.variables();
+    const std::vector<Instruction *> &definitions = reaching.definitions();
+    DataflowResult assigned =
+        solve_dataflow(cfg, AssignedProblem(cfg, variables));
+
+    // What each definition writes, and the constant when it is one
+    std::vector<int> written(definitions.size());
+    std::vector<Value> constants(definitions.size(), Value::empty());
+    for (size_t i = 0; i < definitions.size(); i++) {
+      Instruction *definition = definitions[i];
+      written[i] = variables.of(definition->get_dest());
+      if (definition->op == Op::MOV &&
+          definition->get_arg1().kind() == ValueKind::CONSTANT)
+        constants[i] = definition->get_arg1();
+    }
+
+    // Constant held by each variable at the current point, if any, and
+    // whether it became one in this round
+    std::vector<Value> known(variables.size(), Value::empty());
+    std::vector<bool> conflicting(variables.size(), false);
+    std::vector<bool> fresh(variables.size(), false);
+    std::vector<int> touched;
+    bool edges_changed = false;
+
+    for (const BasicBlock &block : cfg.blocks()) {
+      const BitSet &assigned_in = assigned.in[block.idx];
+      reaching.reaching_in(block.idx).for_each([&](size_t definition) {
+        int variable = written[definition];
+        if (!assigned_in.test(variable) || conflicting[variable])
+          return;
+
+        touched.push_back(variable);
+        Value constant = constants[definition];
+        if (constant.is_empty() ||
+            (!known[variable].is_empty() && known[variable] != constant)) {
+          known[variable] = Value::empty();
+          conflicting[variable] = true;
+        } else {
+          known[variable] = constant;
+        }
+      });
+
+      Instruction *instruction = block.first;
+      while (instruction != nullptr) {
+        Instruction *next =
+            instruction == block.last ? nullptr : instruction->get_next();
+        bool new_constant = false;
+
+        for (Value &arg : instruction->args()) {
+          int variable = variables.of(arg);
+          if (variable != -1 && !known[variable].is_empty()) {
+            arg = known[variable];
+            propagated++;
+            new_constant = instruction->op == Op::MOV;
+          }
+        }
+
+        bool conditional = (instruction->op == Op::BRANCH ||
+                            instruction->op == Op::ERROR) &&
+                           instruction->condition != BranchCondition::ALWAYS;
+
+        if (conditional &&
+            instruction->get_arg1().kind() == ValueKind::CONSTANT) {
+          Value condition = instruction->get_arg1();
+          bool taken = (instruction->condition == BranchCondition::TRUE) ==
+                       condition.boolean();
+
+          if (taken) {
+            instruction->condition = BranchCondition::ALWAYS;
+            instruction->get_arg1() =
+                Value::constant(true, condition.static_type());
+          } else {
+            cfg.erase(block.idx, instruction);
+          }
+
+          branches++;
+          edges_changed = true;
+        } else if (instruction->has_dest()) {
+          Value result = fold(instruction);
+
+          if (!result.is_empty()) {
+            Instruction *mov = method.create<Mov>(instruction->get_dest(),
+                                                  result, instruction->token);
+            cfg.insert(block.idx, instruction, mov);
+            cfg.erase(block.idx, instruction);
+            instruction = mov;
+
+            folded++;
+            new_constant = true;
+          }
+
+          int variable = variables.of(instruction->get_dest());
+          if (variable != -1) {
+            touched.push_back(variable);
+            conflicting[variable] = false;
+
+            bool constant = instruction->op == Op::MOV &&
+                            instruction->get_arg1().kind() ==
+                                ValueKind::CONSTANT;
+            known[variable] =
+                constant ? instruction->get_arg1() : Value::empty();
+            fresh[variable] = constant && new_constant;
+          }
+        }
+
+        instruction = next;
+      }
+
+      // Another round is only needed when new constants leave a block
+      for (int variable : touched) {
+        changed |= fresh[variable];
+        known[variable] = Value::empty();
+        conflicting[variable] = false;
+        fresh[variable] = false;
+      }
+      touched.clear();
+    }
+
+    // Resolved branches change the edges, and with them what reaches where
+    if (edges_changed) {
+      analyses.invalidate(Analysis::CFG);
+      changed = true;
+    } else if (folded + propagated + branches != changes) {
+      analyses.invalidate(Analysis::REACHING_DEFINITIONS);
+    }
+  }
+
+  folded_instructions.add(folded);
+  propagated_constants.add(propagated);
+  folded_branches.add(branches);
+  return folded + propagated + branches > 0;
+}
+
+// SparseConditionalConstantPropagation
+//
+// Runs propagate_constants (hlir_sccp.h) on the method in SSA form. Unlike
+// ConstantFolding it assumes nothing about edges until a branch can take
+// them, so it also finds constants that only hold because some path never
+// runs.
+//
+// Like GlobalValueNumbering, the method is put back as it was when there is
+// nothing to rewrite, so that a run finding nothing leaves no copies behind.
+
+class SparseConditionalConstantPropagation : public Pass {
+public:
+  SparseConditionalConstantPropagation()
+      : Pass("sccp", PassScope::Method, {Analysis::CFG}) {}
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
+};
+
+bool SparseConditionalConstantPropagation::run_method(
+    Method &method, MethodAnalyses &analyses, const OptimizerConfig &,
+    const SymbolTable &symbols) const {
+  SSASnapshot snapshot(method);
+  to_ssa(analyses, symbols);
+  CFG &cfg = analyses.get<CFG>();
+
+  if (!propagate_constants(cfg, symbols)) {
+    snapshot.restore();
+    cfg.rebuild();
+    analyses.invalidate(PreservedAnalyses{Analysis::CFG});
+    return false;
+  }
+
+  from_ssa(cfg);
+  return true;
+}
+
+// GlobalValueNumbering
+//
+// Runs number_values (hlir_gvn.h) on the method in SSA form, removing
+// computations and attribute loads that repeat ones dominating them. When
+// there are none the method is put back as it was, so that a run finding
+// nothing leaves no copies behind.
+
+class GlobalValueNumbering : public Pass {
+public:
+  GlobalValueNumbering()
+      : Pass("gvn", PassScope::Method, {Analysis::CFG, Analysis::DOMINATORS}) {}
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
+};
+
+bool GlobalValueNumbering::run_method(Method &method,
+                                      MethodAnalyses &analyses,
+                                      const OptimizerConfig &,
+                                      const SymbolTable &symbols) const {
+  SSASnapshot snapshot(method);
+  to_ssa(analyses, symbols);
+  CFG &cfg = analyses.get<CFG>();
+
+  if (!number_values(cfg, analyses.get<DominatorTree>())) {
+    snapshot.restore();
+    cfg.rebuild();
+    analyses.invalidate(PreservedAnalyses{Analysis::CFG});
+    return false;
+  }
+
+  from_ssa(cfg);
+  return true;
+}
+
+// CopyPropagation
+//
+// Replaces reads of the destination of a mov with its source wherever the
+// copy still holds: on every path to the read, the mov was the last write to
+// its destination and nothing wrote its source since. Chains of copies are
+// followed back to where they start. The movs themselves stay, for
+// DeadCodeElimination to remove once nothing reads them.
+//
+// Sources may be variables, constants or self. Loads from attributes are
+// left alone, so that reads GlobalValueNumbering shared stay shared.
+
+static Statistic propagated_copies("copy_propagation", "propagated",
+                                   "reads replaced by the source of a copy");
+
+class CopyPropagation : public Pass {
+public:
+  CopyPropagation()
+      : Pass("copy_propagation", PassScope::Method,
+             {Analysis::CFG, Analysis::DOMINATORS}) {}
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
+};
+
+// The distinct copies made in a method, each destination and source pair
+// numbered once so that the same copy on two paths into a join still holds
+class CopyIndex {
+private:
+  struct Key {
+    int dest;
+    uint64_t source;
+
+    bool operator==(const Key &) const = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return std::hash<uint64_t>{}(key.source) * 31 + size_t(key.dest);
+    }
+  };
+
+  const VariableIndex &variables;
+  std::unordered_map<Key, int, KeyHash> numbers;
+
+  // Source of the copy an instruction makes, or an empty value
+  Value source_of(const Instruction *, int &dest) const;
+
+public:
+  struct Copy {
+    int dest;
+    Value source;
+    // Variable id of the source, or -1
+    int source_variable;
+  };
+
+  std::vector<Copy> copies;
+  // Copies into or out of each variable
+  std::vector<std::vector<int>> involving;
+
+  CopyIndex(const CFG &, const VariableIndex &);
+
+  // The copy an instruction makes, or -1
+  int of(const Instruction *) const;
+};
+
+CopyIndex::CopyIndex(const CFG &cfg, const VariableIndex &v)
+    : variables(v), involving(v.size()) {
+  for (const BasicBlock &block : cfg.blocks()) {
+    for (Instruction *instruction : block) {
+      int dest;
+      Value source = source_of(instruction, dest);
+      if (source.is_empty())
+        continue;
+
+      auto [number, inserted] =
+          numbers.try_emplace({dest, source.raw()}, int(copies.size()));
+      if (!inserted)
+        continue;
+
+      int source_variable = variables.of(source);
+      copies.push_back({dest, source, source_variable});
+
+      involving[dest].push_back(number->second);
+      if (source_variable != -1)
+        involving[source_variable].push_back(number->second);
     }
+  }
+}
+
+Value CopyIndex::source_of(const Instruction *instruction, int &dest) const {
+  if (instruction->op != Op::MOV)
+    return Value::empty();
+
+  dest = variables.of(instruction->get_dest());
+  if (dest == -1)
+    return Value::empty();
+
+  Value source = instruction->args()[0];
+  int source_variable = variables.of(source);
+  if (source_variable != -1)
+    return source_variable == dest ? Value::empty()
+                                   : variables.value(source_variable);
+
+  switch (source.kind()) {
+  case ValueKind::CONSTANT:
+  case ValueKind::SELF:
+    return source;
+  default:
+    return Value::empty();
+  }
+}
+
+int CopyIndex::of(const Instruction *instruction) const {
+  int dest;
+  Value source = source_of(instruction, dest);
+  if (source.is_empty())
+    return -1;
+  return numbers.at({dest, source.raw()});
+}
+
+// Copies holding on every path from the entry to the end of each block
+class AvailableCopiesProblem : public GenKillProblem {
+public:
+  AvailableCopiesProblem(const CFG &cfg, const VariableIndex &variables,
+                         const CopyIndex &index)
+      : GenKillProblem(Direction::FORWARD, index.copies.size(), cfg.size()) {
+    // Last block seen writing each variable, to handle each one once per
+    // block
+    std::vector<BlockIdx> written(variables.size(), NO_BLOCK);
+
+    for (const BasicBlock &block : cfg.blocks()) {
+      // Backwards, so that a copy only leaves the block if nothing after it
+      // breaks it
+      Instruction *instruction = block.last;
+      while (instruction != nullptr) {
+        int copy = index.of(instruction);
+        if (copy != -1) {
+          const CopyIndex::Copy &made = index.copies[copy];
+          bool broken = written[made.dest] == block.idx ||
+                        (made.source_variable != -1 &&
+                         written[made.source_variable] == block.idx);
+          if (!broken)
+            gen[block.idx].set(copy);
+        }
 
-    if (lookahead_args == 2) {
-      Value &arg1 = lookahead->get_arg1();
-      Value &arg2 = lookahead->get_arg2();
-      if (arg1.kind == ValueKind::ACC)
-        arg1 = stored;
-      if (arg2.kind == ValueKind::ACC)
-        arg2 = stored;
+        int dest = instruction->has_dest()
+                       ? variables.of(instruction->get_dest())
+                       : -1;
+        if (dest != -1 && written[dest] != block.idx) {
+          written[dest] = block.idx;
+          for (int broken : index.involving[dest])
+            kill[block.idx].set(broken);
+        }
 
-      instruction_it = instructions.erase(instruction_it);
+        instruction =
+            instruction == block.first ? nullptr : instruction->get_prev();
+      }
     }
   }
+
+  BitSet initial() const override {
+    BitSet all(num_bits);
+    all.fill();
+    return all;
+  }
+
+  void meet(BitSet &into, const BitSet &from) const override {
+    into.intersect_with(from);
+  }
 };
 
+bool CopyPropagation::run_method(Method &method, MethodAnalyses &analyses,
+                                 const OptimizerConfig &,
+                                 const SymbolTable &) const {
+  CFG &cfg = analyses.get<CFG>();
+  VariableIndex variables(method);
+  CopyIndex index(cfg, variables);
+  if (index.copies.empty())
+    return false;
+
+  DataflowResult available =
+      solve_dataflow(cfg, AvailableCopiesProblem(cfg, variables, index));
+
+  // Within a block, what each variable is still a copy of. Writes bump
+  // versions rather than looking for the copies they break, and holdings are
+  // checked against them when read. A copy whose source was itself replaced
+  // holds what the source was replaced with.
+  struct Holding {
+    Value source;
+    int source_variable;
+    BlockIdx block;
+    uint32_t source_version;
+  };
+
+  std::vector<Holding> holding(variables.size(),
+                               {Value::empty(), -1, NO_BLOCK, 0});
+  std::vector<uint32_t> versions(variables.size(), 0);
+  uint64_t propagated = 0;
+
+  auto hold = [&](int dest, Value source, int source_variable,
+                  BlockIdx block) {
+    holding[dest] = {source, source_variable, block,
+                     source_variable == -1 ? 0 : versions[source_variable]};
+  };
+
+  auto source_held = [&](int variable, BlockIdx block) {
+    const Holding &held = holding[variable];
+    if (held.source.is_empty() || held.block != block ||
+        (held.source_variable != -1 &&
+         versions[held.source_variable] != held.source_version))
+      return Value::empty();
+    return held.source;
+  };
+
+  for (BasicBlock &block : cfg.blocks()) {
+    available.in[block.idx].for_each([&](size_t copy) {
+      const CopyIndex::Copy &made = index.copies[copy];
+      hold(made.dest, made.source, made.source_variable, block.idx);
+    });
+
+    for (Instruction *instruction : block) {
+      int copy = index.of(instruction);
+
+      for (Value &arg : instruction->args()) {
+        Value value = arg;
+        bool replaced = false;
+
+        for (int variable = variables.of(value); variable != -1;
+             variable = variables.of(value)) {
+          Value source = source_held(variable, block.idx);
+          if (source.is_empty())
+            break;
+          value = source;
+          replaced = true;
+        }
+
+        if (replaced) {
+          // Constants keep their own type, other values are read as the type
+          // the instruction expects
+          arg = value.kind() == ValueKind::CONSTANT
+                    ? value
+                    : value.with_type(arg.static_type());
+          propagated++;
+        }
+      }
+
+      int variable = instruction->has_dest()
+                         ? variables.of(instruction->get_dest())
+                         : -1;
+      if (variable != -1) {
+        versions[variable]++;
+        holding[variable].source = Value::empty();
+      }
+
+      if (copy != -1) {
+        Value source = instruction->args()[0];
+        int source_variable = variables.of(source);
+        if (source_variable != -1)
+          source = variables.value(source_variable);
+        if (source_variable != variable)
+          hold(variable, source, source_variable, block.idx);
+      }
+    }
+  }
+
+  propagated_copies.add(propagated);
+  return propagated > 0;
+}
+
+// FixedPointGroup
+//
+// Runs Method passes over a method in turn, round after round, until a whole
+// round changes nothing, so that what later passes expose is picked up by
+// earlier ones. Each method settles on its own: one that stops changing is
+// left alone while others keep going.
+//
+// Analyses are invalidated after each pass inside the group, so whatever is
+// left cached afterwards is still valid.
+
+static Statistic fixpoint_rounds("fixpoint", "rounds",
+                                 "rounds run by fixed-point groups");
+static Statistic fixpoint_capped("fixpoint", "capped",
+                                 "methods still changing at the round limit");
+
+class FixedPointGroup : public Pass {
+private:
+  std::vector<std::unique_ptr<Pass>> passes;
+
+public:
+  FixedPointGroup(std::string name, std::vector<std::unique_ptr<Pass>> p)
+      : Pass(name, PassScope::Method, PreservedAnalyses::all()),
+        passes(std::move(p)) {}
+  bool run_method(Method &, MethodAnalyses &, const OptimizerConfig &,
+                  const SymbolTable &) const override;
+};
+
+bool FixedPointGroup::run_method(Method &method, MethodAnalyses &analyses,
+                                 const OptimizerConfig &config,
+                                 const SymbolTable &symbols) const {
+  uint64_t rounds = 0;
+  bool changed = true;
+
+  while (changed) {
+    if (config.fixpoint_rounds != 0 && rounds == config.fixpoint_rounds) {
+      fixpoint_capped.add(1);
+      break;
+    }
+
+    changed = false;
+    for (const std::unique_ptr<Pass> &pass : passes) {
+      changed |= pass->run_method(method, analyses, config, symbols);
+      analyses.invalidate(pass->preserves);
+    }
+    rounds++;
+  }
+
+  fixpoint_rounds.add(rounds);
+  return rounds > 1 || changed;
+}
+
 /**********************
  *                    *
  *    PassManager     *
  *                    *
  *********************/
 
-PassManager::PassManager(hlir::Universe &u, const OptimizerConfig &oc)
-    : universe(u), config(oc), current_pass(0) {
-  // TODO(IT) consider OptimizerConfig for setting passes
-  pass_pipeline.push_back(std::make_unique<UselessAccMov>());
+std::vector<std::string> split_pipeline(const std::string &pipeline) {
+  std::vector<std::string> items;
+  size_t start = 0;
+  int depth = 0;
+
+  for (size_t i = 0; i <= pipeline.size(); i++) {
+    if (i < pipeline.size() && pipeline[i] != ',') {
+      depth += pipeline[i] == '(';
+      depth -= pipeline[i] == ')';
+      continue;
+    }
+    if (depth > 0 && i < pipeline.size())
+      continue;
+
+    if (i > start)
+      items.push_back(pipeline.substr(start, i - start));
+    start = i + 1;
+  }
+
+  return items;
+}
+
+std::unique_ptr<Pass> make_pass(const std::string &name) {
+  const std::string group_start = "fixpoint(";
+  if (name.starts_with(group_start) && name.ends_with(")")) {
+    std::vector<std::unique_ptr<Pass>> passes;
+    for (const std::string &member : split_pipeline(name.substr(
+             group_start.size(), name.size() - group_start.size() - 1))) {
+      std::unique_ptr<Pass> pass = make_pass(member);
+      if (pass == nullptr)
+        return nullptr;
+      if (pass->pass_scope != PassScope::Method)
+        fatal(std::format("Pass {} cannot go in {}, since it does not work "
+                          "on one method at a time",
+                          member, name));
+      passes.push_back(std::move(pass));
+    }
+
+    if (passes.empty())
+      return nullptr;
+    return std::make_unique<FixedPointGroup>(name, std::move(passes));
+  }
+
+  if (name == "useless_acc_mov")
+    return std::make_unique<UselessAccMov>();
+  if (name == "constant_folding")
+    return std::make_unique<ConstantFolding>();
+  if (name == "sccp")
+    return std::make_unique<SparseConditionalConstantPropagation>();
+  if (name == "gvn")
+    return std::make_unique<GlobalValueNumbering>();
+  if (name == "copy_propagation")
+    return std::make_unique<CopyPropagation>();
+  if (name == "dce")
+    return std::make_unique<DeadCodeElimination>();
+  return nullptr;
+}
+
+std::vector<std::string> default_pipeline(OptimizationLevel level) {
+  switch (level) {
+  case OptimizationLevel::O0:
+    return {};
+  case OptimizationLevel::O1:
+    return {"useless_acc_mov", "constant_folding", "copy_propagation", "dce"};
+  case OptimizationLevel::O2:
+    return {"useless_acc_mov", "constant_folding", "sccp",
+            "gvn",             "copy_propagation", "dce"};
+  case OptimizationLevel::O3:
+    return {"useless_acc_mov",
+            "fixpoint(constant_folding,copy_propagation)",
+            "dce",
+            "sccp",
+            "gvn",
+            "copy_propagation",
+            "dce"};
+  }
+  fatal("INTERNAL: unknown optimization level");
+  return {};
+}
+
+PassManager::PassManager(hlir::Universe &u, const OptimizerConfig &oc,
+                         const SymbolTable &s, ThreadPool *tp)
+    : universe(u), config(oc), symbols(s), pool(tp), current_pass(0) {
+  std::vector<std::string> names =
+      config.passes.empty() ? default_pipeline(config.level) : config.passes;
+
+  for (const std::string &name : names) {
+    std::unique_ptr<Pass> pass = make_pass(name);
+    if (pass == nullptr)
+      fatal(std::format("Unknown optimization pass {}", name));
+    pass_pipeline.push_back(std::move(pass));
+  }
+
+  analyses.set_pure_classes(find_pure_classes(universe));
 }
 
 bool PassManager::is_done() { return current_pass >= pass_pipeline.size(); }
 
+void PassManager::run_method_passes(int first, int last) {
+  // Looked up here, since only the calling thread may add methods
+  std::vector<MethodAnalyses *> methods;
+  std::vector<const Class *> classes;
+  for (auto &[_, cls] : universe.classes) {
+    methods.push_back(&analyses.of(cls.initializer));
+    classes.push_back(&cls);
+    for (auto &[_, method] : cls.methods) {
+      methods.push_back(&analyses.of(method));
+      classes.push_back(&cls);
+    }
+  }
+
+  auto run_passes = [&](size_t i) {
+    MethodAnalyses &method_analyses = *methods[i];
+    Method &method = method_analyses.get_method();
+    TraceSpan method_span("method", symbols, classes[i]->name, method.name);
+
+    for (int pass = first; pass < last; pass++) {
+      const Pass &to_run = *pass_pipeline[pass];
+      // A stage runs several passes on each method, which the span splits up
+      std::optional<TraceSpan> pass_span;
+      if (last - first > 1)
+        pass_span.emplace("pass", to_run.name);
+
+      to_run.run_method(method, method_analyses, config, symbols);
+      method_analyses.invalidate(to_run.preserves);
+    }
+  };
+
+  if (pool == nullptr) {
+    for (size_t i = 0; i < methods.size(); i++)
+      run_passes(i);
+    return;
+  }
+
+  std::vector<Diagnostics> diagnostics(methods.size());
+
+  pool->parallel_for(methods.size(), [&](size_t i) {
+    DiagnosticCapture capture(diagnostics[i]);
+
+    try {
+      run_passes(i);
+    } catch (const FatalDiagnostic &) {
+    }
+  });
+
+  for (const auto &method_diagnostics : diagnostics)
+    method_diagnostics.emit();
+}
+
 const hlir::Pass &PassManager::run_pass() {
   hlir::Pass *pass_to_run = pass_pipeline[current_pass].get();
-  pass_to_run->run(universe, config);
+  TraceSpan span("pass", pass_to_run->name);
+
+  if (pass_to_run->pass_scope == PassScope::Method) {
+    run_method_passes(current_pass, current_pass + 1);
+  } else {
+    pass_to_run->run(universe, analyses, config, symbols);
+    analyses.invalidate(pass_to_run->preserves);
+  }
 
   current_pass++;
+  analyses.report_statistics();
+  if (is_done())
+    analyses.clear();
 
   return *pass_to_run;
 }
 
+std::vector<const Pass *> PassManager::run_stage() {
+  int last = current_pass;
+  while (static_cast<size_t>(last) < pass_pipeline.size() &&
+         pass_pipeline[last]->pass_scope == PassScope::Method)
+    last++;
+
+  if (last == current_pass)
+    return {&run_pass()};
+
+  std::vector<const Pass *> stage;
+  std::string name;
+  for (int pass = current_pass; pass < last; pass++) {
+    stage.push_back(pass_pipeline[pass].get());
+    name += (name.empty() ? "" : "+") + pass_pipeline[pass]->name;
+  }
+  TraceSpan span("pass", name);
+
+  run_method_passes(current_pass, last);
+  current_pass = last;
+  analyses.report_statistics();
+  if (is_done())
+    analyses.clear();
+
+  return stage;
+}
+
 }; // namespace hlir
@@ -0,0 +1,486 @@
+#include "hlir_sccp.h"
+#include "constant_eval.h"
+#include "statistic.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace hlir {
+
+static Statistic constant_temporaries("sccp", "constants",
+                                      "temporaries found to be constants");
+static Statistic resolved_branches("sccp", "branches",
+                                   "branches on constants resolved");
+static Statistic dropped_blocks("sccp", "blocks",
+                                "blocks that can never run dropped");
+
+/***********************
+ *                     *
+ *     SCCPSolver      *
+ *                     *
+ **********************/
+
+/// Where a temporary stands: no write seen yet, always the same constant, or
+/// anything. Temporaries only ever move down this list.
+enum class Lattice : uint8_t {
+  UNDEFINED,
+  CONSTANT,
+  VARYING,
+};
+
+static bool foldable(Op op) {
+  switch (op) {
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MULT:
+  case Op::DIV:
+  case Op::NEG:
+  case Op::NOT:
+  case Op::EQUAL:
+  case Op::LESS_THAN:
+  case Op::LESS_EQUAL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+class SCCPSolver {
+private:
+  const CFG &cfg;
+
+  std::vector<Lattice> states;
+  std::vector<Value> constants;
+
+  std::vector<bool> executable_blocks;
+  // Whether each edge into a block was followed, in the order of its preds
+  std::vector<size_t> edge_offsets;
+  std::vector<bool> executable_edges;
+
+  // Instructions reading each temporary, with their blocks, grouped by
+  // temporary
+  std::vector<size_t> use_offsets;
+  std::vector<std::pair<Instruction *, BlockIdx>> uses;
+
+  std::vector<std::pair<BlockIdx, BlockIdx>> edge_worklist;
+  std::vector<int> temp_worklist;
+
+  std::pair<Lattice, Value> operand(Value) const;
+  void lower(int temp, Lattice, Value);
+
+  void visit(Instruction *, BlockIdx);
+  void visit_phi(Instruction *, BlockIdx);
+  void visit_branch(Instruction *, BlockIdx);
+  void visit_block(BlockIdx);
+  void visit_edge(BlockIdx from, BlockIdx to);
+
+public:
+  explicit SCCPSolver(const CFG &);
+
+  void solve();
+
+  bool executable(BlockIdx) const;
+  /// Whether the edge from the i-th predecessor of a block can be taken
+  bool executable_edge(BlockIdx, size_t pred) const;
+  /// The constant a value always holds, or an empty value
+  Value constant_of(Value) const;
+};
+
+SCCPSolver::SCCPSolver(const CFG &c)
+    : cfg(c), executable_blocks(c.size(), false),
+      edge_offsets(c.size() + 1, 0) {
+  for (const BasicBlock &block : cfg.blocks())
+    edge_offsets[block.idx + 1] = edge_offsets[block.idx] + block.preds.size();
+  executable_edges.assign(edge_offsets.back(), false);
+
+  // Count the readers of each temporary, then group them
+  std::vector<size_t> counts(cfg.get_method().num_temporaries(), 0);
+  std::vector<bool> written(counts.size(), false);
+
+  auto fit = [&](Value value) {
+    if (static_cast<size_t>(value.num()) >= counts.size()) {
+      counts.resize(value.num() + 1, 0);
+      written.resize(value.num() + 1, false);
+    }
+  };
+
+  for (const BasicBlock &block : cfg.blocks()) {
+    for (Instruction *instruction : block) {
+      if (instruction->has_dest() &&
+          instruction->get_dest().kind() == ValueKind::TEMP) {
+        fit(instruction->get_dest());
+        written[instruction->get_dest().num()] = true;
+      }
+
+      for (Value arg : instruction->args()) {
+        if (arg.kind() == ValueKind::TEMP) {
+          fit(arg);
+          counts[arg.num()]++;
+        }
+      }
+    }
+  }
+
+  use_offsets.assign(counts.size() + 1, 0);
+  for (size_t temp = 0; temp < counts.size(); temp++)
+    use_offsets[temp + 1] = use_offsets[temp] + counts[temp];
+
+  uses.resize(use_offsets.back());
+  std::vector<size_t> cursors(use_offsets.begin(), use_offsets.end() - 1);
+  for (const BasicBlock &block : cfg.blocks())
+    for (Instruction *instruction : block)
+      for (Value arg : instruction->args())
+        if (arg.kind() == ValueKind::TEMP)
+          uses[cursors[arg.num()]++] = {instruction, block.idx};
+
+  // Temporaries nothing writes come from outside, so could hold anything
+  states.resize(counts.size(), Lattice::UNDEFINED);
+  constants.resize(counts.size(), Value::empty());
+  for (size_t temp = 0; temp < counts.size(); temp++)
+    if (!written[temp])
+      states[temp] = Lattice::VARYING;
+}
+
+std::pair<Lattice, Value> SCCPSolver::operand(Value value) const {
+  if (value.kind() == ValueKind::CONSTANT)
+    return {Lattice::CONSTANT, value};
+
+  if (value.kind() == ValueKind::TEMP)
+    return {states[value.num()], constants[value.num()]};
+
+  // Arguments, attributes and self are not tracked
+  return {Lattice::VARYING, Value::empty()};
+}
+
+void SCCPSolver::lower(int temp, Lattice state, Value constant) {
+  if (state == Lattice::CONSTANT && states[temp] == Lattice::CONSTANT &&
+      constants[temp] != constant)
+    state = Lattice::VARYING;
+
+  if (state <= states[temp])
+    return;
+
+  states[temp] = state;
+  constants[temp] = state == Lattice::CONSTANT ? constant : Value::empty();
+  temp_worklist.push_back(temp);
+}
+
+void SCCPSolver::visit(Instruction *instruction, BlockIdx block) {
+  if (instruction->op == Op::PHI) {
+    visit_phi(instruction, block);
+    return;
+  }
+
+  if (instruction->op == Op::BRANCH) {
+    visit_branch(instruction, block);
+    return;
+  }
+
+  if (!instruction->has_dest() ||
+      instruction->get_dest().kind() != ValueKind::TEMP)
+    return;
+
+  int temp = instruction->get_dest().num();
+
+  if (instruction->op == Op::MOV) {
+    auto [state, constant] = operand(instruction->get_arg1());
+    lower(temp, state, constant);
+    return;
+  }
+
+  if (!foldable(instruction->op)) {
+    lower(temp, Lattice::VARYING, Value::empty());
+    return;
+  }
+
+  // Wait for undefined arguments, unless the result varies anyway
+  Value args[2] = {Value::empty(), Value::empty()};
+  bool undefined = false;
+  std::span<Value> instruction_args = instruction->args();
+
+  for (size_t i = 0; i < instruction_args.size(); i++) {
+    auto [state, constant] = operand(instruction_args[i]);
+    if (state == Lattice::VARYING) {
+      lower(temp, Lattice::VARYING, Value::empty());
+      return;
+    }
+
+    undefined |= state == Lattice::UNDEFINED;
+    args[i] = constant;
+  }
+
+  if (undefined)
+    return;
+
+  Value result =
+      fold_constants(instruction->op,
+                     std::span<const Value>(args, instruction_args.size()),
+                     instruction->get_dest().static_type());
+  lower(temp, result.is_empty() ? Lattice::VARYING : Lattice::CONSTANT,
+        result);
+}
+
+void SCCPSolver::visit_phi(Instruction *phi, BlockIdx block) {
+  if (phi->get_dest().kind() != ValueKind::TEMP)
+    return;
+
+  // Meet of the arguments coming over edges that can be taken
+  Lattice state = Lattice::UNDEFINED;
+  Value constant = Value::empty();
+  std::span<Value> args = phi->args();
+
+  for (size_t i = 0; i < args.size() && state != Lattice::VARYING; i++) {
+    if (!executable_edge(block, i))
+      continue;
+
+    auto [arg_state, arg_constant] = operand(args[i]);
+    if (arg_state == Lattice::UNDEFINED)
+      continue;
+
+    if (arg_state == Lattice::VARYING ||
+        (state == Lattice::CONSTANT && arg_constant != constant)) {
+      state = Lattice::VARYING;
+    } else {
+      state = Lattice::CONSTANT;
+      constant = arg_constant;
+    }
+  }
+
+  lower(phi->get_dest().num(), state, constant);
+}
+
+void SCCPSolver::visit_branch(Instruction *branch, BlockIdx block) {
+  BlockIdx target = cfg.block_of_label(
+      static_cast<Branch *>(branch)->get_target().label_idx);
+  BlockIdx fallthrough = cfg.block(block).fallthrough;
+
+  if (branch->condition == BranchCondition::ALWAYS) {
+    edge_worklist.push_back({block, target});
+    return;
+  }
+
+  auto [state, constant] = operand(branch->get_arg1());
+  if (state == Lattice::UNDEFINED)
+    return;
+
+  bool varying = state == Lattice::VARYING;
+  bool taken = !varying && (branch->condition == BranchCondition::TRUE) ==
+                               constant.boolean();
+
+  if (varying || taken)
+    edge_worklist.push_back({block, target});
+  if ((varying || !taken) && fallthrough != NO_BLOCK)
+    edge_worklist.push_back({block, fallthrough});
+}
+
+void SCCPSolver::visit_block(BlockIdx idx) {
+  const BasicBlock &block = cfg.block(idx);
+  executable_blocks[idx] = true;
+
+  for (Instruction *instruction : block)
+    visit(instruction, idx);
+
+  if (block.terminator() == nullptr && block.fallthrough != NO_BLOCK)
+    edge_worklist.push_back({idx, block.fallthrough});
+}
+
+void SCCPSolver::visit_edge(BlockIdx from, BlockIdx to) {
+  const std::vector<BlockIdx> &preds = cfg.block(to).preds;
+  size_t edge = edge_offsets[to] +
+                (std::find(preds.begin(), preds.end(), from) - preds.begin());
+
+  if (executable_edges[edge])
+    return;
+  executable_edges[edge] = true;
+
+  if (!executable_blocks[to]) {
+    visit_block(to);
+    return;
+  }
+
+  // Only the phis see the new edge
+  for (Instruction *instruction : cfg.block(to)) {
+    if (instruction->op == Op::PHI)
+      visit_phi(instruction, to);
+    else if (instruction->op != Op::LABEL)
+      break;
+  }
+}
+
+void SCCPSolver::solve() {
+  if (cfg.size() == 0)
+    return;
+
+  visit_block(cfg.entry());
+
+  while (!edge_worklist.empty() || !temp_worklist.empty()) {
+    if (!edge_worklist.empty()) {
+      auto [from, to] = edge_worklist.back();
+      edge_worklist.pop_back();
+      visit_edge(from, to);
+      continue;
+    }
+
+    int temp = temp_worklist.back();
+    temp_worklist.pop_back();
+
+    for (size_t use = use_offsets[temp]; use < use_offsets[temp + 1]; use++) {
+      auto [instruction, block] = uses[use];
+      if (executable_blocks[block])
+        visit(instruction, block);
+    }
+  }
+}
+
+bool SCCPSolver::executable(BlockIdx block) const {
+  return executable_blocks[block];
+}
+
+bool SCCPSolver::executable_edge(BlockIdx block, size_t pred) const {
+  return executable_edges[edge_offsets[block] + pred];
+}
+
+Value SCCPSolver::constant_of(Value value) const {
+  if (value.kind() != ValueKind::TEMP ||
+      static_cast<size_t>(value.num()) >= states.size() ||
+      states[value.num()] != Lattice::CONSTANT)
+    return Value::empty();
+  return constants[value.num()];
+}
+
+/***********************
+ *                     *
+ *        SCCP         *
+ *                     *
+ **********************/
+
+// Whether the block holds nothing but labels and maybe a jump, which
+// linearizing drops when it lands right before its target
+static bool only_labels_and_jump(const BasicBlock &block) {
+  for (Instruction *instruction : block)
+    if (instruction->op != Op::LABEL &&
+        (instruction != block.terminator() || instruction->op != Op::BRANCH ||
+         instruction->condition != BranchCondition::ALWAYS))
+      return false;
+  return true;
+}
+
+bool propagate_constants(CFG &cfg, const SymbolTable &symbols) {
+  SCCPSolver solver(cfg);
+  solver.solve();
+
+  Method &method = cfg.get_method();
+  uint64_t constants = 0;
+  uint64_t branches = 0;
+  uint64_t dropped = 0;
+  // Whether anything changed that leaving SSA form does not just put back:
+  // writes of constants go, but their phis become copies of them again, and
+  // so does the final mov into acc
+  bool rewritten = false;
+
+  for (BasicBlock &block : cfg.blocks()) {
+    // Dropped below, once the branches leading to it are gone
+    if (!solver.executable(block.idx)) {
+      dropped++;
+      continue;
+    }
+
+    Instruction *instruction = block.first;
+    while (instruction != nullptr) {
+      Instruction *next =
+          instruction == block.last ? nullptr : instruction->get_next();
+
+      bool constant_mov = instruction->op == Op::MOV &&
+                          instruction->get_arg1().kind() == ValueKind::CONSTANT;
+      bool copied_out = instruction->op == Op::PHI ||
+                        (instruction->op == Op::MOV &&
+                         instruction->get_dest().kind() == ValueKind::ACC);
+
+      for (Value &arg : instruction->args()) {
+        Value constant = solver.constant_of(arg);
+        if (!constant.is_empty()) {
+          arg = constant;
+          rewritten |= !copied_out;
+        }
+      }
+
+      bool conditional = (instruction->op == Op::BRANCH ||
+                          instruction->op == Op::ERROR) &&
+                         instruction->condition != BranchCondition::ALWAYS;
+
+      if (instruction->has_dest() &&
+          !solver.constant_of(instruction->get_dest()).is_empty()) {
+        // Only pure instructions can produce constants
+        cfg.erase(block.idx, instruction);
+        constants++;
+        rewritten |= !constant_mov;
+
+      } else if (instruction->op == Op::PHI) {
+        std::span<Value> args = instruction->args();
+        std::vector<Value> incoming;
+        for (size_t i = 0; i < args.size(); i++)
+          if (solver.executable_edge(block.idx, i))
+            incoming.push_back(args[i]);
+
+        if (incoming.size() != args.size()) {
+          Instruction *phi =
+              method.create<Phi>(instruction->get_dest(), incoming,
+                                 method.arena, instruction->token);
+          cfg.insert(block.idx, instruction, phi);
+          cfg.erase(block.idx, instruction);
+        }
+
+      } else if (conditional &&
+                 instruction->get_arg1().kind() == ValueKind::CONSTANT) {
+        Value condition = instruction->get_arg1();
+        bool taken = (instruction->condition == BranchCondition::TRUE) ==
+                     condition.boolean();
+
+        // Errors stay where they are when raised, so the code after them in
+        // the block keeps its place
+        if (!taken) {
+          cfg.erase(block.idx, instruction);
+          branches++;
+        } else if (instruction->op == Op::BRANCH) {
+          instruction->condition = BranchCondition::ALWAYS;
+          instruction->get_arg1() =
+              Value::constant(true, condition.static_type());
+          branches++;
+        }
+      }
+
+      instruction = next;
+    }
+  }
+
+  // Blocks keep their list order, so the preds of each block that stays are
+  // the ones whose edges were followed, in the order its phis expect. That
+  // needs every block that stays to survive rebuilding, which merges blocks
+  // left with only labels into the next one, and linearizing, which also
+  // drops jumps to the next block. Blocks that could end up empty get a dead
+  // mov.
+  if (branches > 0 || dropped > 0) {
+    for (BasicBlock &block : cfg.blocks())
+      if (solver.executable(block.idx) && only_labels_and_jump(block))
+        cfg.insert(block.idx, block.terminator(),
+                   method.create<Mov>(
+                       method.create_temporary(symbols.bool_type),
+                       Value::constant(true, symbols.bool_type), Token()));
+
+    cfg.rebuild();
+
+    std::vector<BlockIdx> order = cfg.reverse_postorder();
+    if (order.size() != cfg.size()) {
+      std::sort(order.begin(), order.end());
+      cfg.linearize(order, symbols);
+    }
+  }
+
+  constant_temporaries.add(constants);
+  resolved_branches.add(branches);
+  dropped_blocks.add(dropped);
+
+  return rewritten || branches > 0 || dropped > 0;
+}
+
+} // namespace hlir
@@ -0,0 +1,447 @@
+#include "hlir_ssa.h"
+#include "error.h"
+#include "hlir_dominators.h"
+#include <algorithm>
+#include <format>
+
+namespace hlir {
+
+/***********************
+ *                     *
+ *      SSA form       *
+ *                     *
+ **********************/
+
+/// Names renamed by SSA construction: acc, and every local and temporary the
+/// method writes, numbered densely
+class SSAVariables {
+private:
+  SmallSymbolMap<int> locals;
+  std::vector<int> temps;
+
+public:
+  static constexpr int ACC = 0;
+
+  /// Original value of each variable, as first written
+  std::vector<Value> values;
+
+  SSAVariables(const Method &method) : temps(method.num_temporaries(), -1) {
+    values.push_back(Value::acc(Symbol()));
+    bool acc_written = false;
+
+    for (Instruction *instruction : method.instructions) {
+      if (!instruction->has_dest())
+        continue;
+
+      Value dest = instruction->get_dest();
+      if (dest.kind() == ValueKind::ACC && !acc_written) {
+        values[ACC] = dest;
+        acc_written = true;
+      } else if (dest.kind() == ValueKind::LOCAL &&
+          locals.emplace(dest.symbol(), values.size()))
+        values.push_back(dest);
+      else if (dest.kind() == ValueKind::TEMP) {
+        if (static_cast<size_t>(dest.num()) >= temps.size())
+          temps.resize(dest.num() + 1, -1);
+
+        if (temps[dest.num()] == -1) {
+          temps[dest.num()] = values.size();
+          values.push_back(dest);
+        }
+      }
+    }
+  }
+
+  size_t size() const { return values.size(); }
+
+  /// Variable of a value, or -1 if it is not renamed
+  int of(Value value) const {
+    switch (value.kind()) {
+    case ValueKind::ACC:
+      return ACC;
+    case ValueKind::LOCAL: {
+      const int *variable = locals.find(value.symbol());
+      return variable == nullptr ? -1 : *variable;
+    }
+    case ValueKind::TEMP:
+      return static_cast<size_t>(value.num()) < temps.size()
+                 ? temps[value.num()]
+                 : -1;
+    default:
+      return -1;
+    }
+  }
+};
+
+struct PlacedPhi {
+  Instruction *phi;
+  int variable;
+};
+
+static bool is_returning(const BasicBlock &block) {
+  return block.terminator() == nullptr && block.fallthrough == NO_BLOCK;
+}
+
+/// First instruction of the block after its labels, or nullptr
+static Instruction *after_labels(const BasicBlock &block) {
+  for (Instruction *instruction : block)
+    if (instruction->op != Op::LABEL)
+      return instruction;
+  return nullptr;
+}
+
+static bool drop_unreachable_blocks(CFG &cfg, const SymbolTable &symbols) {
+  std::vector<BlockIdx> reachable = cfg.reverse_postorder();
+  if (reachable.size() == cfg.size())
+    return false;
+
+  // Keep the list order of the blocks, so that nothing else moves
+  std::vector<bool> keep(cfg.size(), false);
+  for (BlockIdx block : reachable)
+    keep[block] = true;
+
+  std::vector<BlockIdx> order;
+  for (size_t block = 0; block < cfg.size(); block++)
+    if (keep[block])
+      order.push_back(block);
+
+  cfg.linearize(order, symbols);
+  return true;
+}
+
+/// Makes sure no edge goes back to the entry, since a phi there would have no
+/// argument for entering the method. A method starting with a loop gets a
+/// jump to it as its new entry.
+static bool separate_entry(CFG &cfg, const SymbolTable &symbols) {
+  if (cfg.size() == 0 || cfg.block(cfg.entry()).preds.empty())
+    return false;
+
+  Method &method = cfg.get_method();
+  Instruction *first = method.instructions.front();
+
+  // Only branches reach the entry, so it starts with their label
+  int label_idx = static_cast<Label *>(first)->get_idx();
+  method.instructions.push_front(method.create<Branch>(
+      BranchCondition::ALWAYS, Value::constant(true, symbols.bool_type),
+      Position(label_idx), first->token));
+
+  cfg.rebuild();
+  return true;
+}
+
+/// Gets the CFG ready for renaming. Returns whether it changed shape.
+static bool prepare_ssa(CFG &cfg, const SymbolTable &symbols) {
+  Method &method = cfg.get_method();
+
+  for (Instruction *instruction : method.instructions)
+    if (instruction->op == Op::PHI)
+      fatal(std::format("INTERNAL: method {} is already in SSA form",
+                        symbols.get_string(method.name)));
+
+  bool dropped = drop_unreachable_blocks(cfg, symbols);
+  bool separated = separate_entry(cfg, symbols);
+  return dropped || separated;
+}
+
+static void rename_ssa(CFG &cfg, const DominatorTree &dominators) {
+  Method &method = cfg.get_method();
+  SSAVariables variables(method);
+
+  // Find where each variable is written, and which ones are read in a block
+  // before being written in it. Only those can need a phi. acc always does,
+  // because it is read when the method returns.
+  std::vector<std::pair<int, BlockIdx>> def_sites;
+  std::vector<int> writes(variables.size(), 0);
+  std::vector<bool> global(variables.size(), false);
+  global[SSAVariables::ACC] = true;
+
+  std::vector<BlockIdx> written_in(variables.size(), NO_BLOCK);
+
+  for (const BasicBlock &block : cfg.blocks()) {
+    for (Instruction *instruction : block) {
+      for (Value arg : instruction->args()) {
+        int variable = variables.of(arg);
+        if (variable != -1 && written_in[variable] != block.idx)
+          global[variable] = true;
+      }
+
+      if (!instruction->has_dest())
+        continue;
+
+      int variable = variables.of(instruction->get_dest());
+      if (variable == -1)
+        continue;
+
+      writes[variable]++;
+      if (written_in[variable] != block.idx) {
+        written_in[variable] = block.idx;
+        def_sites.push_back({variable, block.idx});
+      }
+    }
+  }
+
+  // Most temporaries are written once and only read right after, in the same
+  // block. They are already in SSA form, so only the rest is renamed.
+  std::vector<bool> renamed(variables.size());
+  for (size_t variable = 0; variable < variables.size(); variable++)
+    renamed[variable] = global[variable] || writes[variable] > 1 ||
+                        variables.values[variable].kind() != ValueKind::TEMP;
+
+  // Group the blocks writing each variable, without a vector per variable
+  std::vector<int> first_site(variables.size() + 1, 0);
+  for (auto [variable, _] : def_sites)
+    first_site[variable + 1]++;
+  for (size_t variable = 0; variable < variables.size(); variable++)
+    first_site[variable + 1] += first_site[variable];
+
+  std::vector<BlockIdx> def_blocks(def_sites.size());
+  std::vector<int> filled(first_site.begin(), first_site.end() - 1);
+  for (auto [variable, block] : def_sites)
+    def_blocks[filled[variable]++] = block;
+
+  // Place phis on the iterated dominance frontier of the writes
+  std::vector<std::vector<PlacedPhi>> phis(cfg.size());
+  std::vector<int> has_phi(cfg.size(), -1);
+  std::vector<int> queued(cfg.size(), -1);
+  std::vector<BlockIdx> worklist;
+
+  int variable_count = static_cast<int>(variables.size());
+  for (int variable = 0; variable < variable_count; variable++) {
+    if (!global[variable])
+      continue;
+
+    worklist.assign(def_blocks.begin() + first_site[variable],
+                    def_blocks.begin() + first_site[variable + 1]);
+    for (BlockIdx block : worklist)
+      queued[block] = variable;
+
+    while (!worklist.empty()) {
+      BlockIdx block = worklist.back();
+      worklist.pop_back();
+
+      for (BlockIdx join : dominators.frontier(block)) {
+        if (has_phi[join] == variable)
+          continue;
+        has_phi[join] = variable;
+
+        Value original = variables.values[variable];
+        std::vector<Value> incoming(cfg.block(join).preds.size(), original);
+        Instruction *phi = method.create<Phi>(original, incoming, method.arena,
+                                              Token());
+
+        cfg.insert(join, after_labels(cfg.block(join)), phi);
+        phis[join].push_back({phi, variable});
+
+        if (queued[join] != variable) {
+          queued[join] = variable;
+          worklist.push_back(join);
+        }
+      }
+    }
+  }
+
+  // Rename in a preorder walk of the dominator tree, keeping the temporary
+  // currently holding each variable (empty before the first write). The log
+  // records what each write replaced, so that leaving a block can undo it.
+  std::vector<Value> current(variables.size(), Value::empty());
+  std::vector<std::pair<int, Value>> log;
+
+  auto define = [&](Value &dest) {
+    int variable = variables.of(dest);
+    if (variable == -1 || !renamed[variable])
+      return;
+
+    log.push_back({variable, current[variable]});
+    dest = method.create_temporary(dest.static_type());
+    current[variable] = dest;
+  };
+
+  auto read = [&](Value &arg) {
+    int variable = variables.of(arg);
+    if (variable == -1 || current[variable].is_empty())
+      return;
+
+    arg = Value::temp(current[variable].num(), arg.static_type());
+  };
+
+  struct Frame {
+    BlockIdx block;
+    size_t next_child;
+    size_t log_size;
+  };
+
+  std::vector<Frame> stack;
+  if (cfg.size() != 0)
+    stack.push_back({cfg.entry(), 0, 0});
+
+  bool entering = true;
+  while (!stack.empty()) {
+    Frame &frame = stack.back();
+    BasicBlock &block = cfg.block(frame.block);
+
+    if (entering) {
+      frame.log_size = log.size();
+
+      for (Instruction *instruction : block) {
+        if (instruction->op != Op::PHI)
+          for (Value &arg : instruction->args())
+            read(arg);
+
+        if (instruction->has_dest())
+          define(instruction->get_dest());
+      }
+
+      if (is_returning(block) && !current[SSAVariables::ACC].is_empty()) {
+        Value result = current[SSAVariables::ACC];
+        cfg.insert(block.idx, nullptr,
+                   method.create<Mov>(Value::acc(result.static_type()), result,
+                                      block.last->token));
+      }
+
+      for (BlockIdx succ : block.succs) {
+        const std::vector<BlockIdx> &preds = cfg.block(succ).preds;
+        size_t incoming = std::find(preds.begin(), preds.end(), block.idx) -
+                          preds.begin();
+
+        for (const PlacedPhi &placed : phis[succ]) {
+          if (!current[placed.variable].is_empty())
+            placed.phi->args()[incoming] = current[placed.variable];
+        }
+      }
+    }
+
+    const std::vector<BlockIdx> &children = dominators.children(frame.block);
+    if (frame.next_child < children.size()) {
+      BlockIdx child = children[frame.next_child++];
+      stack.push_back({child, 0, 0});
+      entering = true;
+      continue;
+    }
+
+    while (log.size() > frame.log_size) {
+      current[log.back().first] = log.back().second;
+      log.pop_back();
+    }
+
+    stack.pop_back();
+    entering = false;
+  }
+}
+
+void to_ssa(CFG &cfg, const SymbolTable &symbols) {
+  prepare_ssa(cfg, symbols);
+  rename_ssa(cfg, DominatorTree(cfg));
+}
+
+void to_ssa(MethodAnalyses &analyses, const SymbolTable &symbols) {
+  CFG &cfg = analyses.get<CFG>();
+  if (prepare_ssa(cfg, symbols))
+    analyses.invalidate(PreservedAnalyses{Analysis::CFG});
+
+  rename_ssa(cfg, analyses.get<DominatorTree>());
+  // Renaming only adds and rewrites instructions inside blocks
+  analyses.invalidate(PreservedAnalyses{Analysis::CFG, Analysis::DOMINATORS});
+}
+
+void from_ssa(CFG &cfg) {
+  Method &method = cfg.get_method();
+
+  for (BasicBlock &block : cfg.blocks()) {
+    Instruction *instruction = after_labels(block);
+
+    while (instruction != nullptr && instruction->op == Op::PHI) {
+      Instruction *phi = instruction;
+      instruction = phi == block.last ? nullptr : phi->get_next();
+
+      Value dest = phi->get_dest();
+      Value incoming = method.create_temporary(dest.static_type());
+
+      for (size_t i = 0; i < block.preds.size(); i++) {
+        BasicBlock &pred = cfg.block(block.preds[i]);
+        cfg.insert(pred.idx, pred.terminator(),
+                   method.create<Mov>(incoming, phi->args()[i], phi->token));
+      }
+
+      cfg.insert(block.idx, phi, method.create<Mov>(dest, incoming, phi->token));
+      cfg.erase(block.idx, phi);
+    }
+  }
+}
+
+SSASnapshot::SSASnapshot(Method &m) : method(m) {
+  instructions.reserve(method.instructions.size());
+  conditions.reserve(method.instructions.size());
+
+  for (Instruction *instruction : method.instructions) {
+    instructions.push_back(instruction);
+    conditions.push_back(instruction->condition);
+    if (instruction->has_dest())
+      operands.push_back(instruction->get_dest());
+    for (Value arg : instruction->args())
+      operands.push_back(arg);
+  }
+}
+
+void SSASnapshot::restore() {
+  method.instructions = InstructionList();
+  size_t operand = 0;
+
+  for (size_t i = 0; i < instructions.size(); i++) {
+    Instruction *instruction = instructions[i];
+    method.instructions.push_back(instruction);
+
+    instruction->condition = conditions[i];
+    if (instruction->has_dest())
+      instruction->get_dest() = operands[operand++];
+    for (Value &arg : instruction->args())
+      arg = operands[operand++];
+  }
+}
+
+/***********************
+ *                     *
+ *       DefUse        *
+ *                     *
+ **********************/
+
+DefUse::DefUse(const Method &method)
+    : defs(method.num_temporaries(), nullptr),
+      uses_(method.num_temporaries()) {
+  for (Instruction *instruction : method.instructions) {
+    for (Value arg : instruction->args()) {
+      if (arg.kind() != ValueKind::TEMP)
+        continue;
+
+      if (static_cast<size_t>(arg.num()) >= uses_.size())
+        uses_.resize(arg.num() + 1);
+
+      std::vector<Instruction *> &readers = uses_[arg.num()];
+      if (readers.empty() || readers.back() != instruction)
+        readers.push_back(instruction);
+    }
+
+    if (instruction->has_dest() &&
+        instruction->get_dest().kind() == ValueKind::TEMP) {
+      int temp = instruction->get_dest().num();
+      if (static_cast<size_t>(temp) >= defs.size())
+        defs.resize(temp + 1, nullptr);
+
+      defs[temp] = instruction;
+    }
+  }
+
+  // Both are indexed by every temporary seen
+  defs.resize(std::max(defs.size(), uses_.size()), nullptr);
+  uses_.resize(defs.size());
+}
+
+Instruction *DefUse::def(int temp) const {
+  return static_cast<size_t>(temp) < defs.size() ? defs[temp] : nullptr;
+}
+
+const std::vector<Instruction *> &DefUse::uses(int temp) const {
+  static const std::vector<Instruction *> NO_USES;
+  return static_cast<size_t>(temp) < uses_.size() ? uses_[temp] : NO_USES;
+}
+
+} // namespace hlir
@@ -0,0 +1,206 @@
+#include "error.h"
+#include "semantic.h"
+#include "thread_pool.h"
+#include <format>
+#include <functional>
+#include <sstream>
+
+/***********************
+ *                     *
+ *       Helpers       *
+ *                     *
+ **********************/
+
+static size_t hash_combine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+/***********************
+ *                     *
+ * IncrementalAnalysis *
+ *                     *
+ **********************/
+
+IncrementalAnalysis::IncrementalAnalysis(SymbolTable &st) : symbols(st) {}
+
+ModuleNode *IncrementalAnalysis::get_module() const { return module.get(); }
+
+const ClassTree &IncrementalAnalysis::get_class_tree() const {
+  return *class_tree;
+}
+
+const std::vector<Symbol> &IncrementalAnalysis::rechecked() const {
+  return rechecked_;
+}
+
+size_t IncrementalAnalysis::body_hash(ClassNode *class_node) const {
+  // The printed AST has everything but token positions, which is exactly
+  // what we want: moving a class around in the file is not an edit to it.
+  std::ostringstream printed;
+  Printer printer{0, &printed};
+  class_node->print(printer, symbols);
+
+  return std::hash<std::string>{}(printed.str());
+}
+
+std::unordered_map<int, size_t>
+IncrementalAnalysis::signature_hashes(ModuleNode *new_module) const {
+  std::unordered_map<int, ClassNode *> class_nodes;
+  for (const auto &class_node : new_module->classes)
+    class_nodes[class_node->name.id] = class_node.get();
+
+  std::unordered_map<int, size_t> hashes;
+
+  // Builtin classes never change, so their name is enough
+  for (Symbol builtin : {symbols.object_type, symbols.io_type,
+                         symbols.int_type, symbols.string_type,
+                         symbols.bool_type})
+    hashes[builtin.id] = std::hash<int>{}(builtin.id);
+
+  // A class signature includes the signatures of its whole superclass chain
+  std::function<size_t(Symbol)> signature = [&](Symbol name) -> size_t {
+    if (hashes.find(name.id) != hashes.end())
+      return hashes[name.id];
+
+    // Placeholder to stop on cyclic hierarchies. Those never get past the
+    // ClassTree, so the resulting hashes are never used.
+    hashes[name.id] = 0;
+
+    size_t hash = std::hash<int>{}(name.id);
+
+    if (class_nodes.find(name.id) != class_nodes.end()) {
+      ClassNode *class_node = class_nodes[name.id];
+
+      hash = hash_combine(hash, signature(class_node->superclass));
+
+      for (const auto &attribute : class_node->attributes) {
+        hash = hash_combine(hash, attribute->object_id.id);
+        hash = hash_combine(hash, attribute->declared_type.id);
+      }
+
+      for (const auto &method : class_node->methods) {
+        hash = hash_combine(hash, method->name.id);
+        hash = hash_combine(hash, method->return_type.id);
+
+        for (const auto &param : method->parameters)
+          hash = hash_combine(hash, param->declared_type.id);
+      }
+    }
+
+    hashes[name.id] = hash;
+    return hash;
+  };
+
+  for (const auto &class_node : new_module->classes)
+    signature(class_node->name);
+
+  return hashes;
+}
+
+bool IncrementalAnalysis::analyze(std::unique_ptr<ModuleNode> new_module,
+                                  ThreadPool *pool) {
+  std::unordered_map<int, size_t> signatures =
+      signature_hashes(new_module.get());
+
+  auto signature_of = [&](int class_id) -> std::optional<size_t> {
+    if (signatures.find(class_id) == signatures.end())
+      return std::nullopt;
+    return signatures[class_id];
+  };
+
+  std::unordered_map<int, std::unique_ptr<ClassNode> *> previous_nodes;
+  if (module)
+    for (auto &class_node : module->classes)
+      previous_nodes[class_node->name.id] = &class_node;
+
+  std::vector<size_t> body_hashes;
+  std::vector<size_t> to_check;
+
+  for (size_t i = 0; i < new_module->classes.size(); i++) {
+    auto &class_node = new_module->classes[i];
+    int class_id = class_node->name.id;
+
+    body_hashes.push_back(body_hash(class_node.get()));
+
+    bool clean = records.find(class_id) != records.end() &&
+                 previous_nodes.find(class_id) != previous_nodes.end() &&
+                 records[class_id].check &&
+                 records[class_id].body_hash == body_hashes[i];
+
+    if (clean) {
+      for (const auto &[dependency, hash] : records[class_id].dependencies) {
+        std::optional<size_t> current = signature_of(dependency);
+        if (!current.has_value() || current.value() != hash) {
+          clean = false;
+          break;
+        }
+      }
+    }
+
+    if (clean)
+      class_node = std::move(*previous_nodes[class_id]);
+    else
+      to_check.push_back(i);
+  }
+
+  module = std::move(new_module);
+  class_tree = std::make_unique<ClassTree>(module.get(), symbols);
+
+  std::vector<std::unordered_set<int>> dependencies(to_check.size());
+  std::vector<Diagnostics> diagnostics(to_check.size());
+  std::vector<char> checks(to_check.size(), false);
+
+  auto check_class = [&](size_t i) {
+    DiagnosticCapture capture(diagnostics[i]);
+
+    ClassNode *class_node = module->classes[to_check[i]].get();
+
+    Scopes scopes = Scopes();
+    TypeContext context =
+        TypeContext(scopes, class_node->name, *class_tree, symbols);
+    context.dependencies = &dependencies[i];
+
+    try {
+      checks[i] = class_node->typecheck(context);
+    } catch (const FatalDiagnostic &) {
+      checks[i] = false;
+    }
+  };
+
+  if (pool != nullptr)
+    pool->parallel_for(to_check.size(), check_class);
+  else
+    for (size_t i = 0; i < to_check.size(); i++)
+      check_class(i);
+
+  // Forget classes that are gone. Untouched classes keep their records.
+  std::unordered_map<int, ClassRecord> new_records;
+  for (const auto &class_node : module->classes) {
+    int class_id = class_node->name.id;
+    if (records.find(class_id) != records.end())
+      new_records[class_id] = std::move(records[class_id]);
+  }
+  records = std::move(new_records);
+
+  // Classes we did not check typechecked fine last time
+  bool check = true;
+  rechecked_.clear();
+
+  for (size_t i = 0; i < to_check.size(); i++) {
+    diagnostics[i].emit();
+
+    ClassNode *class_node = module->classes[to_check[i]].get();
+    rechecked_.push_back(class_node->name);
+
+    ClassRecord record = {.body_hash = body_hashes[to_check[i]],
+                          .check = checks[i] != 0,
+                          .dependencies = {}};
+    for (int dependency : dependencies[i])
+      record.dependencies[dependency] = signature_of(dependency).value_or(0);
+
+    records[class_node->name.id] = std::move(record);
+    check = checks[i] && check;
+  }
+
+  return check;
+}
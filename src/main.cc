@@ -1,7 +1,9 @@
+#include <charconv>
 #include <format>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <string>
 
 #include "ast.h"
@@ -11,7 +13,10 @@
 #include "optimizer_config.h"
 #include "parser.h"
 #include "semantic.h"
+#include "statistic.h"
 #include "symbol.h"
+#include "thread_pool.h"
+#include "time_report.h"
 #include "token.h"
 #include "tokenizer.h"
 
@@ -23,11 +28,38 @@
 
 const std::filesystem::path debug_dir_base = "./coolc-debug";
 
+/// Most threads -j can ask for
+const unsigned int max_jobs = 256;
+
+/// Value of a numeric command line option, which must be a whole number no
+/// larger than max. Exits with a diagnostic otherwise.
+unsigned int parse_option_number(const std::string &option,
+                                 const std::string &value,
+                                 unsigned int max =
+                                     std::numeric_limits<unsigned int>::max()) {
+  unsigned int number = 0;
+  const char *end = value.data() + value.size();
+  auto [parsed_end, error] = std::from_chars(value.data(), end, number);
+
+  if (value.empty() || error != std::errc() || parsed_end != end ||
+      number > max) {
+    fatal(std::format("Invalid value '{}' for {}: expected a whole number "
+                      "from 0 to {}",
+                      value, option, max));
+    return 0;
+  }
+
+  return number;
+}
+
 struct CliOptions {
   bool debug_output;
   std::filesystem::path debug_dir;
   bool verbose;
   unsigned int indent;
+  hlir::Lowering lowering;
+  /// Records every phase, whether or not a report was asked for
+  TimeReport *time_report;
 };
 
 /**********************
@@ -38,7 +70,11 @@ struct CliOptions {
 
 TokenStream run_tokenizer(std::istream *input, SymbolTable &symbols,
                           const CliOptions &options, int &steps) {
+  TraceSpan span("phase", "tokenize");
+
+  options.time_report->start();
   TokenStream tokens = tokenize(input, symbols);
+  options.time_report->stop("phase", "tokenize");
 
   std::ostream *output = nullptr;
   std::fstream out_file;
@@ -95,9 +131,12 @@ TokenStream run_tokenizer(std::istream *input, SymbolTable &symbols,
 std::unique_ptr<ModuleNode> run_parser(TokenStream &tokens,
                                        const SymbolTable &symbols,
                                        const CliOptions &options, int &steps) {
+  TraceSpan span("phase", "parse");
 
   Parser parser = Parser(tokens, symbols);
+  options.time_report->start();
   std::unique_ptr<ModuleNode> node = parser.parse();
+  options.time_report->stop("phase", "parse");
 
   std::ostream *output = nullptr;
   std::fstream out_file;
@@ -130,12 +169,23 @@ std::unique_ptr<ModuleNode> run_parser(TokenStream &tokens,
 
 std::unique_ptr<ClassTree>
 run_semantic_analysis(ModuleNode *module, Scopes &scopes, SymbolTable &symbols,
-                      const CliOptions &options, int &steps) {
+                      ThreadPool *pool, const CliOptions &options, int &steps) {
+  TraceSpan span("phase", "semantic");
+
+  options.time_report->start();
+
   std::unique_ptr<ClassTree> class_tree =
       std::make_unique<ClassTree>(module, symbols);
 
   TypeContext context = TypeContext(scopes, Symbol{}, *class_tree, symbols);
-  bool check = module->typecheck(context);
+
+  bool check;
+  if (pool != nullptr)
+    check = module->typecheck(context, *pool);
+  else
+    check = module->typecheck(context);
+
+  options.time_report->stop("phase", "semantic");
 
   std::ostream *tree_output = nullptr;
   std::fstream tree_file;
@@ -183,9 +233,22 @@ run_semantic_analysis(ModuleNode *module, Scopes &scopes, SymbolTable &symbols,
  *                    *
  *********************/
 
-hlir::Universe run_hlir_generation(ModuleNode *module, SymbolTable &symbols,
+hlir::Universe run_hlir_generation(ModuleNode *module,
+                                   const ClassTree &class_tree,
+                                   SymbolTable &symbols, ThreadPool *pool,
                                    const CliOptions &options, int &steps) {
-  hlir::Universe universe = module->to_hlir_universe(symbols);
+  TraceSpan span("phase", "hlir_generation");
+
+  options.time_report->start();
+
+  hlir::Universe universe;
+  if (pool != nullptr)
+    universe = module->to_hlir_universe(symbols, class_tree, *pool,
+                                        options.lowering);
+  else
+    universe = module->to_hlir_universe(symbols, class_tree, options.lowering);
+
+  options.time_report->stop("phase", "hlir_generation");
 
   std::ostream *output = nullptr;
   std::fstream out_file;
@@ -214,12 +277,28 @@ hlir::Universe run_hlir_generation(ModuleNode *module, SymbolTable &symbols,
 
 void run_hlir_optimizers(hlir::Universe &universe,
                          const OptimizerConfig &optimizer_config,
-                         const SymbolTable &symbols, const CliOptions &options,
-                         int &steps) {
-  hlir::PassManager pass_manager{universe, optimizer_config};
+                         const SymbolTable &symbols, ThreadPool *pool,
+                         const CliOptions &options, int &steps) {
+  TraceSpan span("phase", "optimize");
+
+  hlir::PassManager pass_manager{universe, optimizer_config, symbols, pool};
 
   while (!pass_manager.is_done()) {
-    const hlir::Pass &pass = pass_manager.run_pass();
+    // In parallel, consecutive method passes run together on each method, so
+    // there is only one dump for all of them. Otherwise every pass gets one.
+    options.time_report->start();
+
+    std::vector<const hlir::Pass *> passes;
+    if (pool != nullptr)
+      passes = pass_manager.run_stage();
+    else
+      passes = {&pass_manager.run_pass()};
+
+    std::string name;
+    for (const hlir::Pass *pass : passes)
+      name += (name.empty() ? "" : "+") + pass->name;
+
+    options.time_report->stop("pass", name);
 
     std::ostream *output = nullptr;
     std::fstream out_file;
@@ -227,7 +306,7 @@ void run_hlir_optimizers(hlir::Universe &universe,
     if (options.debug_output) {
       std::filesystem::create_directories(options.debug_dir);
       out_file.open(options.debug_dir /
-                        std::format("{:03}_{}_opt.hlir", steps, pass.name),
+                        std::format("{:03}_{}_opt.hlir", steps, name),
                     std::ios::out);
       output = &out_file;
     }
@@ -239,6 +318,14 @@ void run_hlir_optimizers(hlir::Universe &universe,
 
     steps++;
   }
+
+  if (options.debug_output) {
+    std::fstream out_file(options.debug_dir /
+                              std::format("{:03}_statistics.log", steps),
+                          std::ios::out);
+    print_statistics(out_file);
+    steps++;
+  }
 }
 
 /**********************
@@ -251,6 +338,13 @@ int main(int argc, char *argv[]) {
   std::istream *stream = &std::cin;
   bool verbose = false;
   bool debug = true; // Default to debug mode while we develop
+  unsigned int jobs = 1;
+  hlir::Lowering lowering = hlir::Lowering::DESTINATION_PASSING;
+  OptimizerConfig optimizer_config;
+  bool time_report_table = false;
+  std::filesystem::path time_report_file;
+  bool print_stats = false;
+  std::filesystem::path trace_file;
   std::filesystem::path debug_dir = debug_dir_base;
 
   // Not used if reading from stdin
@@ -264,6 +358,81 @@ int main(int argc, char *argv[]) {
     else if (arg == "--debug")
       debug = true;
 
+    // -j N, -jN or --jobs=N
+    else if (arg.starts_with("-j") || arg.starts_with("--jobs=")) {
+      std::string value;
+      if (arg == "-j" && arg_pos + 1 < argc)
+        value = argv[++arg_pos];
+      else if (arg.starts_with("--jobs="))
+        value = arg.substr(std::string("--jobs=").size());
+      else
+        value = arg.substr(std::string("-j").size());
+
+      // 0 (or no number) means one job per hardware thread
+      jobs = value.empty() ? 0 : parse_option_number("-j", value, max_jobs);
+      if (jobs == 0)
+        jobs = ThreadPool::hardware_threads();
+    }
+
+    // The table goes to stderr, JSON to the file given
+    else if (arg == "--time-report")
+      time_report_table = true;
+
+    else if (arg.starts_with("--time-report="))
+      time_report_file = arg.substr(std::string("--time-report=").size());
+
+    else if (arg == "--stats")
+      print_stats = true;
+
+    // Chrome trace events, for about:tracing or ui.perfetto.dev
+    else if (arg.starts_with("--trace=")) {
+      trace_file = arg.substr(std::string("--trace=").size());
+      enable_tracing();
+    }
+
+    else if (arg == "--lowering=acc")
+      lowering = hlir::Lowering::THROUGH_ACC;
+
+    else if (arg == "--lowering=destination")
+      lowering = hlir::Lowering::DESTINATION_PASSING;
+
+    else if (arg == "-O0")
+      optimizer_config.level = OptimizationLevel::O0;
+
+    else if (arg == "-O1")
+      optimizer_config.level = OptimizationLevel::O1;
+
+    else if (arg == "-O2")
+      optimizer_config.level = OptimizationLevel::O2;
+
+    else if (arg == "-O3")
+      optimizer_config.level = OptimizationLevel::O3;
+
+    // Replaces the pipeline of the level, e.g.
+    // --passes=fixpoint(constant_folding,copy_propagation,dce),sccp
+    else if (arg.starts_with("--passes=")) {
+      optimizer_config.passes =
+          hlir::split_pipeline(arg.substr(std::string("--passes=").size()));
+
+      for (const std::string &name : optimizer_config.passes)
+        if (hlir::make_pass(name) == nullptr)
+          fatal(std::format("Unknown optimization pass {}", name));
+    }
+
+    else if (arg.starts_with("--folding-rounds="))
+      optimizer_config.folding_rounds = parse_option_number(
+          "--folding-rounds",
+          arg.substr(std::string("--folding-rounds=").size()));
+
+    else if (arg.starts_with("--dce-sweeps="))
+      optimizer_config.dce_sweeps = parse_option_number(
+          "--dce-sweeps", arg.substr(std::string("--dce-sweeps=").size()));
+
+    else if (arg.starts_with("--fixpoint-rounds="))
+      optimizer_config.fixpoint_rounds = parse_option_number(
+          "--fixpoint-rounds",
+          arg.substr(std::string("--fixpoint-rounds=").size()));
+
     else if (arg != "-") {
       input_file.open(arg, std::ios::in);
 
@@ -277,11 +446,18 @@ int main(int argc, char *argv[]) {
   int steps = 0;
 
   SymbolTable symbols = SymbolTable();
+  TimeReport time_report;
 
   CliOptions options = {.debug_output = debug,
                         .debug_dir = debug_dir,
                         .verbose = verbose,
-                        .indent = 2};
+                        .indent = 2,
+                        .lowering = lowering,
+                        .time_report = &time_report};
+
+  // Only spin up threads when we were asked to run work in parallel
+  std::unique_ptr<ThreadPool> pool =
+      jobs > 1 ? std::make_unique<ThreadPool>(jobs) : nullptr;
 
   TokenStream tokens = run_tokenizer(stream, symbols, options, steps);
 
@@ -290,11 +466,28 @@ int main(int argc, char *argv[]) {
   Scopes scopes = Scopes();
 
   std::unique_ptr<ClassTree> class_tree =
-      run_semantic_analysis(ast.get(), scopes, symbols, options, steps);
+      run_semantic_analysis(ast.get(), scopes, symbols, pool.get(), options,
+                            steps);
 
-  hlir::Universe universe =
-      run_hlir_generation(ast.get(), symbols, options, steps);
+  hlir::Universe universe = run_hlir_generation(
+      ast.get(), *class_tree, symbols, pool.get(), options, steps);
 
-  OptimizerConfig optimizer_config;
-  run_hlir_optimizers(universe, optimizer_config, symbols, options, steps);
+  run_hlir_optimizers(universe, optimizer_config, symbols, pool.get(), options,
+                      steps);
+
+  if (time_report_table)
+    time_report.print_table(std::cerr);
+
+  if (!time_report_file.empty()) {
+    std::fstream out_file(time_report_file, std::ios::out);
+    time_report.print_json(out_file);
+  }
+
+  if (print_stats)
+    print_statistics(std::cerr);
+
+  if (!trace_file.empty()) {
+    std::fstream out_file(trace_file, std::ios::out);
+    write_trace(out_file);
+  }
 }
@@ -0,0 +1,165 @@
+#include "object_layout.h"
+#include <algorithm>
+
+static int align_to(int offset, int alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/***********************
+ *                     *
+ *      FieldKind      *
+ *                     *
+ **********************/
+
+std::string to_string(FieldKind kind) {
+  switch (kind) {
+  case FieldKind::REFERENCE:
+    return "ref";
+  case FieldKind::INT:
+    return "int";
+  case FieldKind::BOOL:
+    return "bool";
+  }
+  return "__unknown_field_kind__";
+}
+
+/***********************
+ *                     *
+ *        Field        *
+ *                     *
+ **********************/
+
+int Field::size() const {
+  switch (kind) {
+  case FieldKind::REFERENCE:
+    return ObjectLayout::REFERENCE_SIZE;
+  case FieldKind::INT:
+    return ObjectLayout::INT_SIZE;
+  case FieldKind::BOOL:
+    return ObjectLayout::BOOL_SIZE;
+  }
+  return ObjectLayout::REFERENCE_SIZE;
+}
+
+/***********************
+ *                     *
+ *     ObjectLayout    *
+ *                     *
+ **********************/
+
+ObjectLayout::ObjectLayout() : end(HEADER_SIZE) {}
+
+FieldKind ObjectLayout::field_kind(Symbol type, const SymbolTable &symbols) {
+  if (type == symbols.int_type)
+    return FieldKind::INT;
+  if (type == symbols.bool_type)
+    return FieldKind::BOOL;
+  return FieldKind::REFERENCE;
+}
+
+void ObjectLayout::add_field(Symbol name, Symbol type, FieldKind kind,
+                             int offset) {
+  Field field{name, type, kind, offset};
+  end = std::max(end, offset + field.size());
+
+  if (kind == FieldKind::REFERENCE)
+    reference_offsets_.push_back(offset);
+
+  fields_.push_back(field);
+}
+
+ObjectLayout
+ObjectLayout::extend(const ObjectLayout &superclass,
+                     const std::vector<std::pair<Symbol, Symbol>> &attributes,
+                     const SymbolTable &symbols) {
+  ObjectLayout layout = superclass;
+
+  std::vector<std::pair<Symbol, Symbol>> references;
+  std::vector<std::pair<Symbol, Symbol>> ints;
+  std::vector<std::pair<Symbol, Symbol>> bools;
+
+  for (const auto &attribute : attributes) {
+    // A redefined attribute has the inherited type (the typechecker rejects
+    // anything else), so it keeps the inherited field
+    if (superclass.field(attribute.first))
+      continue;
+
+    switch (field_kind(attribute.second, symbols)) {
+    case FieldKind::REFERENCE:
+      references.push_back(attribute);
+      break;
+    case FieldKind::INT:
+      ints.push_back(attribute);
+      break;
+    case FieldKind::BOOL:
+      bools.push_back(attribute);
+      break;
+    }
+  }
+
+  // Small fields go largest first, so each one lands aligned
+  std::vector<std::pair<Symbol, Symbol>> small = ints;
+  small.insert(small.end(), bools.begin(), bools.end());
+
+  int offset = layout.end;
+
+  auto place_small = [&](const std::pair<Symbol, Symbol> &attribute) {
+    FieldKind kind = field_kind(attribute.second, symbols);
+    int size = kind == FieldKind::INT ? INT_SIZE : BOOL_SIZE;
+    int position = align_to(offset, size);
+
+    layout.add_field(attribute.first, attribute.second, kind, position);
+    offset = position + size;
+  };
+
+  if (!references.empty()) {
+    // Use the padding in front of the first reference for whatever small
+    // fields fit there
+    int references_start = align_to(offset, REFERENCE_SIZE);
+
+    for (auto it = small.begin(); it != small.end();) {
+      FieldKind kind = field_kind(it->second, symbols);
+      int size = kind == FieldKind::INT ? INT_SIZE : BOOL_SIZE;
+
+      if (align_to(offset, size) + size <= references_start) {
+        place_small(*it);
+        it = small.erase(it);
+      } else {
+        it++;
+      }
+    }
+
+    offset = references_start;
+    for (const auto &attribute : references) {
+      layout.add_field(attribute.first, attribute.second, FieldKind::REFERENCE,
+                       offset);
+      offset += REFERENCE_SIZE;
+    }
+  }
+
+  for (const auto &attribute : small)
+    place_small(attribute);
+
+  std::sort(layout.fields_.begin(), layout.fields_.end(),
+            [](const Field &a, const Field &b) { return a.offset < b.offset; });
+  std::sort(layout.reference_offsets_.begin(), layout.reference_offsets_.end());
+
+  layout.field_idx = SmallSymbolMap<int>();
+  for (size_t i = 0; i < layout.fields_.size(); i++)
+    layout.field_idx[layout.fields_[i].name] = i;
+
+  return layout;
+}
+
+int ObjectLayout::size() const { return align_to(end, ALIGNMENT); }
+
+const Field *ObjectLayout::field(Symbol name) const {
+  const int *idx = field_idx.find(name);
+  return idx ? &fields_[*idx] : nullptr;
+}
+
+const std::vector<Field> &ObjectLayout::fields() const { return fields_; }
+
+const std::vector<int> &ObjectLayout::reference_offsets() const {
+  return reference_offsets_;
+}
@@ -1,7 +1,6 @@
 #include "semantic.h"
 #include "error.h"
 #include <format>
-#include <stdexcept>
 
 /***********************
  *                     *
@@ -23,28 +22,36 @@ bool VarInfo::is_undefined() const { return lifetime == Lifetime::UNDEFINED; }
 
 Scopes::Scopes() {}
 
-void Scopes::enter() { scopes.push_front(std::unordered_map<int, VarInfo>()); }
-void Scopes::exit() { scopes.pop_front(); }
+void Scopes::enter() { scopes.emplace_back(); }
+
+void Scopes::exit() {
+  for (Symbol name : scopes.back())
+    bindings.at(name).pop_back();
+  scopes.pop_back();
+}
 
 void Scopes::assign(Symbol name, Symbol type, Lifetime kind) {
-  scopes.front().emplace(name.id, VarInfo(type, kind));
+  // The first definition of a name in a scope wins
+  std::vector<std::pair<size_t, VarInfo>> &stack = bindings[name];
+  if (!stack.empty() && stack.back().first == scopes.size())
+    return;
+
+  stack.emplace_back(scopes.size(), VarInfo(type, kind));
+  scopes.back().push_back(name);
 }
 
 VarInfo Scopes::get(Symbol name) const {
-  for (auto &scope : scopes) {
-    if (scope.find(name.id) != scope.end()) {
-      return scope.at(name.id);
-    }
-  }
-  return VarInfo::undefined();
+  const auto *stack = bindings.find(name);
+  if (!stack || stack->empty())
+    return VarInfo::undefined();
+  return stack->back().second;
 }
 
 VarInfo Scopes::lookup(Symbol name) const {
-  try {
-    return scopes.front().at(name.id);
-  } catch (const std::out_of_range &) {
+  const auto *stack = bindings.find(name);
+  if (!stack || stack->empty() || stack->back().first != scopes.size())
     return VarInfo::undefined();
-  }
+  return stack->back().second;
 }
 
 /***********************
@@ -54,19 +61,17 @@ VarInfo Scopes::lookup(Symbol name) const {
  **********************/
 
 ClassInfo::ClassInfo(ClassNode *cn, int d)
-    : class_node(cn), depth_(d),
-      methods_(std::unordered_map<int, MethodNode *>()),
-      attributes_(std::unordered_map<int, AttributeNode *>()) {
+    : class_node(cn), depth_(d) {
   for (const auto &method_ptr : cn->methods) {
     Symbol name = method_ptr->name;
     MethodNode *raw_method_ptr = method_ptr.get();
-    methods_[name.id] = raw_method_ptr;
+    methods_[name] = raw_method_ptr;
   }
 
   for (const auto &attr_ptr : cn->attributes) {
     Symbol object_id = attr_ptr->object_id;
     AttributeNode *raw_attr_ptr = attr_ptr.get();
-    attributes_[object_id.id] = raw_attr_ptr;
+    attributes_[object_id] = raw_attr_ptr;
   }
 }
 
@@ -84,10 +89,14 @@ Symbol ClassInfo::name() const { return class_node->name; }
 
 Symbol ClassInfo::superclass() const { return class_node->superclass; }
 
-MethodNode *ClassInfo::method(Symbol name) { return methods_[name.id]; }
+MethodNode *ClassInfo::method(Symbol name) const {
+  MethodNode *const *found = methods_.find(name);
+  return found ? *found : nullptr;
+}
 
-AttributeNode *ClassInfo::attribute(Symbol name) {
-  return attributes_[name.id];
+AttributeNode *ClassInfo::attribute(Symbol name) const {
+  AttributeNode *const *found = attributes_.find(name);
+  return found ? *found : nullptr;
 }
 
 std::vector<Symbol> ClassInfo::methods() const {
@@ -114,7 +123,18 @@ std::vector<Symbol> ClassInfo::attributes() const {
 
 TypeContext::TypeContext(Scopes &scps, Symbol cc, const ClassTree &ct,
                          SymbolTable &st)
-    : scopes(scps), current_class(cc), class_tree(ct), symbols(st) {}
+    : scopes(scps), current_class(cc), class_tree(ct), symbols(st),
+      dependencies(nullptr) {}
+
+void TypeContext::depend_on(Symbol class_name) const {
+  if (dependencies == nullptr)
+    return;
+
+  if (class_name == symbols.self_type)
+    class_name = current_class;
+
+  dependencies->insert(class_name.id);
+}
 
 bool TypeContext::match(Symbol type_a, Symbol type_b) const {
   if (type_a == symbols.self_type)
@@ -123,34 +143,17 @@ bool TypeContext::match(Symbol type_a, Symbol type_b) const {
   if (type_b == symbols.self_type)
     type_b = current_class;
 
+  depend_on(type_a);
+  depend_on(type_b);
+
   return class_tree.is_subclass(type_a, type_b);
 }
 
 void TypeContext::assign_attributes(Symbol class_name) {
-  while (class_name != symbols.tree_root_type) {
-    std::optional<ClassInfo> cls = class_tree.get(class_name);
-    if (!cls.has_value())
-      fatal(
-          std::format(
-              "INTERNAL: class {} could not be found in ClassTree after checks",
-              symbols.get_string(class_name)),
-          Token{});
-
-    for (const Symbol attr : cls->attributes()) {
-      AttributeNode *attr_ptr = cls->attribute(attr);
-
-      if (!attr_ptr)
-        fatal(std::format("INTERNAL: attribute {}.{} could not be found but it "
-                          "is declared in the AST",
-                          symbols.get_string(class_name),
-                          symbols.get_string(attr)),
-              Token{});
-
-      scopes.assign(attr, attr_ptr->declared_type, Lifetime::ATTRIBUTE);
-    }
-
-    class_name = cls->superclass();
-  }
+  class_tree.get_attributes(class_name)
+      .for_each([&](Symbol name, AttributeNode *attr_ptr) {
+        scopes.assign(name, attr_ptr->declared_type, Lifetime::ATTRIBUTE);
+      });
 }
 
 VarInfo TypeContext::get_var(Symbol name) const {
@@ -162,8 +165,18 @@ VarInfo TypeContext::get_var(Symbol name) const {
 
 MethodNode *TypeContext::get_method(Symbol class_name,
                                     Symbol method_name) const {
+  depend_on(class_name);
+
   if (class_name == symbols.self_type)
     return class_tree.get_method(current_class, method_name);
 
   return class_tree.get_method(class_name, method_name);
 }
+
+std::optional<ClassInfo> TypeContext::common_ancestor(Symbol type_a,
+                                                      Symbol type_b) const {
+  depend_on(type_a);
+  depend_on(type_b);
+
+  return class_tree.common_ancestor(type_a, type_b);
+}
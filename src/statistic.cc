@@ -0,0 +1,57 @@
+#include "statistic.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <mutex>
+
+/***********************
+ *                     *
+ *      Statistic      *
+ *                     *
+ **********************/
+
+// Function-local so that counters in other translation units can register
+// during static initialization, whatever order it runs in
+static std::vector<Statistic *> &registry() {
+  static std::vector<Statistic *> statistics;
+  return statistics;
+}
+
+static std::mutex &registry_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+Statistic::Statistic(const char *g, const char *n, const char *d)
+    : group_(g), name_(n), description_(d), value(0) {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  registry().push_back(this);
+}
+
+std::vector<const Statistic *> Statistic::all() {
+  std::vector<const Statistic *> statistics;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    statistics.assign(registry().begin(), registry().end());
+  }
+
+  std::sort(statistics.begin(), statistics.end(),
+            [](const Statistic *a, const Statistic *b) {
+              int order = std::strcmp(a->group(), b->group());
+              if (order != 0)
+                return order < 0;
+              return std::strcmp(a->name(), b->name()) < 0;
+            });
+  return statistics;
+}
+
+void print_statistics(std::ostream &output) {
+  for (const Statistic *statistic : Statistic::all()) {
+    if (statistic->get() == 0)
+      continue;
+
+    output << std::format("{:>10} {}.{} - {}\n", statistic->get(),
+                          statistic->group(), statistic->name(),
+                          statistic->description());
+  }
+}
@@ -1,5 +1,6 @@
 
 #include "symbol.h"
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -29,7 +30,6 @@ SymbolTable::SymbolTable() {
   // files will have quite a large number of different symbols.
   // Reserve a good starting size.
   const int MINIMUM_SYMBOLS_SIZE = 128;
-  strings.reserve(MINIMUM_SYMBOLS_SIZE);
   id_map.reserve(MINIMUM_SYMBOLS_SIZE);
 
   true_const = from("true");
@@ -71,13 +71,25 @@ SymbolTable::SymbolTable() {
   string_empty = from("\"\"");
   void_value = from("__void__");
   type_id_type = from("__TypeId__");
+  initializer_method = from("__initializer__");
+  block_label = from("__block__");
 }
 
 Symbol SymbolTable::from(const std::string &str) {
-  if (id_map.count(str) > 0) {
-    return Symbol{id_map.at(str)};
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto found = id_map.find(str);
+    if (found != id_map.end())
+      return Symbol{found->second};
   }
 
+  std::unique_lock<std::shared_mutex> lock(mutex);
+
+  // Another thread may have interned the string while we waited for the lock
+  auto found = id_map.find(str);
+  if (found != id_map.end())
+    return Symbol{found->second};
+
   int pos = strings.size();
 
   strings.push_back(str);
@@ -92,5 +104,6 @@ const std::string &SymbolTable::get_string(Symbol symbol) const {
   if (symbol.is_empty()) {
     return _EMPTY_STRING;
   }
+  std::shared_lock<std::shared_mutex> lock(mutex);
   return strings[symbol.id];
 }
@@ -0,0 +1,91 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+
+/***********************
+ *                     *
+ *      ThreadPool     *
+ *                     *
+ **********************/
+
+ThreadPool::ThreadPool(unsigned int threads) : stopping(false) {
+  for (unsigned int i = 1; i < threads; i++)
+    workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    stopping = true;
+  }
+  tasks_available.notify_all();
+
+  for (auto &worker : workers)
+    worker.join();
+}
+
+unsigned int ThreadPool::size() const { return workers.size() + 1; }
+
+unsigned int ThreadPool::hardware_threads() {
+  unsigned int threads = std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(tasks_mutex);
+      tasks_available.wait(lock, [&] { return stopping || !tasks.empty(); });
+
+      if (tasks.empty())
+        return;
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallel_for(size_t count,
+                              const std::function<void(size_t)> &body) {
+  if (count == 0)
+    return;
+
+  // Every participant claims indices from a shared counter, so uneven items
+  // (e.g. one huge class) do not leave the other threads idle.
+  std::atomic<size_t> next_index = 0;
+
+  auto run_items = [&] {
+    for (size_t i = next_index++; i < count; i = next_index++)
+      body(i);
+  };
+
+  size_t helpers = std::min<size_t>(workers.size(), count - 1);
+
+  // Helpers reference this stack frame, so we can only return once all of them
+  // have finished, not just once all items were claimed.
+  std::mutex done_mutex;
+  std::condition_variable done;
+  size_t running_helpers = helpers;
+
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    for (size_t i = 0; i < helpers; i++) {
+      tasks.push_back([&] {
+        run_items();
+
+        std::lock_guard<std::mutex> done_lock(done_mutex);
+        if (--running_helpers == 0)
+          done.notify_one();
+      });
+    }
+  }
+  tasks_available.notify_all();
+
+  run_items();
+
+  std::unique_lock<std::mutex> done_lock(done_mutex);
+  done.wait(done_lock, [&] { return running_helpers == 0; });
+}
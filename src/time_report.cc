@@ -0,0 +1,344 @@
+#include "time_report.h"
+#include "error.h"
+#include "statistic.h"
+#include <atomic>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <new>
+
+/***********************
+ *                     *
+ *     Allocations     *
+ *                     *
+ **********************/
+
+// Counters are spread over cache lines, each thread bumping one of them, so
+// that threads allocating at the same time do not fight over one line
+static constexpr int NUM_SHARDS = 16;
+
+struct alignas(64) AllocationShard {
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> bytes;
+};
+
+// Zero-initialized before any code runs, since operator new can be called
+// during static initialization
+static AllocationShard shards[NUM_SHARDS];
+static std::atomic<int> next_shard;
+static thread_local int thread_shard = -1;
+
+static void count_allocation(std::size_t size) {
+  if (thread_shard == -1)
+    thread_shard = next_shard.fetch_add(1, std::memory_order_relaxed) %
+                   NUM_SHARDS;
+
+  AllocationShard &shard = shards[thread_shard];
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+Allocations allocations_so_far() {
+  Allocations total = {0, 0};
+  for (const AllocationShard &shard : shards) {
+    total.count += shard.count.load(std::memory_order_relaxed);
+    total.bytes += shard.bytes.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void *operator new(std::size_t size) {
+  count_allocation(size);
+
+  while (true) {
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if (memory != nullptr)
+      return memory;
+
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return operator new(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+// Every form of delete frees through here. Kept out of line, since once
+// delete is inlined where new was not, the compiler sees free() called on
+// what operator new returned and warns.
+[[gnu::noinline]] static void release(void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory) noexcept { release(memory); }
+void operator delete[](void *memory) noexcept { release(memory); }
+void operator delete(void *memory, std::size_t) noexcept { release(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { release(memory); }
+
+/***********************
+ *                     *
+ *     TimeReport      *
+ *                     *
+ **********************/
+
+static std::vector<uint64_t> statistic_values() {
+  std::vector<uint64_t> values;
+  for (const Statistic *statistic : Statistic::all())
+    values.push_back(statistic->get());
+  return values;
+}
+
+TimeReport::TimeReport() : start_allocations{0, 0}, running(false) {}
+
+void TimeReport::start() {
+  if (running)
+    fatal("INTERNAL: time report phases cannot nest");
+
+  running = true;
+  start_counters = statistic_values();
+  start_allocations = allocations_so_far();
+  start_time = std::chrono::steady_clock::now();
+}
+
+void TimeReport::stop(std::string kind, std::string name) {
+  auto end_time = std::chrono::steady_clock::now();
+  Allocations end_allocations = allocations_so_far();
+
+  if (!running)
+    fatal("INTERNAL: stopping the time report while nothing is being timed");
+  running = false;
+
+  entries_.push_back({std::move(kind), std::move(name), 0, {0, 0}, {}});
+  Entry &entry = entries_.back();
+  entry.seconds =
+      std::chrono::duration<double>(end_time - start_time).count();
+  entry.allocations = {end_allocations.count - start_allocations.count,
+                       end_allocations.bytes - start_allocations.bytes};
+
+  std::vector<const Statistic *> statistics = Statistic::all();
+  for (size_t i = 0; i < statistics.size(); i++) {
+    uint64_t change = statistics[i]->get() - start_counters[i];
+    if (change != 0)
+      entry.counters.push_back({std::format("{}.{}", statistics[i]->group(),
+                                            statistics[i]->name()),
+                                change});
+  }
+}
+
+const std::vector<TimeReport::Entry> &TimeReport::entries() const {
+  return entries_;
+}
+
+void TimeReport::print_table(std::ostream &output) const {
+  double seconds = 0;
+  Allocations allocations = {0, 0};
+
+  output << std::format("{:>10} {:>7} {:>12} {:>14}  {}\n", "Wall (s)", "%",
+                        "Allocations", "Bytes", "Phase");
+
+  for (const Entry &entry : entries_) {
+    seconds += entry.seconds;
+    allocations.count += entry.allocations.count;
+    allocations.bytes += entry.allocations.bytes;
+  }
+
+  for (const Entry &entry : entries_) {
+    double percent = seconds == 0 ? 0 : 100 * entry.seconds / seconds;
+    output << std::format("{:>10.4f} {:>7.1f} {:>12} {:>14}  {} {}\n",
+                          entry.seconds, percent, entry.allocations.count,
+                          entry.allocations.bytes, entry.kind, entry.name);
+
+    for (const auto &[name, change] : entry.counters)
+      output << std::format("{:>48}{:>10} {}\n", "", change, name);
+  }
+
+  output << std::format("{:>10.4f} {:>7.1f} {:>12} {:>14}  total\n", seconds,
+                        100.0, allocations.count, allocations.bytes);
+}
+
+// Pass names come from the command line, so they may need escaping
+static std::string json_string(const std::string &text) {
+  const char *hex = "0123456789abcdef";
+  std::string escaped = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += "\\u00";
+      escaped += hex[c >> 4];
+      escaped += hex[c & 0xf];
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped + "\"";
+}
+
+void TimeReport::print_json(std::ostream &output) const {
+  output << "{\n  \"entries\": [";
+
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const Entry &entry = entries_[i];
+    output << (i == 0 ? "\n" : ",\n");
+    output << std::format("    {{\"kind\": {}, \"name\": {}, \"seconds\": {}, "
+                          "\"allocations\": {}, \"bytes\": {}, "
+                          "\"counters\": {{",
+                          json_string(entry.kind), json_string(entry.name),
+                          entry.seconds, entry.allocations.count,
+                          entry.allocations.bytes);
+
+    for (size_t j = 0; j < entry.counters.size(); j++)
+      output << std::format("{}{}: {}", j == 0 ? "" : ", ",
+                            json_string(entry.counters[j].first),
+                            entry.counters[j].second);
+    output << "}}";
+  }
+
+  output << "\n  ]\n}\n";
+}
+
+/***********************
+ *                     *
+ *        Trace        *
+ *                     *
+ **********************/
+
+struct TraceEvent {
+  const char *category;
+  std::string name;
+  // Microseconds since tracing started
+  double start;
+  double duration;
+};
+
+struct TraceBuffer {
+  int thread;
+  std::vector<TraceEvent> events;
+};
+
+// Only written before other threads start, by enable_tracing()
+static bool tracing = false;
+static std::chrono::steady_clock::time_point trace_start;
+
+// Buffers outlive their threads, so that workers can exit before the trace
+// is written. The mutex is only taken once per thread, for its first span.
+static std::mutex trace_buffers_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+static thread_local TraceBuffer *thread_trace_buffer = nullptr;
+
+static TraceBuffer &trace_buffer() {
+  if (thread_trace_buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+    int thread = static_cast<int>(trace_buffers.size());
+    trace_buffers.push_back(
+        std::make_unique<TraceBuffer>(TraceBuffer{thread, {}}));
+    thread_trace_buffer = trace_buffers.back().get();
+  }
+  return *thread_trace_buffer;
+}
+
+static double trace_microseconds(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration<double, std::micro>(time - trace_start).count();
+}
+
+void enable_tracing() {
+  tracing = true;
+  trace_start = std::chrono::steady_clock::now();
+  // The calling thread comes first, as the main thread of the trace
+  trace_buffer();
+}
+
+bool tracing_enabled() { return tracing; }
+
+TraceSpan::TraceSpan(const char *c, std::string_view n)
+    : category(c), recording(tracing) {
+  if (!recording)
+    return;
+
+  name = n;
+  start = std::chrono::steady_clock::now();
+}
+
+TraceSpan::TraceSpan(const char *c, std::string_view scope, std::string_view n)
+    : category(c), recording(tracing) {
+  if (!recording)
+    return;
+
+  name.reserve(scope.size() + 1 + n.size());
+  name += scope;
+  name += '.';
+  name += n;
+  start = std::chrono::steady_clock::now();
+}
+
+TraceSpan::TraceSpan(const char *c, const SymbolTable &symbols, Symbol n)
+    : TraceSpan(c, tracing ? std::string_view(symbols.get_string(n))
+                           : std::string_view()) {}
+
+TraceSpan::TraceSpan(const char *c, const SymbolTable &symbols, Symbol scope,
+                     Symbol n)
+    : TraceSpan(c,
+                tracing ? std::string_view(symbols.get_string(scope))
+                        : std::string_view(),
+                tracing ? std::string_view(symbols.get_string(n))
+                        : std::string_view()) {}
+
+TraceSpan::~TraceSpan() {
+  if (!recording)
+    return;
+
+  auto end = std::chrono::steady_clock::now();
+  trace_buffer().events.push_back({category, std::move(name),
+                                   trace_microseconds(start),
+                                   trace_microseconds(end) -
+                                       trace_microseconds(start)});
+}
+
+void write_trace(std::ostream &output) {
+  std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+  output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+  bool first = true;
+  auto separate = [&]() {
+    output << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  for (const std::unique_ptr<TraceBuffer> &buffer : trace_buffers) {
+    std::string thread_name = buffer->thread == 0
+                                  ? std::string("main")
+                                  : std::format("worker {}", buffer->thread);
+    separate();
+    output << std::format("{{\"name\": \"thread_name\", \"ph\": \"M\", "
+                          "\"pid\": 1, \"tid\": {}, "
+                          "\"args\": {{\"name\": {}}}}}",
+                          buffer->thread, json_string(thread_name));
+
+    for (const TraceEvent &event : buffer->events) {
+      separate();
+      output << std::format("{{\"name\": {}, \"cat\": {}, \"ph\": \"X\", "
+                            "\"ts\": {:.3f}, \"dur\": {:.3f}, "
+                            "\"pid\": 1, \"tid\": {}}}",
+                            json_string(event.name),
+                            json_string(event.category), event.start,
+                            event.duration, buffer->thread);
+    }
+  }
+
+  output << "\n]}\n";
+}
@@ -1,5 +1,7 @@
 #include "error.h"
 #include "semantic.h"
+#include "thread_pool.h"
+#include "time_report.h"
 #include <format>
 #include <unordered_set>
 
@@ -17,7 +19,7 @@ bool ExpressionNode::typecheck(TypeContext &context) {
 }
 
 bool AttributeNode::typecheck(TypeContext &context) {
-  bool check = typecheck_inheritance(context);
+  bool check = true;
 
   if (!initializer.has_value()) {
     return check;
@@ -46,9 +48,7 @@ bool ParameterNode::typecheck(TypeContext &context) {
 }
 
 bool MethodNode::typecheck(TypeContext &context) {
-  // Check we have not already defined this method in a superclass with a
-  // different signature
-  bool check = typecheck_inheritance(context);
+  bool check = true;
 
   context.scopes.enter();
 
@@ -83,17 +83,31 @@ bool MethodNode::typecheck(TypeContext &context) {
 bool ClassNode::typecheck(TypeContext &context) {
   bool check = true;
 
+  // Our own signature covers the whole superclass chain, which is what the
+  // inherited attributes and the inheritance checks read
+  context.depend_on(name);
+
   context.scopes.enter();
 
   context.assign_attributes(superclass);
 
+  // Each feature is only compared with its nearest inherited definition
+  const ClassTree &class_tree = context.class_tree;
+
   for (const auto &attribute : attributes) {
+    if (AttributeNode *inherited =
+            class_tree.get_attribute(superclass, attribute->object_id))
+      check = attribute->typecheck_inheritance(context, *inherited) && check;
+
     check = attribute->typecheck(context) && check;
     context.scopes.assign(attribute->object_id, attribute->declared_type,
                           Lifetime::ATTRIBUTE);
   }
 
   for (const auto &method : methods) {
+    if (MethodNode *inherited = class_tree.get_method(superclass, method->name))
+      check = method->typecheck_inheritance(context, *inherited) && check;
+
     check = method->typecheck(context) && check;
   }
 
@@ -105,6 +119,7 @@ bool ClassNode::typecheck(TypeContext &context) {
 bool ModuleNode::typecheck(TypeContext &context) {
   bool check = true;
   for (const auto &class_node : classes) {
+    TraceSpan span("class", context.symbols, class_node->name);
     TypeContext class_context = context;
     class_context.current_class = class_node->name;
     check = class_node->typecheck(class_context) && check;
@@ -113,6 +128,36 @@ bool ModuleNode::typecheck(TypeContext &context) {
   return check;
 }
 
+bool ModuleNode::typecheck(TypeContext &context, ThreadPool &pool) {
+  // Classes only read the (already built) ClassTree and annotate their own
+  // nodes, so they can be checked independently of each other
+  std::vector<Diagnostics> diagnostics(classes.size());
+  std::vector<char> checks(classes.size(), false);
+
+  pool.parallel_for(classes.size(), [&](size_t i) {
+    DiagnosticCapture capture(diagnostics[i]);
+    TraceSpan span("class", context.symbols, classes[i]->name);
+
+    Scopes class_scopes = Scopes();
+    TypeContext class_context = TypeContext(
+        class_scopes, classes[i]->name, context.class_tree, context.symbols);
+
+    try {
+      checks[i] = classes[i]->typecheck(class_context);
+    } catch (const FatalDiagnostic &) {
+      checks[i] = false;
+    }
+  });
+
+  bool check = true;
+  for (size_t i = 0; i < classes.size(); i++) {
+    diagnostics[i].emit();
+    check = checks[i] && check;
+  }
+
+  return check;
+}
+
 /***********************
  *                     *
  *  Atomic Expressions *
@@ -317,7 +362,7 @@ bool DispatchNode::typecheck(TypeContext &context) {
   Symbol parsed_target_type =
       target_type == symbols.self_type ? context.current_class : target_type;
 
-  MethodNode *method_ptr = context.class_tree.get_method(parsed_target_type, method);
+  MethodNode *method_ptr = context.get_method(parsed_target_type, method);
 
   if (!method_ptr) {
     error(std::format("Call to undefined method {}.{}",
@@ -419,7 +464,7 @@ bool IfNode::typecheck(TypeContext &context) {
   Symbol type_else = else_expr->static_type.value();
 
   std::optional<ClassInfo> common_class =
-      context.class_tree.common_ancestor(type_then, type_else);
+      context.common_ancestor(type_then, type_else);
 
   if (!common_class.has_value())
     fatal(std::format("INTERNAL: failed to get common class for {} and {}: "
@@ -543,8 +588,8 @@ bool CaseNode::typecheck(TypeContext &context) {
       common_type = branch->static_type.value();
 
     } else {
-      std::optional<ClassInfo> opt_common_type = context.class_tree.common_ancestor(
-          branch->static_type.value(), common_type);
+      std::optional<ClassInfo> opt_common_type =
+          context.common_ancestor(branch->static_type.value(), common_type);
 
       if (!opt_common_type.has_value())
         fatal("INTERNAL: failed to find ancestor for branch cases after "
@@ -566,86 +611,62 @@ bool CaseNode::typecheck(TypeContext &context) {
  *                     *
  **********************/
 
-bool MethodNode::typecheck_inheritance(const TypeContext &context) const {
-  std::optional<ClassInfo> cls = context.class_tree.get(context.current_class);
-  if (!cls.has_value())
-    fatal(
-        std::format("INTERNAL: clould not find class marked as current_class {}"
-                    "in class tree inside MethodNode",
-                    context.symbols.get_string(context.current_class)),
-        start_token);
-
+bool MethodNode::typecheck_inheritance(const TypeContext &context,
+                                       const MethodNode &inherited) const {
   const SymbolTable &symbols = context.symbols;
 
-  bool check = true;
+  if (inherited.return_type != return_type) {
+    error(std::format("Method {}.{} has return type {} but redefines an "
+                      "inherited method with return type {}",
+                      symbols.get_string(context.current_class),
+                      symbols.get_string(name), symbols.get_string(return_type),
+                      symbols.get_string(inherited.return_type)),
+          start_token);
+    return false;
+  }
 
-  Symbol superclass_name = cls->superclass();
-  MethodNode *inherited_method = context.class_tree.get_method(superclass_name, name);
-  if (inherited_method) {
-    if (inherited_method->return_type != return_type) {
-      error(std::format("Method {}.{} has return type {} but redefines an "
-                        "inherited method with return type {}",
-                        symbols.get_string(context.current_class),
-                        symbols.get_string(name),
-                        symbols.get_string(return_type),
-                        symbols.get_string(inherited_method->return_type)),
-            start_token);
-      check = false;
-    }
+  if (parameters.size() != inherited.parameters.size()) {
+    error(std::format("Method {}.{} has {} parameters but redefines an "
+                      "inherited method with {} parameters",
+                      symbols.get_string(context.current_class),
+                      symbols.get_string(name), parameters.size(),
+                      inherited.parameters.size()),
+          start_token);
+    return false;
+  }
+
+  bool check = true;
 
-    else if (parameters.size() != inherited_method->parameters.size()) {
-      error(std::format("Method {}.{} has {} parameters but redefines an "
-                        "inherited method with {} parameters",
+  for (size_t i = 0; i < parameters.size(); i++) {
+    const auto &param = parameters[i];
+    const auto &inherited_param = inherited.parameters[i];
+    if (param->declared_type != inherited_param->declared_type) {
+      error(std::format("Method {}.{}'s parameter number {} is declared as "
+                        "{} but it redefines an inherited method in which "
+                        "that parameter is declared as {} ",
                         symbols.get_string(context.current_class),
-                        symbols.get_string(name), parameters.size(),
-                        inherited_method->parameters.size()),
+                        symbols.get_string(name), i,
+                        symbols.get_string(param->declared_type),
+                        symbols.get_string(inherited_param->declared_type)),
             start_token);
       check = false;
-    } else {
-      for (int i = 0; i < parameters.size(); i++) {
-        const auto &param = parameters[i];
-        const auto &inherited_param = inherited_method->parameters[i];
-        if (param->declared_type != inherited_param->declared_type) {
-          error(std::format("Method {}.{}'s parameter number {} is declared as "
-                            "{} but it redefines an inherited method in which "
-                            "that parameter is declared as {} ",
-                            symbols.get_string(context.current_class),
-                            symbols.get_string(name), i,
-                            symbols.get_string(param->declared_type),
-                            symbols.get_string(inherited_param->declared_type)),
-                start_token);
-          check = false;
-        }
-      }
     }
   }
 
   return check;
 }
 
-bool AttributeNode::typecheck_inheritance(const TypeContext &context) const {
-  std::optional<ClassInfo> cls = context.class_tree.get(context.current_class);
-  if (!cls.has_value())
-    fatal(
-        std::format("INTERNAL: clould not find class marked as current_class {}"
-                    "in class tree inside MethodNode",
-                    context.symbols.get_string(context.current_class)),
-        start_token);
-
+bool AttributeNode::typecheck_inheritance(
+    const TypeContext &context, const AttributeNode &inherited) const {
   const SymbolTable &symbols = context.symbols;
 
-  Symbol superclass_name = cls->superclass();
-  AttributeNode *inherited_attribute =
-      context.class_tree.get_attribute(superclass_name, object_id);
-
-  if (inherited_attribute &&
-      inherited_attribute->declared_type != declared_type) {
+  if (inherited.declared_type != declared_type) {
     error(std::format("Attribute {}.{} is declared type {} but inherits from a "
                       "class that declared it as {}",
-                      symbols.get_string(cls->name()),
+                      symbols.get_string(context.current_class),
                       symbols.get_string(object_id),
                       symbols.get_string(declared_type),
-                      symbols.get_string(inherited_attribute->declared_type)),
+                      symbols.get_string(inherited.declared_type)),
           start_token);
     return false;
   }
@@ -0,0 +1,150 @@
+#ifndef _HLIR_INTERPRETER_H
+#define _HLIR_INTERPRETER_H
+
+#include "hlir.h"
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+/// Runs a method that only does Int and Bool arithmetic, moves and branches,
+/// and returns the value left in acc. Locals (including arguments) and
+/// attributes start at the values given by name. Tests use it to check that a transformation
+/// keeps the meaning of a method.
+class Interpreter {
+private:
+  const hlir::Method &method;
+  const SymbolTable &symbols;
+  std::map<std::pair<hlir::ValueKind, int>, int32_t> storage;
+
+  static std::pair<hlir::ValueKind, int> key(hlir::Value value) {
+    switch (value.kind()) {
+    case hlir::ValueKind::ACC:
+      return {value.kind(), 0};
+    case hlir::ValueKind::ATTRIBUTE:
+    case hlir::ValueKind::LOCAL:
+      return {value.kind(), value.symbol().id};
+    case hlir::ValueKind::TEMP:
+      return {value.kind(), value.num()};
+    default:
+      throw std::runtime_error("unsupported value");
+    }
+  }
+
+  int32_t read(hlir::Value value) {
+    if (value.kind() == hlir::ValueKind::CONSTANT)
+      return value.static_type() == symbols.bool_type ? value.boolean()
+                                                      : value.num();
+
+    auto found = storage.find(key(value));
+    if (found == storage.end())
+      throw std::runtime_error("read of an undefined value");
+    return found->second;
+  }
+
+  static int32_t wrap(int64_t value) { return int32_t(uint32_t(value)); }
+
+public:
+  Interpreter(const hlir::Method &m, const SymbolTable &s)
+      : method(m), symbols(s) {}
+
+  void set_local(Symbol name, int32_t value) {
+    storage[{hlir::ValueKind::LOCAL, name.id}] = value;
+  }
+
+  void set_attribute(Symbol name, int32_t value) {
+    storage[{hlir::ValueKind::ATTRIBUTE, name.id}] = value;
+  }
+
+  int32_t run(int fuel = 100000) {
+    std::map<int, hlir::Instruction *> labels;
+    for (hlir::Instruction *instruction : method.instructions)
+      if (instruction->op == hlir::Op::LABEL)
+        labels[static_cast<hlir::Label *>(instruction)->get_idx()] =
+            instruction;
+
+    hlir::Instruction *instruction = method.instructions.front();
+    while (instruction != nullptr) {
+      if (fuel-- == 0)
+        throw std::runtime_error("out of fuel");
+
+      hlir::Instruction *next = instruction->get_next();
+      auto args = instruction->args();
+      int32_t result = 0;
+
+      switch (instruction->op) {
+      case hlir::Op::LABEL:
+        break;
+      case hlir::Op::MOV:
+        // Copies of undefined values are fine until something uses them
+        if (args[0].kind() != hlir::ValueKind::CONSTANT &&
+            !storage.contains(key(args[0]))) {
+          storage.erase(key(instruction->get_dest()));
+          instruction = next;
+          continue;
+        }
+        result = read(args[0]);
+        break;
+      case hlir::Op::ADD:
+        result = wrap(int64_t(read(args[0])) + read(args[1]));
+        break;
+      case hlir::Op::SUB:
+        result = wrap(int64_t(read(args[0])) - read(args[1]));
+        break;
+      case hlir::Op::MULT:
+        result = wrap(int64_t(read(args[0])) * read(args[1]));
+        break;
+      case hlir::Op::DIV:
+        if (read(args[1]) == 0)
+          throw std::runtime_error("division by zero");
+        result = wrap(int64_t(read(args[0])) / read(args[1]));
+        break;
+      case hlir::Op::EQUAL:
+        result = read(args[0]) == read(args[1]);
+        break;
+      case hlir::Op::LESS_THAN:
+        result = read(args[0]) < read(args[1]);
+        break;
+      case hlir::Op::LESS_EQUAL:
+        result = read(args[0]) <= read(args[1]);
+        break;
+      case hlir::Op::NEG:
+        result = wrap(-int64_t(read(args[0])));
+        break;
+      case hlir::Op::NOT:
+        result = !read(args[0]);
+        break;
+      case hlir::Op::BRANCH: {
+        bool taken =
+            instruction->condition == hlir::BranchCondition::ALWAYS ||
+            (instruction->condition == hlir::BranchCondition::TRUE) ==
+                (read(args[0]) != 0);
+        if (taken)
+          next = labels.at(
+              static_cast<hlir::Branch *>(instruction)->get_target().label_idx);
+        break;
+      }
+      case hlir::Op::ERROR: {
+        bool raised =
+            instruction->condition == hlir::BranchCondition::ALWAYS ||
+            (instruction->condition == hlir::BranchCondition::TRUE) ==
+                (read(args[0]) != 0);
+        if (raised)
+          throw std::runtime_error("runtime error");
+        break;
+      }
+      default:
+        throw std::runtime_error("unsupported instruction");
+      }
+
+      if (instruction->has_dest())
+        storage[key(instruction->get_dest())] = result;
+
+      instruction = next;
+    }
+
+    return read(hlir::Value::acc(Symbol()));
+  }
+};
+
+#endif // !_HLIR_INTERPRETER_H
@@ -0,0 +1,53 @@
+#ifndef _METHOD_BUILDER_H
+#define _METHOD_BUILDER_H
+
+#include "hlir.h"
+#include <vector>
+
+// Builds methods out of movs, told apart by the temporary they write, copies
+// between temporaries and the control flow instructions around them
+class MethodBuilder {
+public:
+  hlir::Method method;
+  std::vector<int> labels;
+
+  MethodBuilder() : method(Symbol(0)) {
+    for (int i = 0; i < 4; i++)
+      labels.push_back(method.create_label_idx());
+  }
+
+  void mov(int id) {
+    method.instructions.push_back(method.create<hlir::Mov>(
+        hlir::Value::temp(id, Symbol(0)), hlir::Value::empty(), Token()));
+  }
+
+  void copy(int dest, int src) {
+    method.instructions.push_back(method.create<hlir::Mov>(
+        hlir::Value::temp(dest, Symbol(0)), hlir::Value::temp(src, Symbol(0)),
+        Token()));
+  }
+
+  int add_label() {
+    labels.push_back(method.create_label_idx());
+    return labels.size() - 1;
+  }
+
+  void label(int label) {
+    method.instructions.push_back(
+        method.create<hlir::Label>(labels[label], Symbol(0), Token()));
+  }
+
+  void branch(hlir::BranchCondition condition, int label) {
+    method.instructions.push_back(method.create<hlir::Branch>(
+        condition, hlir::Value::acc(Symbol(0)), hlir::Position(labels[label]),
+        Token()));
+  }
+
+  void error() {
+    method.instructions.push_back(method.create<hlir::Error>(
+        hlir::BranchCondition::ALWAYS, hlir::Value::acc(Symbol(0)),
+        runtime::Error::CASE_UNMATCHED, Token()));
+  }
+};
+
+#endif // !_METHOD_BUILDER_H
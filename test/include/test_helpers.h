@@ -0,0 +1,34 @@
+#ifndef _TEST_HELPERS_H
+#define _TEST_HELPERS_H
+
+#include "ast.h"
+#include "hlir.h"
+#include "parser.h"
+#include "semantic.h"
+#include "tokenizer.h"
+#include <sstream>
+
+inline std::unique_ptr<ModuleNode> parse_program(const std::string &program,
+                                                 SymbolTable &symbols) {
+  std::istringstream input(program);
+  TokenStream tokens = tokenize(&input, symbols);
+  Parser parser = Parser(tokens, symbols);
+  return parser.parse();
+}
+
+/// Typechecks and lowers a program that must be correct
+inline hlir::Universe
+lower_program(const std::string &program, SymbolTable &symbols,
+              hlir::Lowering lowering = hlir::Lowering::THROUGH_ACC) {
+  std::unique_ptr<ModuleNode> module = parse_program(program, symbols);
+  ClassTree class_tree(module.get(), symbols);
+
+  Scopes scopes;
+  TypeContext context(scopes, Symbol{}, class_tree, symbols);
+  if (!module->typecheck(context))
+    throw std::runtime_error("program does not typecheck");
+
+  return module->to_hlir_universe(symbols, class_tree, lowering);
+}
+
+#endif // !_TEST_HELPERS_H
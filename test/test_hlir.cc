@@ -0,0 +1,290 @@
+#include "doctest.h"
+#include "hlir.h"
+#include "hlir_interpreter.h"
+#include "test_helpers.h"
+#include "thread_pool.h"
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// Instructions are told apart by the temporary they write
+hlir::Instruction *make_mov(hlir::Method &method, int id) {
+  return method.create<hlir::Mov>(hlir::Value::temp(id, Symbol(0)),
+                                  hlir::Value::empty(), Token());
+}
+
+int id_of(hlir::Instruction *instruction) {
+  return instruction->get_dest().num();
+}
+
+std::vector<int> ids_of(const hlir::InstructionList &instructions) {
+  std::vector<int> ids;
+  for (hlir::Instruction *instruction : instructions)
+    ids.push_back(id_of(instruction));
+  return ids;
+}
+
+TEST_SUITE("InstructionList") {
+  TEST_CASE("push, insert and erase keep the links consistent") {
+    hlir::Method method(Symbol(0));
+    hlir::InstructionList &instructions = method.instructions;
+
+    instructions.push_back(make_mov(method, 2));
+    instructions.push_front(make_mov(method, 1));
+    instructions.push_back(make_mov(method, 4));
+
+    auto it = instructions.insert(std::next(instructions.begin(), 2),
+                                  make_mov(method, 3));
+    CHECK(id_of(*it) == 3);
+    CHECK(ids_of(instructions) == std::vector<int>{1, 2, 3, 4});
+    CHECK(instructions.size() == 4);
+
+    it = instructions.erase(instructions.begin());
+    CHECK(id_of(*it) == 2);
+    it = instructions.erase(std::prev(instructions.end()));
+    CHECK(it == instructions.end());
+
+    CHECK(ids_of(instructions) == std::vector<int>{2, 3});
+    CHECK(id_of(instructions.front()) == 2);
+    CHECK(id_of(instructions.back()) == 3);
+    CHECK(instructions.front()->get_prev() == nullptr);
+    CHECK(instructions.back()->get_next() == nullptr);
+  }
+
+  TEST_CASE("splice moves every instruction and empties the source") {
+    hlir::Method method(Symbol(0));
+
+    hlir::InstructionList outer;
+    outer.push_back(make_mov(method, 1));
+    outer.push_back(make_mov(method, 4));
+
+    hlir::InstructionList inner;
+    inner.push_back(make_mov(method, 2));
+    inner.push_back(make_mov(method, 3));
+
+    outer.splice(std::next(outer.begin()), std::move(inner));
+    CHECK(inner.empty());
+    CHECK(ids_of(outer) == std::vector<int>{1, 2, 3, 4});
+
+    hlir::InstructionList tail;
+    tail.push_back(make_mov(method, 5));
+    outer.splice(outer.end(), std::move(tail));
+
+    hlir::InstructionList head;
+    head.push_back(make_mov(method, 0));
+    outer.splice(outer.begin(), std::move(head));
+
+    CHECK(ids_of(outer) == std::vector<int>{0, 1, 2, 3, 4, 5});
+    CHECK(outer.size() == 6);
+  }
+
+  TEST_CASE("builder appends to its method in emission order") {
+    hlir::Method method(Symbol(0));
+    method.instructions.push_back(make_mov(method, 1));
+
+    hlir::Builder builder(method);
+    hlir::Mov *second = builder.emit<hlir::Mov>(
+        hlir::Value::temp(2, Symbol(0)), hlir::Value::empty(), Token());
+    builder.emit<hlir::Mov>(hlir::Value::temp(3, Symbol(0)),
+                            hlir::Value::empty(), Token());
+
+    CHECK(ids_of(method.instructions) == std::vector<int>{1, 2, 3});
+    CHECK(second->get_prev() == method.instructions.front());
+  }
+
+  TEST_CASE("instructions survive moving their method") {
+    hlir::Method method(Symbol(0));
+    method.instructions.push_back(make_mov(method, 1));
+    hlir::Instruction *first = method.instructions.front();
+
+    hlir::Method moved = std::move(method);
+    CHECK(moved.instructions.front() == first);
+    CHECK(method.instructions.empty());
+  }
+}
+
+TEST_SUITE("Value") {
+  TEST_CASE("packed fields read back what was stored") {
+    Symbol type(12);
+
+    hlir::Value attr = hlir::Value::attr(Symbol(40000), 65000, type);
+    CHECK(attr.kind() == hlir::ValueKind::ATTRIBUTE);
+    CHECK(attr.symbol() == Symbol(40000));
+    CHECK(attr.offset() == 65000);
+    CHECK(attr.static_type() == type);
+
+    CHECK(hlir::Value::constant(-7, type).num() == -7);
+    CHECK(hlir::Value::constant(true, type).boolean());
+    CHECK_FALSE(hlir::Value::constant(false, type).boolean());
+    CHECK(hlir::Value::local(Symbol(3), type).symbol() == Symbol(3));
+    CHECK(hlir::Value::temp(123456, type).num() == 123456);
+
+    hlir::Value empty = hlir::Value::empty();
+    CHECK(empty.is_empty());
+    CHECK(empty.static_type() == Symbol());
+  }
+
+  TEST_CASE("values are equal when every field is") {
+    Symbol type(1);
+
+    CHECK(hlir::Value::temp(1, type) == hlir::Value::temp(1, type));
+    CHECK_FALSE(hlir::Value::temp(1, type) == hlir::Value::temp(2, type));
+    CHECK_FALSE(hlir::Value::temp(1, type) == hlir::Value::temp(1, Symbol(2)));
+    CHECK_FALSE(hlir::Value::temp(1, type) == hlir::Value::constant(1, type));
+  }
+}
+
+TEST_SUITE("Instruction") {
+  TEST_CASE("operands are reachable without knowing the instruction kind") {
+    hlir::Method method(Symbol(0));
+    Symbol type(0);
+
+    hlir::Instruction *binary = method.create<hlir::Binary>(
+        hlir::Op::ADD, hlir::Value::acc(type), hlir::Value::temp(1, type),
+        hlir::Value::temp(2, type), Token());
+    CHECK(binary->has_dest());
+    CHECK(binary->get_dest().kind() == hlir::ValueKind::ACC);
+    CHECK(binary->num_args() == 2);
+    CHECK(binary->args()[1].num() == 2);
+
+    hlir::Instruction *branch = method.create<hlir::Branch>(
+        hlir::BranchCondition::TRUE, hlir::Value::temp(3, type),
+        hlir::Position(7), Token());
+    CHECK_FALSE(branch->has_dest());
+    CHECK(branch->num_args() == 1);
+    CHECK(branch->get_arg1().num() == 3);
+    CHECK(static_cast<hlir::Branch *>(branch)->get_target().label_idx == 7);
+
+    hlir::Instruction *label =
+        method.create<hlir::Label>(7, Symbol(1), Token());
+    CHECK(label->args().empty());
+  }
+
+  TEST_CASE("call arguments follow the target") {
+    hlir::Method method(Symbol(0));
+    Symbol type(0);
+
+    std::vector<hlir::Value> arguments;
+    for (int i = 0; i < 5; i++)
+      arguments.push_back(hlir::Value::temp(i, type));
+
+    hlir::Call *call = method.create<hlir::Call>(
+        hlir::Value::acc(type), hlir::Value::self(type), Symbol(1), arguments,
+        method.arena, Token());
+
+    CHECK(call->num_args() == 6);
+    CHECK(call->get_arg1().kind() == hlir::ValueKind::SELF);
+    CHECK(call->call_args().size() == 5);
+    CHECK(call->call_args()[4].num() == 4);
+    CHECK(call->get_method_name() == Symbol(1));
+  }
+}
+
+TEST_SUITE("Arena") {
+  TEST_CASE("destroys objects when it goes away") {
+    auto counter = std::make_shared<int>(0);
+    {
+      Arena arena;
+      for (int i = 0; i < 1000; i++)
+        arena.create<std::shared_ptr<int>>(counter);
+      CHECK(counter.use_count() == 1001);
+
+      Arena moved = std::move(arena);
+      CHECK(counter.use_count() == 1001);
+    }
+    CHECK(counter.use_count() == 1);
+  }
+}
+
+TEST_SUITE("Lowering") {
+  TEST_CASE("passing destinations keeps results and needs fewer moves") {
+    const std::string program = R"(
+class Main {
+  x : Int <- 2;
+  f(n : Int) : Int {
+    let a : Int <- n, b : Int <- a * 2 in {
+      a <- a + (b <- b + 1);
+      while a < 20 loop a <- a + b pool;
+      if a = b then a else b - a fi;
+    }
+  };
+  g(n : Int) : Int {{ x <- x + n; x * (x - ~n); }};
+  h(n : Int) : Bool { not (n < 3) = (let c : Int <- n in c <- c - 3) < 0 };
+  main() : Object { 0 };
+};
+)";
+    SymbolTable through_acc_symbols;
+    hlir::Universe through_acc = lower_program(
+        program, through_acc_symbols, hlir::Lowering::THROUGH_ACC);
+    SymbolTable passing_symbols;
+    hlir::Universe passing = lower_program(
+        program, passing_symbols, hlir::Lowering::DESTINATION_PASSING);
+
+    for (const std::string name : {"f", "g", "h"}) {
+      const hlir::Method &acc_method =
+          through_acc.classes.at(through_acc_symbols.from("Main"))
+              .methods.at(through_acc_symbols.from(name));
+      const hlir::Method &passing_method =
+          passing.classes.at(passing_symbols.from("Main"))
+              .methods.at(passing_symbols.from(name));
+
+      for (int n : {0, 1, 3, 7}) {
+        Interpreter acc_interpreter(acc_method, through_acc_symbols);
+        acc_interpreter.set_local(through_acc_symbols.from("n"), n);
+        acc_interpreter.set_attribute(through_acc_symbols.from("x"), 2);
+        Interpreter passing_interpreter(passing_method, passing_symbols);
+        passing_interpreter.set_local(passing_symbols.from("n"), n);
+        passing_interpreter.set_attribute(passing_symbols.from("x"), 2);
+        CHECK(passing_interpreter.run() == acc_interpreter.run());
+      }
+
+      auto movs = [](const hlir::Method &method) {
+        int count = 0;
+        for (hlir::Instruction *instruction : method.instructions)
+          count += instruction->op == hlir::Op::MOV;
+        return count;
+      };
+      CHECK(movs(passing_method) < movs(acc_method));
+    }
+  }
+
+  TEST_CASE("lowering in parallel builds the same universe") {
+    const std::string program = R"(
+class A {
+  a : Int <- 1;
+  s : String <- "a";
+  f(n : Int) : Int { let b : Int <- n + a in b * b };
+  g() : String { s };
+};
+class B inherits A {
+  b : Bool <- true;
+  h(n : Int) : Object { if b then f(n) else new A fi };
+};
+class Main {
+  main() : Object { (new B).h(3) };
+};
+)";
+    SymbolTable symbols;
+    std::unique_ptr<ModuleNode> module = parse_program(program, symbols);
+    ClassTree class_tree(module.get(), symbols);
+    Scopes scopes;
+    TypeContext context(scopes, Symbol{}, class_tree, symbols);
+    REQUIRE(module->typecheck(context));
+
+    auto print = [&](const hlir::Universe &universe) {
+      std::ostringstream out;
+      universe.print(Printer(2, &out), symbols);
+      return out.str();
+    };
+
+    ThreadPool pool(4);
+    for (hlir::Lowering lowering : {hlir::Lowering::THROUGH_ACC,
+                                    hlir::Lowering::DESTINATION_PASSING}) {
+      std::string sequential =
+          print(module->to_hlir_universe(symbols, class_tree, lowering));
+      std::string parallel =
+          print(module->to_hlir_universe(symbols, class_tree, pool, lowering));
+      CHECK(parallel == sequential);
+    }
+  }
+}
@@ -0,0 +1,120 @@
+#include "doctest.h"
+#include "hlir_analysis.h"
+#include "hlir_optimizer.h"
+#include "method_builder.h"
+#include "statistic.h"
+#include "test_helpers.h"
+#include <cstring>
+
+using hlir::Analysis;
+
+static uint64_t statistic(const char *name) {
+  for (const Statistic *statistic : Statistic::all())
+    if (std::strcmp(statistic->group(), "analysis") == 0 &&
+        std::strcmp(statistic->name(), name) == 0)
+      return statistic->get();
+  return 0;
+}
+
+// A diamond: one write of t0 read on both sides of a branch
+static void build_diamond(MethodBuilder &builder) {
+  builder.mov(0);
+  builder.branch(hlir::BranchCondition::FALSE, 0);
+  builder.copy(1, 0);
+  builder.branch(hlir::BranchCondition::ALWAYS, 1);
+  builder.label(0);
+  builder.copy(2, 0);
+  builder.label(1);
+}
+
+TEST_SUITE("AnalysisManager") {
+  TEST_CASE("preserving an analysis needs the CFG") {
+    hlir::PreservedAnalyses preserved{Analysis::CFG, Analysis::LIVENESS};
+    CHECK(preserved.preserves(Analysis::CFG));
+    CHECK(preserved.preserves(Analysis::LIVENESS));
+    CHECK_FALSE(preserved.preserves(Analysis::DOMINATORS));
+
+    hlir::PreservedAnalyses without_cfg{Analysis::LIVENESS};
+    CHECK_FALSE(without_cfg.preserves(Analysis::LIVENESS));
+    CHECK_FALSE(hlir::PreservedAnalyses::none().preserves(Analysis::CFG));
+  }
+
+  TEST_CASE("analyses are computed once until invalidated") {
+    MethodBuilder builder;
+    build_diamond(builder);
+    hlir::MethodAnalyses analyses(builder.method);
+
+    hlir::CFG &cfg = analyses.get<hlir::CFG>();
+    CHECK(&analyses.get<hlir::CFG>() == &cfg);
+    CHECK(analyses.hits(Analysis::CFG) == 1);
+    CHECK(analyses.misses(Analysis::CFG) == 1);
+
+    analyses.get<hlir::Liveness>();
+    analyses.get<hlir::Liveness>();
+    CHECK(analyses.hits(Analysis::LIVENESS) == 1);
+    CHECK(analyses.misses(Analysis::LIVENESS) == 1);
+
+    analyses.get<hlir::DominatorTree>();
+    analyses.invalidate(Analysis::LIVENESS);
+    analyses.get<hlir::Liveness>();
+    analyses.get<hlir::DominatorTree>();
+    CHECK(analyses.misses(Analysis::LIVENESS) == 2);
+    CHECK(analyses.misses(Analysis::DOMINATORS) == 1);
+    CHECK(analyses.misses(Analysis::CFG) == 1);
+  }
+
+  TEST_CASE("invalidating the CFG drops everything built over it") {
+    MethodBuilder builder;
+    build_diamond(builder);
+    hlir::MethodAnalyses analyses(builder.method);
+
+    analyses.get<hlir::DominatorTree>();
+    analyses.get<hlir::ReachingDefinitions>();
+
+    // Dropping the first branch merges the entry with the block after it
+    builder.method.instructions.erase(
+        std::next(builder.method.instructions.begin()));
+    analyses.invalidate(hlir::PreservedAnalyses::none());
+
+    hlir::CFG &cfg = analyses.get<hlir::CFG>();
+    CHECK(analyses.misses(Analysis::CFG) == 2);
+    CHECK(cfg.block(cfg.entry()).succs.size() == 1);
+
+    const hlir::DominatorTree &dominators =
+        analyses.get<hlir::DominatorTree>();
+    CHECK(dominators.reverse_postorder().size() == 2);
+    analyses.get<hlir::ReachingDefinitions>();
+    CHECK(analyses.misses(Analysis::DOMINATORS) == 2);
+    CHECK(analyses.misses(Analysis::REACHING_DEFINITIONS) == 2);
+  }
+
+  TEST_CASE("passes share analyses and count them") {
+    SymbolTable symbols;
+    hlir::Universe universe = lower_program(R"(
+      class Main {
+        f(n : Int) : Int {
+          let m : Int <- n, a : Int <- 2 in {
+            while 0 < m loop m <- m - a pool;
+            if m = 0 then a + a else a * m fi;
+          }
+        };
+        main() : Int { f(5) };
+      };
+    )",
+                                            symbols);
+
+    uint64_t hits = statistic("cfg_hits");
+    uint64_t misses = statistic("cfg_misses");
+
+    OptimizerConfig config;
+    hlir::PassManager pass_manager(universe, config, symbols);
+    while (!pass_manager.is_done())
+      pass_manager.run_pass();
+
+    // Counts are reported after every pass. Every pass needs a CFG,
+    // but after useless_acc_mov only resolved branches break it.
+    CHECK(statistic("cfg_hits") > hits);
+    CHECK(statistic("cfg_misses") > misses);
+    CHECK(statistic("cfg_hits") - hits > statistic("cfg_misses") - misses);
+  }
+}
@@ -0,0 +1,194 @@
+#include "doctest.h"
+#include "hlir.h"
+#include "hlir_cfg.h"
+#include "method_builder.h"
+#include <string>
+#include <vector>
+
+static std::string describe(hlir::Instruction *instruction) {
+  switch (instruction->op) {
+  case hlir::Op::MOV:
+    return std::to_string(instruction->get_dest().num());
+  case hlir::Op::LABEL:
+    return "label";
+  case hlir::Op::BRANCH:
+    return instruction->condition == hlir::BranchCondition::ALWAYS ? "jump"
+                                                                   : "branch";
+  default:
+    return hlir::to_string(instruction->op);
+  }
+}
+
+static std::vector<std::string> contents(const hlir::BasicBlock &block) {
+  std::vector<std::string> result;
+  for (hlir::Instruction *instruction : block)
+    result.push_back(describe(instruction));
+  return result;
+}
+
+typedef std::vector<std::string> Contents;
+typedef std::vector<hlir::BlockIdx> Blocks;
+
+// if (acc) then { 1 } else { 2 }; 3, with a second label before 3
+static void build_diamond(MethodBuilder &builder) {
+  builder.mov(0);
+  builder.branch(hlir::BranchCondition::FALSE, 0);
+  builder.mov(1);
+  builder.branch(hlir::BranchCondition::ALWAYS, 1);
+  builder.label(0);
+  builder.mov(2);
+  builder.label(1);
+  builder.label(2);
+  builder.mov(3);
+}
+
+TEST_SUITE("CFG") {
+  TEST_CASE("splits blocks at labels and after branches") {
+    MethodBuilder builder;
+    build_diamond(builder);
+
+    hlir::CFG cfg(builder.method);
+
+    REQUIRE(cfg.size() == 4);
+    CHECK(cfg.entry() == 0);
+    CHECK(contents(cfg.block(0)) == Contents{"0", "branch"});
+    CHECK(contents(cfg.block(1)) == Contents{"1", "jump"});
+    CHECK(contents(cfg.block(2)) == Contents{"label", "2"});
+    CHECK(contents(cfg.block(3)) == Contents{"label", "label", "3"});
+
+    CHECK(cfg.block(0).succs == Blocks{2, 1});
+    CHECK(cfg.block(0).fallthrough == 1);
+    CHECK(cfg.block(1).succs == Blocks{3});
+    CHECK(cfg.block(1).fallthrough == hlir::NO_BLOCK);
+    CHECK(cfg.block(2).succs == Blocks{3});
+    CHECK(cfg.block(3).succs.empty());
+    CHECK(cfg.block(3).preds == Blocks{1, 2});
+
+    CHECK(cfg.block_of_label(builder.labels[1]) == 3);
+    CHECK(cfg.block_of_label(builder.labels[2]) == 3);
+    CHECK(cfg.block_of_label(builder.labels[3]) == hlir::NO_BLOCK);
+  }
+
+  TEST_CASE("loops and errors") {
+    MethodBuilder builder;
+    builder.label(0);
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::TRUE, 1);
+    builder.branch(hlir::BranchCondition::ALWAYS, 0);
+    builder.label(1);
+    builder.error();
+    builder.mov(1);
+
+    hlir::CFG cfg(builder.method);
+
+    REQUIRE(cfg.size() == 4);
+    CHECK(cfg.block(0).succs == Blocks{2, 1});
+    CHECK(cfg.block(1).succs == Blocks{0});
+    CHECK(cfg.block(0).preds == Blocks{1});
+    CHECK(contents(cfg.block(2)) == Contents{"label", "error"});
+    CHECK(cfg.block(2).succs.empty());
+    CHECK(cfg.block(3).preds.empty());
+
+    // The block after the error is unreachable
+    CHECK(cfg.reverse_postorder() == Blocks{0, 1, 2});
+  }
+
+  TEST_CASE("reverse postorder puts blocks before their successors") {
+    MethodBuilder builder;
+    build_diamond(builder);
+
+    hlir::CFG cfg(builder.method);
+    Blocks order = cfg.reverse_postorder();
+
+    REQUIRE(order.size() == 4);
+    CHECK(order.front() == 0);
+    CHECK(order.back() == 3);
+  }
+
+  TEST_CASE("insert and erase keep block bounds") {
+    MethodBuilder builder;
+    build_diamond(builder);
+
+    hlir::CFG cfg(builder.method);
+    hlir::BasicBlock &block = cfg.block(2);
+
+    cfg.erase(2, block.last);
+    cfg.erase(2, block.first);
+    CHECK(block.empty());
+    CHECK(contents(block).empty());
+
+    // An empty block still knows where it goes
+    cfg.insert(2, nullptr,
+               builder.method.create<hlir::Mov>(
+                   hlir::Value::temp(5, Symbol(0)), hlir::Value::empty(),
+                   Token()));
+    cfg.insert(2, block.first,
+               builder.method.create<hlir::Mov>(
+                   hlir::Value::temp(4, Symbol(0)), hlir::Value::empty(),
+                   Token()));
+    CHECK(contents(block) == Contents{"4", "5"});
+    CHECK(describe(block.last->get_next()) == "label");
+
+    cfg.insert(1, nullptr,
+               builder.method.create<hlir::Mov>(
+                   hlir::Value::temp(6, Symbol(0)), hlir::Value::empty(),
+                   Token()));
+    CHECK(contents(cfg.block(1)) == Contents{"1", "jump", "6"});
+    CHECK(builder.method.instructions.size() == 10);
+  }
+
+  TEST_CASE("rebuild reflects edits to terminators") {
+    MethodBuilder builder;
+    build_diamond(builder);
+
+    hlir::CFG cfg(builder.method);
+    cfg.erase(1, cfg.block(1).last);
+    cfg.rebuild();
+
+    REQUIRE(cfg.size() == 4);
+    CHECK(contents(cfg.block(1)) == Contents{"1"});
+    CHECK(cfg.block(1).fallthrough == 2);
+    CHECK(cfg.block(2).preds == Blocks{0, 1});
+    CHECK(cfg.block(3).preds == Blocks{2});
+  }
+
+  TEST_CASE("linearize adds and removes jumps as needed") {
+    MethodBuilder builder;
+    build_diamond(builder);
+
+    hlir::CFG cfg(builder.method);
+    cfg.linearize(Blocks{0, 2, 1, 3}, SymbolTable());
+
+    REQUIRE(cfg.size() == 5);
+    // 0 no longer falls through to 1, so it needs a jump and 1 a label
+    CHECK(contents(cfg.block(0)) == Contents{"0", "branch"});
+    CHECK(contents(cfg.block(1)) == Contents{"jump"});
+    CHECK(contents(cfg.block(2)) == Contents{"label", "2", "jump"});
+    // 1 is now right before 3, so its jump is gone
+    CHECK(contents(cfg.block(3)) == Contents{"label", "1"});
+    CHECK(contents(cfg.block(4)) == Contents{"label", "label", "3"});
+
+    CHECK(cfg.block(0).succs == Blocks{2, 1});
+    CHECK(cfg.block(1).succs == Blocks{3});
+    CHECK(cfg.block(2).succs == Blocks{4});
+    CHECK(cfg.block(3).succs == Blocks{4});
+  }
+
+  TEST_CASE("linearize drops blocks left out") {
+    MethodBuilder builder;
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::ALWAYS, 0);
+    builder.mov(1);
+    builder.label(0);
+    builder.mov(2);
+
+    hlir::CFG cfg(builder.method);
+    REQUIRE(cfg.size() == 3);
+    cfg.linearize(cfg.reverse_postorder(), SymbolTable());
+
+    REQUIRE(cfg.size() == 2);
+    CHECK(contents(cfg.block(0)) == Contents{"0"});
+    CHECK(contents(cfg.block(1)) == Contents{"label", "2"});
+    CHECK(builder.method.instructions.size() == 3);
+  }
+}
@@ -0,0 +1,235 @@
+#include "bitset.h"
+#include "doctest.h"
+#include "hlir_cfg.h"
+#include "hlir_dataflow.h"
+#include "method_builder.h"
+#include "test_helpers.h"
+#include <unordered_map>
+#include <vector>
+
+static std::vector<size_t> elements(const BitSet &set) {
+  std::vector<size_t> result;
+  set.for_each([&](size_t i) { result.push_back(i); });
+  return result;
+}
+
+static int temp_id(const hlir::VariableIndex &variables, int temp) {
+  return variables.of(hlir::Value::temp(temp, Symbol(0)));
+}
+
+// Checks that the solution satisfies the liveness equations at every block
+static void check_liveness(const hlir::CFG &cfg, const hlir::Liveness &liveness) {
+  const hlir::VariableIndex &variables = liveness.variables();
+
+  for (const hlir::BasicBlock &block : cfg.blocks()) {
+    BitSet live(variables.size());
+    if (block.succs.empty() && block.terminator() == nullptr)
+      live.set(hlir::VariableIndex::ACC);
+    for (hlir::BlockIdx succ : block.succs)
+      live.union_with(liveness.live_in(succ));
+    CHECK(live == liveness.live_out(block.idx));
+
+    for (hlir::Instruction *instruction = block.last; instruction != nullptr;
+         instruction =
+             instruction == block.first ? nullptr : instruction->get_prev()) {
+      if (instruction->has_dest())
+        live.reset(variables.of(instruction->get_dest()));
+      for (hlir::Value arg : instruction->args())
+        if (variables.of(arg) != -1)
+          live.set(variables.of(arg));
+    }
+    CHECK(live == liveness.live_in(block.idx));
+  }
+}
+
+// Checks that the solution satisfies the reaching definitions equations at
+// every block
+static void check_reaching(const hlir::CFG &cfg,
+                           const hlir::ReachingDefinitions &reaching) {
+  const hlir::VariableIndex &variables = reaching.variables();
+  const std::vector<hlir::Instruction *> &definitions = reaching.definitions();
+  std::unordered_map<hlir::Instruction *, size_t> numbers;
+  for (size_t i = 0; i < definitions.size(); i++)
+    numbers[definitions[i]] = i;
+
+  for (const hlir::BasicBlock &block : cfg.blocks()) {
+    BitSet reach(definitions.size());
+    for (hlir::BlockIdx pred : block.preds)
+      reach.union_with(reaching.reaching_out(pred));
+    CHECK(reach == reaching.reaching_in(block.idx));
+
+    for (hlir::Instruction *instruction : block) {
+      if (!numbers.contains(instruction))
+        continue;
+
+      for (size_t i = 0; i < definitions.size(); i++)
+        if (variables.of(definitions[i]->get_dest()) ==
+            variables.of(instruction->get_dest()))
+          reach.reset(i);
+      reach.set(numbers[instruction]);
+    }
+    CHECK(reach == reaching.reaching_out(block.idx));
+  }
+}
+
+TEST_SUITE("BitSet") {
+  TEST_CASE("set operations") {
+    BitSet a(130), b(130);
+    a.set(0);
+    a.set(64);
+    a.set(129);
+    b.set(64);
+    b.set(100);
+
+    CHECK(a.count() == 3);
+    CHECK(a.test(129));
+    CHECK_FALSE(a.test(128));
+
+    BitSet c = a;
+    CHECK(c.union_with(b));
+    CHECK_FALSE(c.union_with(b));
+    CHECK(elements(c) == std::vector<size_t>{0, 64, 100, 129});
+
+    CHECK(c.intersect_with(a));
+    CHECK(c == a);
+
+    c.subtract(b);
+    CHECK(elements(c) == std::vector<size_t>{0, 129});
+
+    c.fill();
+    CHECK(c.count() == 130);
+    c.clear();
+    CHECK(c.empty());
+  }
+
+  TEST_CASE("transfer") {
+    BitSet gen(10), in(10), kill(10), out(10);
+    gen.set(1);
+    in.set(2);
+    in.set(3);
+    kill.set(3);
+
+    CHECK(out.assign_transfer(gen, in, kill));
+    CHECK(elements(out) == std::vector<size_t>{1, 2});
+    CHECK_FALSE(out.assign_transfer(gen, in, kill));
+  }
+}
+
+TEST_SUITE("Dataflow") {
+  TEST_CASE("liveness in a diamond") {
+    MethodBuilder builder;
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::FALSE, 0);
+    builder.copy(1, 0);
+    builder.branch(hlir::BranchCondition::ALWAYS, 1);
+    builder.label(0);
+    builder.mov(2);
+    builder.label(1);
+    builder.copy(3, 0);
+
+    hlir::CFG cfg(builder.method);
+    hlir::Liveness liveness(cfg);
+    const hlir::VariableIndex &variables = liveness.variables();
+
+    REQUIRE(variables.size() == 5);
+    size_t acc = hlir::VariableIndex::ACC;
+    size_t t0 = temp_id(variables, 0);
+
+    CHECK(elements(liveness.live_in(0)) == std::vector<size_t>{acc});
+    CHECK(elements(liveness.live_out(0)) == std::vector<size_t>{acc, t0});
+    CHECK(elements(liveness.live_in(2)) == std::vector<size_t>{acc, t0});
+    CHECK(elements(liveness.live_out(3)) == std::vector<size_t>{acc});
+    CHECK(variables.of(hlir::Value::constant(1, Symbol(0))) == -1);
+    check_liveness(cfg, liveness);
+  }
+
+  TEST_CASE("reaching definitions around a loop") {
+    MethodBuilder builder;
+    builder.mov(0);
+    builder.label(0);
+    builder.mov(1);
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::TRUE, 0);
+    builder.mov(2);
+
+    hlir::CFG cfg(builder.method);
+    hlir::ReachingDefinitions reaching(cfg);
+
+    REQUIRE(reaching.definitions().size() == 4);
+    CHECK(elements(reaching.reaching_in(1)) == std::vector<size_t>{0, 1, 2});
+    CHECK(elements(reaching.reaching_out(1)) == std::vector<size_t>{1, 2});
+    CHECK(elements(reaching.reaching_out(2)) == std::vector<size_t>{1, 2, 3});
+    check_reaching(cfg, reaching);
+  }
+
+  TEST_CASE("lowered method") {
+    SymbolTable symbols;
+    hlir::Universe universe = lower_program(R"(
+class Main {
+  f(n : Int) : Int {
+    let i : Int <- 0, s : Int <- 0 in {
+      while i < n loop {
+        s <- s + i;
+        i <- i + 1;
+      } pool;
+      if s < 10 then s else s - 10 fi;
+    }
+  };
+  main() : Object { 0 };
+};
+)",
+                                            symbols);
+    hlir::Method &method =
+        universe.classes.at(symbols.from("Main")).methods.at(symbols.from("f"));
+
+    hlir::CFG cfg(method);
+    hlir::Liveness liveness(cfg);
+    hlir::ReachingDefinitions reaching(cfg);
+
+    // The argument is read before any write, so it is live on entry
+    int n = liveness.variables().of(
+        hlir::Value::local(symbols.from("n"), symbols.from("Int")));
+    REQUIRE(n != -1);
+    CHECK(liveness.live_in(cfg.entry()).test(n));
+
+    check_liveness(cfg, liveness);
+    check_reaching(cfg, reaching);
+  }
+
+  TEST_CASE("generated method with many blocks") {
+    const int BLOCKS = 300;
+    const int TEMPS = 40;
+
+    MethodBuilder builder;
+    std::vector<int> labels;
+    for (int i = 0; i < BLOCKS; i++)
+      labels.push_back(builder.add_label());
+
+    uint32_t seed = 12345;
+    auto random = [&](uint32_t bound) {
+      seed = seed * 1103515245 + 12345;
+      return (seed >> 16) % bound;
+    };
+
+    for (int i = 0; i < BLOCKS; i++) {
+      builder.label(labels[i]);
+      for (int j = 0; j < 4; j++) {
+        if (random(3) == 0)
+          builder.mov(random(TEMPS));
+        else
+          builder.copy(random(TEMPS), random(TEMPS));
+      }
+      if (i + 1 < BLOCKS)
+        builder.branch(random(2) == 0 ? hlir::BranchCondition::TRUE
+                                      : hlir::BranchCondition::ALWAYS,
+                       labels[random(BLOCKS)]);
+    }
+
+    hlir::CFG cfg(builder.method);
+    hlir::Liveness liveness(cfg);
+    hlir::ReachingDefinitions reaching(cfg);
+
+    check_liveness(cfg, liveness);
+    check_reaching(cfg, reaching);
+  }
+}
@@ -0,0 +1,232 @@
+#include "doctest.h"
+#include "hlir_cfg.h"
+#include "hlir_dominators.h"
+#include "hlir_interpreter.h"
+#include "hlir_ssa.h"
+#include "method_builder.h"
+#include "test_helpers.h"
+#include <vector>
+
+typedef std::vector<hlir::BlockIdx> Blocks;
+
+const std::string LOOP_PROGRAM = R"(
+class Main {
+  f(n : Int) : Int {
+    let i : Int <- 0, s : Int <- 0 in {
+      while i < n loop {
+        s <- s + i;
+        i <- i + 1;
+      } pool;
+      if s < 10 then s else s - 10 fi;
+    }
+  };
+  main() : Object { 0 };
+};
+)";
+
+static hlir::Method &find_method(hlir::Universe &universe,
+                                 SymbolTable &symbols, const std::string &cls,
+                                 const std::string &method) {
+  return universe.classes.at(symbols.from(cls)).methods.at(
+      symbols.from(method));
+}
+
+static int count_op(const hlir::Method &method, hlir::Op op) {
+  int count = 0;
+  for (hlir::Instruction *instruction : method.instructions)
+    count += instruction->op == op;
+  return count;
+}
+
+static int32_t run(const hlir::Method &method, SymbolTable &symbols, int n) {
+  Interpreter interpreter(method, symbols);
+  interpreter.set_local(symbols.from("n"), n);
+  return interpreter.run();
+}
+
+TEST_SUITE("DominatorTree") {
+  TEST_CASE("diamond") {
+    MethodBuilder builder;
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::FALSE, 0);
+    builder.mov(1);
+    builder.branch(hlir::BranchCondition::ALWAYS, 1);
+    builder.label(0);
+    builder.mov(2);
+    builder.label(1);
+    builder.mov(3);
+
+    hlir::CFG cfg(builder.method);
+    hlir::DominatorTree dominators(cfg);
+
+    CHECK(dominators.idom(0) == hlir::NO_BLOCK);
+    CHECK(dominators.idom(1) == 0);
+    CHECK(dominators.idom(2) == 0);
+    CHECK(dominators.idom(3) == 0);
+    CHECK(dominators.dominates(0, 3));
+    CHECK(dominators.dominates(3, 3));
+    CHECK_FALSE(dominators.dominates(1, 3));
+
+    CHECK(dominators.frontier(0).empty());
+    CHECK(dominators.frontier(1) == Blocks{3});
+    CHECK(dominators.frontier(2) == Blocks{3});
+    CHECK(dominators.frontier(3).empty());
+  }
+
+  TEST_CASE("loop back to the entry and unreachable code") {
+    MethodBuilder builder;
+    builder.label(0);
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::TRUE, 1);
+    builder.branch(hlir::BranchCondition::ALWAYS, 0);
+    builder.label(1);
+    builder.error();
+    builder.mov(1);
+
+    hlir::CFG cfg(builder.method);
+    hlir::DominatorTree dominators(cfg);
+
+    CHECK(dominators.idom(1) == 0);
+    CHECK(dominators.idom(2) == 0);
+    CHECK(dominators.frontier(1) == Blocks{0});
+    CHECK(dominators.frontier(0) == Blocks{0});
+    CHECK(dominators.children(0) == Blocks{1, 2});
+
+    CHECK_FALSE(dominators.reachable(3));
+    CHECK_FALSE(dominators.dominates(0, 3));
+    CHECK(dominators.reverse_postorder().size() == 3);
+  }
+}
+
+TEST_SUITE("SSA") {
+  TEST_CASE("every temporary is written once and acc only at the end") {
+    SymbolTable symbols;
+    hlir::Universe universe = lower_program(LOOP_PROGRAM, symbols);
+    hlir::Method &method = find_method(universe, symbols, "Main", "f");
+
+    hlir::CFG cfg(method);
+    hlir::to_ssa(cfg, symbols);
+
+    // i, s and acc meet at the loop header, and acc again after the if
+    CHECK(count_op(method, hlir::Op::PHI) == 4);
+
+    std::vector<int> writes(method.num_temporaries(), 0);
+    hlir::Instruction *acc_write = nullptr;
+
+    for (hlir::Instruction *instruction : method.instructions) {
+      if (!instruction->has_dest())
+        continue;
+
+      hlir::Value dest = instruction->get_dest();
+      if (dest.kind() == hlir::ValueKind::TEMP)
+        writes[dest.num()]++;
+      else if (dest.kind() == hlir::ValueKind::ACC)
+        acc_write = instruction;
+      else
+        FAIL("only temporaries and acc are written");
+
+      for (hlir::Value arg : instruction->args())
+        CHECK(arg.kind() != hlir::ValueKind::ACC);
+    }
+
+    for (int count : writes)
+      CHECK(count <= 1);
+    CHECK(acc_write == method.instructions.back());
+
+    hlir::DefUse def_use(method);
+    hlir::Value result = acc_write->get_arg1();
+    REQUIRE(def_use.def(result.num()) != nullptr);
+    CHECK(def_use.def(result.num())->op == hlir::Op::PHI);
+    CHECK(def_use.uses(result.num()) ==
+          std::vector<hlir::Instruction *>{acc_write});
+  }
+
+  TEST_CASE("leaving SSA keeps the meaning of the method") {
+    SymbolTable symbols;
+    hlir::Universe universe = lower_program(LOOP_PROGRAM, symbols);
+    hlir::Method &method = find_method(universe, symbols, "Main", "f");
+
+    std::vector<int32_t> expected;
+    for (int n : {0, 1, 4, 5, 10})
+      expected.push_back(run(method, symbols, n));
+    CHECK(expected == std::vector<int32_t>{0, 0, 6, 0, 35});
+
+    hlir::CFG cfg(method);
+    hlir::to_ssa(cfg, symbols);
+    hlir::from_ssa(cfg);
+
+    CHECK(count_op(method, hlir::Op::PHI) == 0);
+
+    std::vector<int32_t> actual;
+    for (int n : {0, 1, 4, 5, 10})
+      actual.push_back(run(method, symbols, n));
+    CHECK(actual == expected);
+  }
+
+  TEST_CASE("copies for different phis do not clobber each other") {
+    // a and b are swapped on every iteration, so their phis read each other
+    SymbolTable symbols;
+    hlir::Universe universe = lower_program(R"(
+class Main {
+  f(n : Int) : Int {
+    let a : Int <- 1, b : Int <- 2, t : Int, k : Int <- n in {
+      while 0 < k loop { t <- a; a <- b; b <- t; k <- k - 1; } pool;
+      a * 10 + b;
+    }
+  };
+  main() : Object { 0 };
+};
+)",
+                                            symbols);
+    hlir::Method &method = find_method(universe, symbols, "Main", "f");
+
+    hlir::CFG cfg(method);
+    hlir::to_ssa(cfg, symbols);
+    hlir::from_ssa(cfg);
+
+    CHECK(run(method, symbols, 0) == 12);
+    CHECK(run(method, symbols, 1) == 21);
+    CHECK(run(method, symbols, 2) == 12);
+  }
+
+  TEST_CASE("methods starting with a loop get an entry block") {
+    SymbolTable symbols;
+    hlir::Universe universe = lower_program(R"(
+class Main {
+  n : Int;
+  f() : Int {{ while n < 10 loop n <- n + 3 pool; n; }};
+  main() : Object { 0 };
+};
+)",
+                                            symbols);
+    hlir::Method &method = find_method(universe, symbols, "Main", "f");
+
+    hlir::CFG cfg(method);
+    hlir::to_ssa(cfg, symbols);
+
+    CHECK(cfg.block(cfg.entry()).preds.empty());
+    CHECK(cfg.block(cfg.entry()).succs == Blocks{1});
+    CHECK(cfg.block(1).preds.size() == 2);
+
+    hlir::from_ssa(cfg);
+
+    Interpreter interpreter(method, symbols);
+    interpreter.set_attribute(symbols.from("n"), 0);
+    CHECK(interpreter.run() == 12);
+  }
+
+  TEST_CASE("unreachable blocks are dropped") {
+    MethodBuilder builder;
+    builder.mov(0);
+    builder.branch(hlir::BranchCondition::ALWAYS, 0);
+    builder.mov(1);
+    builder.label(0);
+    builder.mov(2);
+
+    hlir::CFG cfg(builder.method);
+    hlir::to_ssa(cfg, SymbolTable());
+
+    CHECK(cfg.size() == 2);
+    CHECK(builder.method.instructions.size() == 3);
+  }
+}
@@ -0,0 +1,129 @@
+#include "doctest.h"
+#include "semantic.h"
+#include "test_helpers.h"
+#include <algorithm>
+
+std::vector<std::string> rechecked_names(const IncrementalAnalysis &analysis,
+                                         const SymbolTable &symbols) {
+  std::vector<std::string> names;
+  for (Symbol name : analysis.rechecked())
+    names.push_back(symbols.get_string(name));
+
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+const std::string CLASS_A = R"(
+class A {
+  a : Int <- 1;
+  f() : Int { a + 1 };
+};
+)";
+
+const std::string CLASS_A_NEW_BODY = R"(
+class A {
+  a : Int <- 1;
+  f() : Int { a + 2 };
+};
+)";
+
+const std::string CLASS_A_NEW_SIGNATURE = R"(
+class A {
+  a : Int <- 1;
+  f() : Int { a + 1 };
+  g() : Int { a };
+};
+)";
+
+const std::string OTHER_CLASSES = R"(
+class B inherits A {
+  b : Int <- 2;
+};
+
+class C {
+  c : B <- new B;
+  h() : Int { c.f() };
+};
+
+class D {
+  d : Int <- 4;
+  k() : Int { d * 2 };
+};
+)";
+
+const std::string CLASS_D_NEW_BODY = R"(
+class B inherits A {
+  b : Int <- 2;
+};
+
+class C {
+  c : B <- new B;
+  h() : Int { c.f() };
+};
+
+class D {
+  d : Int <- 4;
+  k() : Int { d * 3 };
+};
+)";
+
+TEST_SUITE("IncrementalAnalysis") {
+  TEST_CASE("first analysis checks every class") {
+    SymbolTable symbols;
+    IncrementalAnalysis analysis(symbols);
+
+    CHECK(analysis.analyze(parse_program(CLASS_A + OTHER_CLASSES, symbols)));
+    CHECK(rechecked_names(analysis, symbols) ==
+          std::vector<std::string>{"A", "B", "C", "D"});
+  }
+
+  TEST_CASE("unchanged program checks nothing") {
+    SymbolTable symbols;
+    IncrementalAnalysis analysis(symbols);
+
+    CHECK(analysis.analyze(parse_program(CLASS_A + OTHER_CLASSES, symbols)));
+    CHECK(analysis.analyze(parse_program(CLASS_A + OTHER_CLASSES, symbols)));
+    CHECK(analysis.rechecked().empty());
+  }
+
+  TEST_CASE("body change only checks the edited class") {
+    SymbolTable symbols;
+    IncrementalAnalysis analysis(symbols);
+
+    CHECK(analysis.analyze(parse_program(CLASS_A + OTHER_CLASSES, symbols)));
+
+    CHECK(analysis.analyze(parse_program(CLASS_A + CLASS_D_NEW_BODY, symbols)));
+    CHECK(rechecked_names(analysis, symbols) == std::vector<std::string>{"D"});
+
+    CHECK(analysis.analyze(
+        parse_program(CLASS_A_NEW_BODY + CLASS_D_NEW_BODY, symbols)));
+    CHECK(rechecked_names(analysis, symbols) == std::vector<std::string>{"A"});
+  }
+
+  TEST_CASE("signature change checks dependants") {
+    SymbolTable symbols;
+    IncrementalAnalysis analysis(symbols);
+
+    CHECK(analysis.analyze(parse_program(CLASS_A + OTHER_CLASSES, symbols)));
+
+    // B inherits from A and C dispatches on B, but D never looks at A
+    CHECK(analysis.analyze(
+        parse_program(CLASS_A_NEW_SIGNATURE + OTHER_CLASSES, symbols)));
+    CHECK(rechecked_names(analysis, symbols) ==
+          std::vector<std::string>{"A", "B", "C"});
+  }
+
+  TEST_CASE("reused classes keep their types") {
+    SymbolTable symbols;
+    IncrementalAnalysis analysis(symbols);
+
+    CHECK(analysis.analyze(parse_program(CLASS_A + OTHER_CLASSES, symbols)));
+    CHECK(analysis.analyze(parse_program(CLASS_A + CLASS_D_NEW_BODY, symbols)));
+
+    ModuleNode *module = analysis.get_module();
+    for (const auto &class_node : module->classes) {
+      for (const auto &method : class_node->methods)
+        CHECK(method->body->static_type.has_value());
+    }
+  }
+}
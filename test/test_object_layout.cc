@@ -0,0 +1,110 @@
+#include "doctest.h"
+#include "semantic.h"
+#include "test_helpers.h"
+
+const std::string LAYOUT_PROGRAM = R"(
+class A {
+  r : Object;
+  i : Int;
+  b : Bool;
+  s : String;
+  j : Int;
+};
+
+class B inherits A {
+  c : Bool;
+  k : Int;
+  o : IO;
+};
+
+class C inherits A {
+};
+)";
+
+const std::string REDEFINITION_PROGRAM = R"(
+class A {
+  i : Int;
+  o : IO;
+};
+
+class B inherits A {
+  o : IO;
+  i : Int;
+  b : Bool;
+};
+)";
+
+int offset_of(const ObjectLayout &layout, SymbolTable &symbols,
+              const std::string &name) {
+  const Field *field = layout.field(symbols.from(name));
+  REQUIRE(field != nullptr);
+  return field->offset;
+}
+
+TEST_SUITE("ObjectLayout") {
+  TEST_CASE("classes without attributes are only a header") {
+    SymbolTable symbols;
+    auto module = parse_program(LAYOUT_PROGRAM, symbols);
+    ClassTree class_tree(module.get(), symbols);
+
+    const ObjectLayout &layout = class_tree.get_layout(symbols.object_type);
+    CHECK(layout.size() == ObjectLayout::HEADER_SIZE);
+    CHECK(layout.fields().empty());
+    CHECK(layout.reference_offsets().empty());
+  }
+
+  TEST_CASE("references are grouped before unboxed fields") {
+    SymbolTable symbols;
+    auto module = parse_program(LAYOUT_PROGRAM, symbols);
+    ClassTree class_tree(module.get(), symbols);
+
+    const ObjectLayout &layout = class_tree.get_layout(symbols.from("A"));
+    CHECK(offset_of(layout, symbols, "r") == 16);
+    CHECK(offset_of(layout, symbols, "s") == 24);
+    CHECK(offset_of(layout, symbols, "i") == 32);
+    CHECK(offset_of(layout, symbols, "j") == 36);
+    CHECK(offset_of(layout, symbols, "b") == 40);
+    CHECK(layout.field(symbols.from("b"))->kind == FieldKind::BOOL);
+    CHECK(layout.size() == 48);
+    CHECK(layout.reference_offsets() == std::vector<int>{16, 24});
+  }
+
+  TEST_CASE("subclasses keep the superclass prefix and fill its padding") {
+    SymbolTable symbols;
+    auto module = parse_program(LAYOUT_PROGRAM, symbols);
+    ClassTree class_tree(module.get(), symbols);
+
+    const ObjectLayout &a_layout = class_tree.get_layout(symbols.from("A"));
+    const ObjectLayout &b_layout = class_tree.get_layout(symbols.from("B"));
+
+    for (const Field &field : a_layout.fields())
+      CHECK(b_layout.field(field.name)->offset == field.offset);
+
+    // A ends at 41, so k fits in the padding before the next reference
+    CHECK(offset_of(b_layout, symbols, "k") == 44);
+    CHECK(offset_of(b_layout, symbols, "o") == 48);
+    CHECK(offset_of(b_layout, symbols, "c") == 56);
+    CHECK(b_layout.size() == 64);
+    CHECK(b_layout.reference_offsets() == std::vector<int>{16, 24, 48});
+
+    CHECK(class_tree.get_layout(symbols.from("C")).size() == a_layout.size());
+  }
+
+  TEST_CASE("redefined attributes keep the inherited field") {
+    SymbolTable symbols;
+    auto module = parse_program(REDEFINITION_PROGRAM, symbols);
+    ClassTree class_tree(module.get(), symbols);
+
+    const ObjectLayout &a_layout = class_tree.get_layout(symbols.from("A"));
+    const ObjectLayout &b_layout = class_tree.get_layout(symbols.from("B"));
+
+    CHECK(b_layout.fields().size() == 3);
+    CHECK(offset_of(b_layout, symbols, "i") ==
+          offset_of(a_layout, symbols, "i"));
+    CHECK(offset_of(b_layout, symbols, "o") ==
+          offset_of(a_layout, symbols, "o"));
+    CHECK(offset_of(b_layout, symbols, "b") == 28);
+    CHECK(b_layout.size() == a_layout.size());
+    CHECK(b_layout.reference_offsets() == a_layout.reference_offsets());
+  }
+}
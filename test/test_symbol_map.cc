@@ -0,0 +1,98 @@
+#include "doctest.h"
+#include "symbol_map.h"
+#include <memory>
+#include <string>
+
+TEST_SUITE("SymbolMap") {
+  TEST_CASE_TEMPLATE("SymbolMap insertion and lookup", Map, SymbolMap<int>,
+                     SmallSymbolMap<int>) {
+    Map map;
+    CHECK(map.empty());
+    CHECK(!map.contains(Symbol(3)));
+    CHECK(map.find(Symbol(3)) == nullptr);
+    CHECK(!map.contains(Symbol()));
+
+    CHECK(map.emplace(Symbol(3), 30));
+    CHECK(map.emplace(Symbol(0), 0));
+    CHECK(map.emplace(Symbol(200), 2000));
+
+    // emplace never overwrites
+    CHECK(!map.emplace(Symbol(3), 31));
+
+    CHECK(map.size() == 3);
+    CHECK(map.contains(Symbol(3)));
+    CHECK(map.at(Symbol(3)) == 30);
+    CHECK(*map.find(Symbol(200)) == 2000);
+    CHECK(map.find(Symbol(199)) == nullptr);
+    CHECK_THROWS_AS(map.at(Symbol(4)), std::out_of_range);
+
+    map[Symbol(3)] = 33;
+    CHECK(map.at(Symbol(3)) == 33);
+
+    // operator[] default-constructs missing values
+    CHECK(map[Symbol(70)] == 0);
+    CHECK(map.size() == 4);
+  }
+
+  TEST_CASE_TEMPLATE("SymbolMap iterates by symbol id", Map, SymbolMap<int>,
+                     SmallSymbolMap<int>) {
+    Map map;
+    for (int id : {130, 5, 64, 63, 1, 0})
+      map.emplace(Symbol(id), id * 10);
+
+    std::vector<int> keys;
+    for (const auto &[key, value] : map) {
+      CHECK(value == key.id * 10);
+      keys.push_back(key.id);
+    }
+
+    CHECK(keys == std::vector<int>{0, 1, 5, 63, 64, 130});
+
+    for (auto &[_, value] : map)
+      value++;
+    CHECK(map.at(Symbol(64)) == 641);
+  }
+
+  TEST_CASE_TEMPLATE("SymbolMap holds move-only values", Map,
+                     SymbolMap<std::unique_ptr<std::string>>,
+                     SmallSymbolMap<std::unique_ptr<std::string>>) {
+    Map map;
+    for (int id = 100; id >= 0; id--)
+      map.emplace(Symbol(id), std::make_unique<std::string>(std::to_string(id)));
+
+    CHECK(map.size() == 101);
+    CHECK(*map.at(Symbol(42)) == "42");
+    CHECK(*map.at(Symbol(100)) == "100");
+  }
+
+  TEST_CASE("PersistentSymbolMap copies do not see later changes") {
+    PersistentSymbolMap<int> parent;
+    CHECK(parent.empty());
+    CHECK(parent.find(Symbol()) == nullptr);
+
+    parent.assign(Symbol(3), 30);
+    parent.assign(Symbol(5000), 50000);
+
+    PersistentSymbolMap<int> child = parent;
+    child.assign(Symbol(3), 31);
+    child.assign(Symbol(7), 70);
+
+    CHECK(parent.size() == 2);
+    CHECK(*parent.find(Symbol(3)) == 30);
+    CHECK(!parent.contains(Symbol(7)));
+
+    // Overwriting keeps the size
+    CHECK(child.size() == 3);
+    CHECK(*child.find(Symbol(3)) == 31);
+    CHECK(*child.find(Symbol(5000)) == 50000);
+    CHECK(*child.find(Symbol(7)) == 70);
+    CHECK(child.find(Symbol(4999)) == nullptr);
+
+    std::vector<int> keys;
+    child.for_each([&](Symbol key, int value) {
+      CHECK(*child.find(key) == value);
+      keys.push_back(key.id);
+    });
+    CHECK(keys == std::vector<int>{3, 7, 5000});
+  }
+}
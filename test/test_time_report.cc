@@ -0,0 +1,74 @@
+#include "doctest.h"
+#include "statistic.h"
+#include "thread_pool.h"
+#include "time_report.h"
+#include <format>
+#include <memory>
+#include <sstream>
+
+static Statistic test_events("time_report_test", "events",
+                             "Events counted by the time report tests");
+
+TEST_SUITE("TimeReport") {
+  TEST_CASE("phases record allocations and statistics") {
+    TimeReport report;
+
+    report.start();
+    auto numbers = std::make_unique<std::vector<int>>(100);
+    test_events.add(3);
+    report.stop("phase", "first");
+
+    report.start();
+    report.stop("pass", "second");
+
+    REQUIRE(report.entries().size() == 2);
+    const TimeReport::Entry &first = report.entries()[0];
+    CHECK(first.kind == "phase");
+    CHECK(first.name == "first");
+    CHECK(first.seconds >= 0);
+    CHECK(first.allocations.count >= 2);
+    CHECK(first.allocations.bytes >= 100 * sizeof(int));
+    REQUIRE(first.counters.size() == 1);
+    CHECK(first.counters[0].first == "time_report_test.events");
+    CHECK(first.counters[0].second == 3);
+
+    CHECK(report.entries()[1].counters.empty());
+  }
+
+  TEST_CASE("names are escaped in JSON") {
+    TimeReport report;
+    report.start();
+    report.stop("pass", "a\"b\\c\n");
+
+    std::ostringstream json;
+    report.print_json(json);
+    CHECK(json.str().find(R"("name": "a\"b\\c\u000a")") != std::string::npos);
+    CHECK(json.str().find(R"("kind": "pass")") != std::string::npos);
+  }
+
+  // Tracing stays on for the tests after this one, which only costs memory
+  TEST_CASE("spans go to the trace of the thread running them") {
+    enable_tracing();
+    CHECK(tracing_enabled());
+
+    {
+      TraceSpan outer("phase", "traced_phase");
+      ThreadPool pool(2);
+      pool.parallel_for(8, [](size_t i) {
+        TraceSpan span("method", "Traced", std::to_string(i));
+      });
+    }
+
+    std::ostringstream trace;
+    write_trace(trace);
+    const std::string &json = trace.str();
+
+    CHECK(json.starts_with("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["));
+    CHECK(json.find(R"({"name": "traced_phase", "cat": "phase", "ph": "X")") !=
+          std::string::npos);
+    for (int i = 0; i < 8; i++)
+      CHECK(json.find(std::format(R"("name": "Traced.{}")", i)) !=
+            std::string::npos);
+    CHECK(json.find(R"("args": {"name": "main"})") != std::string::npos);
+  }
+}
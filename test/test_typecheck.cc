@@ -0,0 +1,91 @@
+#include "doctest.h"
+#include "printer.h"
+#include "semantic.h"
+#include "test_helpers.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <sstream>
+
+// Errors in several classes, so that the order they are reported in matters
+const std::string PROGRAM_WITH_ERRORS = R"(
+class A {
+  a : Int <- true;
+  f() : Int { a + 1 };
+};
+
+class B inherits A {
+  b : String <- f();
+  g() : Bool { b + 1 };
+};
+
+class C {
+  c : B <- new B;
+  h() : Int { c.g() };
+};
+
+class Main {
+  main() : Object { (new C).h() };
+};
+)";
+
+struct TypecheckResult {
+  bool check;
+  std::string diagnostics;
+  std::string typed_ast;
+};
+
+// Typechecks the program, in parallel if given a pool, recording what was
+// reported on stderr and the annotated AST
+static TypecheckResult typecheck_program(const std::string &program,
+                                         ThreadPool *pool) {
+  SymbolTable symbols;
+  std::unique_ptr<ModuleNode> module = parse_program(program, symbols);
+  ClassTree class_tree(module.get(), symbols);
+  Scopes scopes;
+  TypeContext context(scopes, Symbol{}, class_tree, symbols);
+
+  std::ostringstream diagnostics;
+  std::streambuf *stderr_buffer = std::cerr.rdbuf(diagnostics.rdbuf());
+  bool check = pool != nullptr ? module->typecheck(context, *pool)
+                               : module->typecheck(context);
+  std::cerr.rdbuf(stderr_buffer);
+
+  std::ostringstream typed_ast;
+  Printer printer{2, &typed_ast};
+  module->print(printer, symbols);
+
+  return {check, diagnostics.str(), typed_ast.str()};
+}
+
+TEST_SUITE("ParallelTypecheck") {
+  TEST_CASE("matches the sequential typecheck") {
+    TypecheckResult sequential = typecheck_program(PROGRAM_WITH_ERRORS, nullptr);
+    CHECK_FALSE(sequential.check);
+    CHECK_FALSE(sequential.diagnostics.empty());
+
+    for (unsigned int threads : {1, 2, 4}) {
+      ThreadPool pool(threads);
+      TypecheckResult parallel = typecheck_program(PROGRAM_WITH_ERRORS, &pool);
+
+      CHECK(parallel.check == sequential.check);
+      CHECK(parallel.diagnostics == sequential.diagnostics);
+      CHECK(parallel.typed_ast == sequential.typed_ast);
+    }
+  }
+
+  TEST_CASE("accepts what the sequential typecheck accepts") {
+    const std::string program = R"(
+      class A { a : Int <- 1; f() : Int { a + 1 }; };
+      class Main inherits A { main() : Int { f() * 2 }; };
+    )";
+
+    ThreadPool pool(4);
+    TypecheckResult sequential = typecheck_program(program, nullptr);
+    TypecheckResult parallel = typecheck_program(program, &pool);
+
+    CHECK(sequential.check);
+    CHECK(parallel.check);
+    CHECK(parallel.diagnostics.empty());
+    CHECK(parallel.typed_ast == sequential.typed_ast);
+  }
+}